@@ -0,0 +1,58 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdlib.h>
+#include <time.h>
+
+/**
+* Helpers shared by the benchmark programs in this directory.
+*
+* Every benchmark is a small program which builds its containers from int keys and data,
+* times the operations it compares with benchNow, and prints one line per measurement.
+*/
+
+static inline double benchNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/**
+* A small xorshift generator, so every thread of a benchmark can draw its own random keys
+* without sharing the state of rand().
+*/
+static inline unsigned int benchRandom(unsigned long long* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return (unsigned int)(*state >> 32);
+}
+
+static inline void* benchCopyInt(void* element)
+{
+    int* copy = (int*)malloc(sizeof(int));
+    if (copy != NULL) {
+        *copy = *(int*)element;
+    }
+    return copy;
+}
+
+static inline void benchFreeInt(void* element)
+{
+    free(element);
+}
+
+static inline int benchCompareInts(void* element1, void* element2)
+{
+    int first = *(int*)element1, second = *(int*)element2;
+    return (first > second) - (first < second);
+}
+
+static inline size_t benchHashInt(void* element)
+{
+    return (size_t)(unsigned int)*(int*)element;
+}
+
+#endif
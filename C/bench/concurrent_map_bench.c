@@ -0,0 +1,125 @@
+#define _POSIX_C_SOURCE 200112L
+
+/**
+* Measures the throughput of ConcurrentMap under a mix of lookups and writes, with 1 up to
+* the given number of threads, next to the same work on one Map guarded by a global mutex.
+*
+* Usage: concurrent_map_bench [max threads] [keys] [operations per thread]
+*/
+
+#include "../concurrent_map.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define DEFAULT_KEYS 1000000
+#define DEFAULT_OPERATIONS 1000000
+
+typedef struct worker_t {
+    ConcurrentMap concurrent; // either this map is used,
+    Map map;                  // or this one under global_lock
+    int keys;
+    int operations;
+    int read_percent;
+    unsigned long long seed;
+} Worker;
+
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void* runWorker(void* context)
+{
+    Worker* worker = (Worker*)context;
+    unsigned long long state = worker->seed;
+    for (int i = 0; i < worker->operations; i++) {
+        int key = (int)(benchRandom(&state) % (unsigned int)(2 * worker->keys)); // half of the lookups miss
+        bool read = (int)(benchRandom(&state) % 100) < worker->read_percent;
+        if (worker->concurrent != NULL) {
+            if (read) {
+                concurrentMapContains(worker->concurrent, &key);
+            }
+            else {
+                concurrentMapPut(worker->concurrent, &key, &i);
+            }
+        }
+        else {
+            pthread_mutex_lock(&global_lock);
+            if (read) {
+                mapContains(worker->map, &key);
+            }
+            else {
+                mapPut(worker->map, &key, &i);
+            }
+            pthread_mutex_unlock(&global_lock);
+        }
+    }
+    return NULL;
+}
+
+static double runThreads(ConcurrentMap concurrent, Map map, int threads, int keys, int operations, int read_percent)
+{
+    pthread_t ids[threads];
+    Worker workers[threads];
+    double start = benchNow();
+    for (int i = 0; i < threads; i++) {
+        workers[i] = (Worker){ concurrent, map, keys, operations, read_percent, 0x9E3779B97F4A7C15ULL * (i + 1) };
+        pthread_create(&ids[i], NULL, runWorker, &workers[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    double seconds = benchNow() - start;
+    return (double)threads * operations / seconds / 1e6;
+}
+
+/**
+* Doubles the number of threads, but always ends with max_threads itself.
+*/
+static int nextThreads(int threads, int max_threads)
+{
+    if (threads < max_threads && threads * 2 > max_threads) {
+        return max_threads;
+    }
+    return threads * 2;
+}
+
+int main(int argc, char** argv)
+{
+    int max_threads = (argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN));
+    int keys = (argc > 2 ? atoi(argv[2]) : DEFAULT_KEYS);
+    int operations = (argc > 3 ? atoi(argv[3]) : DEFAULT_OPERATIONS);
+    if (max_threads < 1 || keys < 1 || operations < 1) {
+        fprintf(stderr, "usage: %s [max threads] [keys] [operations per thread]\n", argv[0]);
+        return 1;
+    }
+
+    ConcurrentMap concurrent = concurrentMapCreate(0, benchCopyInt, benchCopyInt, benchFreeInt, benchFreeInt,
+                                                   benchCompareInts, benchHashInt);
+    Map map = mapCreate(benchCopyInt, benchCopyInt, benchFreeInt, benchFreeInt, benchCompareInts);
+    if (concurrent == NULL || map == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int key = 0; key < 2 * keys; key += 2) {
+        concurrentMapPut(concurrent, &key, &key);
+        mapPut(map, &key, &key);
+    }
+
+    const int read_percents[] = { 100, 95, 50 };
+    printf("%d keys, %d operations per thread, throughput in millions of operations per second\n", keys, operations);
+    printf("%6s  %-8s %14s %14s\n", "reads", "threads", "ConcurrentMap", "mutex + Map");
+    for (size_t r = 0; r < sizeof(read_percents) / sizeof(read_percents[0]); r++) {
+        for (int threads = 1; threads <= max_threads; threads = nextThreads(threads, max_threads)) {
+            double sharded = runThreads(concurrent, NULL, threads, keys, operations, read_percents[r]);
+            double global = runThreads(NULL, map, threads, keys, operations, read_percents[r]);
+            printf("%5d%%  %-8d %14.2f %14.2f\n", read_percents[r], threads, sharded, global);
+        }
+    }
+
+    concurrentMapDestroy(concurrent);
+    mapDestroy(map);
+    return 0;
+}
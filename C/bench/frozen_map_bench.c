@@ -0,0 +1,97 @@
+#define _POSIX_C_SOURCE 200112L
+
+/**
+* Compares point lookups in a FrozenMap, with and without its hash index, to lookups in the
+* live Map it was frozen from (both a Map which copies its elements and an inline Map).
+* Half of the looked up keys are in the map.
+*
+* Usage: frozen_map_bench [keys] [lookups]
+*/
+
+#include "../frozen_map.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_KEYS 1000000
+#define DEFAULT_LOOKUPS 5000000
+
+typedef MapDataElement(*lookupFunction)(void* map, MapKeyElement keyElement);
+
+static size_t sizeInt(void* element)
+{
+    (void)element;
+    return sizeof(int);
+}
+
+static MapDataElement lookupMap(void* map, MapKeyElement keyElement)
+{
+    return mapGet((Map)map, keyElement);
+}
+
+static MapDataElement lookupFrozen(void* map, MapKeyElement keyElement)
+{
+    return frozenMapGet((FrozenMap)map, keyElement);
+}
+
+static void measure(const char* name, void* map, lookupFunction lookup, int* keys, int lookups)
+{
+    long long found = 0;
+    double start = benchNow();
+    for (int i = 0; i < lookups; i++) {
+        int* data = (int*)lookup(map, &keys[i]);
+        found += (data != NULL ? *data : 0);
+    }
+    double seconds = benchNow() - start;
+    printf("%-24s %8.1f ns per lookup   (checksum %lld)\n", name, seconds * 1e9 / lookups, found);
+}
+
+int main(int argc, char** argv)
+{
+    int size = (argc > 1 ? atoi(argv[1]) : DEFAULT_KEYS);
+    int lookups = (argc > 2 ? atoi(argv[2]) : DEFAULT_LOOKUPS);
+    if (size < 1 || lookups < 1) {
+        fprintf(stderr, "usage: %s [keys] [lookups]\n", argv[0]);
+        return 1;
+    }
+
+    Map map = mapCreate(benchCopyInt, benchCopyInt, benchFreeInt, benchFreeInt, benchCompareInts);
+    Map inline_map = mapCreateInline(sizeof(int), sizeof(int), benchCompareInts);
+    int* keys = (int*)malloc(lookups * sizeof(int));
+    if (map == NULL || inline_map == NULL || keys == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < size; i++) {
+        int key = 2 * i; // the odd keys are missing
+        mapPut(map, &key, &i);
+        mapPut(inline_map, &key, &i);
+    }
+    for (int i = 0; i < lookups; i++) {
+        keys[i] = (int)(benchRandom(&state) % (unsigned int)(2 * size));
+    }
+
+    double start = benchNow();
+    FrozenMap frozen = mapFreeze(map, sizeInt, sizeInt, NULL);
+    double freeze_seconds = benchNow() - start;
+    FrozenMap hashed = mapFreeze(map, sizeInt, sizeInt, benchHashInt);
+    if (frozen == NULL || hashed == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    printf("%d keys, %d random lookups, frozen in %.1f ms\n", size, lookups, freeze_seconds * 1e3);
+    measure("Map", map, lookupMap, keys, lookups);
+    measure("Map (inline)", inline_map, lookupMap, keys, lookups);
+    measure("FrozenMap", frozen, lookupFrozen, keys, lookups);
+    measure("FrozenMap (hash index)", hashed, lookupFrozen, keys, lookups);
+
+    frozenMapDestroy(frozen);
+    frozenMapDestroy(hashed);
+    mapDestroy(map);
+    mapDestroy(inline_map);
+    free(keys);
+    return 0;
+}
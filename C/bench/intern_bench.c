@@ -0,0 +1,250 @@
+#define _POSIX_C_SOURCE 200112L
+
+/**
+* Compares string-keyed maps and sets which copy every key they are given with ones which share
+* an InternPool, on a duplicate-heavy workload: many maps (or sets) are filled with keys drawn
+* from a small vocabulary of path-like strings, so the same strings are put over and over.
+* For each kind it reports the memory of the keys (the bytes and allocations of the copies,
+* or the memory of the pool), the time per put, per lookup, and per churn (removing a key
+* and putting it back, which frees a copy and makes a new one, unless the key is interned).
+*
+* The sets of this comparison are the list-based setCreate and setCreateInterned, so they
+* are given a smaller vocabulary and fewer adds than the maps.
+*
+* Usage: intern_bench [containers] [puts per container] [vocabulary]
+*/
+
+#include "../ordered_map.h"
+#include "../set.h"
+#include "../intern_pool.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CONTAINERS 32
+#define DEFAULT_PUTS 100000
+#define DEFAULT_VOCABULARY 10000
+#define SET_VOCABULARY_DIVISOR 10
+#define KEY_LENGTH 48
+
+static size_t key_bytes = 0; // of the key copies which are alive
+static long long key_allocations = 0;
+
+static void* copyString(void* element)
+{
+    size_t length = strlen((const char*)element) + 1;
+    char* copy = (char*)malloc(length);
+    if (copy != NULL) {
+        memcpy(copy, element, length);
+        key_bytes += length;
+        key_allocations++;
+    }
+    return copy;
+}
+
+static void freeString(void* element)
+{
+    key_bytes -= strlen((const char*)element) + 1;
+    key_allocations--;
+    free(element);
+}
+
+static int compareStrings(void* element1, void* element2)
+{
+    return strcmp((const char*)element1, (const char*)element2);
+}
+
+static bool equalStrings(void* element1, void* element2)
+{
+    return strcmp((const char*)element1, (const char*)element2) == 0;
+}
+
+typedef struct timings_t {
+    double put;
+    double get;
+    double churn;
+} Timings;
+
+static void printResult(const char* name, size_t bytes, long long allocations, Timings seconds, long long operations)
+{
+    printf("%-24s %10.2f MB %12lld %12.1f %12.1f %12.1f\n", name, bytes / 1e6, allocations,
+           seconds.put * 1e9 / operations, seconds.get * 1e9 / operations, seconds.churn * 1e9 / operations);
+}
+
+/**
+* Fills the maps with the drawn keys (data is the key's index in the vocabulary), looks all of
+* them up again, and then removes and puts back each of them. The keys are the caller's strings,
+* not the pool's. The memory of the keys is measured by the caller right after this.
+*/
+static Timings measureMaps(Map* maps, int containers, char** vocabulary, const int* draws, int puts)
+{
+    Timings seconds;
+    double start = benchNow();
+    for (int m = 0; m < containers; m++) {
+        for (int i = 0; i < puts; i++) {
+            int word = draws[(size_t)m * puts + i];
+            if (mapPut(maps[m], vocabulary[word], &word) != MAP_SUCCESS) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+            }
+        }
+    }
+    seconds.put = benchNow() - start;
+
+    long long found = 0;
+    start = benchNow();
+    for (int m = 0; m < containers; m++) {
+        for (int i = 0; i < puts; i++) {
+            found += (mapGet(maps[m], vocabulary[draws[(size_t)m * puts + i]]) != NULL);
+        }
+    }
+    seconds.get = benchNow() - start;
+
+    start = benchNow();
+    for (int m = 0; m < containers; m++) {
+        for (int i = 0; i < puts; i++) {
+            int word = draws[(size_t)m * puts + i];
+            found -= (mapRemove(maps[m], vocabulary[word]) == MAP_SUCCESS);
+            found += (mapPut(maps[m], vocabulary[word], &word) == MAP_SUCCESS);
+        }
+    }
+    seconds.churn = benchNow() - start;
+    if (found != (long long)containers * puts) {
+        fprintf(stderr, "a map lost keys\n");
+        exit(1);
+    }
+    return seconds;
+}
+
+static Timings measureSets(Set* sets, int containers, char** vocabulary, const int* draws, int adds,
+                           int set_vocabulary)
+{
+    Timings seconds;
+    double start = benchNow();
+    for (int s = 0; s < containers; s++) {
+        for (int i = 0; i < adds; i++) {
+            SetResult result = setAdd(sets[s], vocabulary[draws[(size_t)s * adds + i] % set_vocabulary]);
+            if (result != SET_SUCCESS && result != SET_ITEM_ALREADY_EXISTS) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+            }
+        }
+    }
+    seconds.put = benchNow() - start;
+
+    long long found = 0;
+    start = benchNow();
+    for (int s = 0; s < containers; s++) {
+        for (int i = 0; i < adds; i++) {
+            found += setContains(sets[s], vocabulary[draws[(size_t)s * adds + i] % set_vocabulary]);
+        }
+    }
+    seconds.get = benchNow() - start;
+
+    start = benchNow();
+    for (int s = 0; s < containers; s++) {
+        for (int i = 0; i < adds; i++) {
+            char* element = vocabulary[draws[(size_t)s * adds + i] % set_vocabulary];
+            found -= (setRemove(sets[s], element) == SET_SUCCESS);
+            found += (setAdd(sets[s], element) == SET_SUCCESS);
+        }
+    }
+    seconds.churn = benchNow() - start;
+    if (found != (long long)containers * adds) {
+        fprintf(stderr, "a set lost elements\n");
+        exit(1);
+    }
+    return seconds;
+}
+
+int main(int argc, char** argv)
+{
+    int containers = (argc > 1 ? atoi(argv[1]) : DEFAULT_CONTAINERS);
+    int puts = (argc > 2 ? atoi(argv[2]) : DEFAULT_PUTS);
+    int words = (argc > 3 ? atoi(argv[3]) : DEFAULT_VOCABULARY);
+    if (containers < 1 || puts < SET_VOCABULARY_DIVISOR || words < SET_VOCABULARY_DIVISOR) {
+        fprintf(stderr, "usage: %s [containers] [puts per container (at least %d)] [vocabulary (at least %d)]\n",
+                argv[0], SET_VOCABULARY_DIVISOR, SET_VOCABULARY_DIVISOR);
+        return 1;
+    }
+
+    char** vocabulary = (char**)malloc((size_t)words * sizeof(char*));
+    int* draws = (int*)malloc((size_t)containers * puts * sizeof(int));
+    Map* maps = (Map*)malloc((size_t)containers * sizeof(Map));
+    Set* sets = (Set*)malloc((size_t)containers * sizeof(Set));
+    if (vocabulary == NULL || draws == NULL || maps == NULL || sets == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < words; i++) {
+        vocabulary[i] = (char*)malloc(KEY_LENGTH);
+        if (vocabulary[i] == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        snprintf(vocabulary[i], KEY_LENGTH, "/srv/service-%u/endpoint-%d", benchRandom(&state) % 100, i);
+    }
+    for (long long i = 0; i < (long long)containers * puts; i++) {
+        unsigned int draw = benchRandom(&state) % (unsigned int)words;
+        draws[i] = (int)(draw * (unsigned long long)draw / (unsigned int)words); // skewed to the first words
+    }
+
+    int set_words = words / SET_VOCABULARY_DIVISOR, set_adds = puts / SET_VOCABULARY_DIVISOR;
+    printf("%d containers, %d puts each from a vocabulary of %d strings (sets: %d adds of %d strings)\n",
+           containers, puts, words, set_adds, set_words);
+    printf("%-24s %13s %12s %12s %12s %12s\n", "", "key memory", "allocations", "ns per put", "ns per get",
+           "ns per churn");
+    long long operations = (long long)containers * puts, set_operations = (long long)containers * set_adds;
+
+    for (int m = 0; m < containers; m++) {
+        maps[m] = mapCreate(benchCopyInt, copyString, benchFreeInt, freeString, compareStrings);
+    }
+    Timings seconds = measureMaps(maps, containers, vocabulary, draws, puts);
+    printResult("Map, copied keys", key_bytes, key_allocations, seconds, operations);
+    for (int m = 0; m < containers; m++) {
+        mapDestroy(maps[m]);
+    }
+
+    InternPool pool = internPoolCreate();
+    for (int m = 0; m < containers; m++) {
+        maps[m] = mapCreateInterned(pool, benchCopyInt, benchFreeInt);
+    }
+    seconds = measureMaps(maps, containers, vocabulary, draws, puts);
+    printResult("Map, interned keys", internPoolGetMemory(pool), 0, seconds, operations);
+    for (int m = 0; m < containers; m++) {
+        mapDestroy(maps[m]);
+    }
+    internPoolDestroy(pool);
+
+    for (int s = 0; s < containers; s++) {
+        sets[s] = setCreate(copyString, freeString, equalStrings);
+    }
+    seconds = measureSets(sets, containers, vocabulary, draws, set_adds, set_words);
+    printResult("Set, copied elements", key_bytes, key_allocations, seconds, set_operations);
+    for (int s = 0; s < containers; s++) {
+        setDestroy(sets[s]);
+    }
+
+    pool = internPoolCreate();
+    for (int s = 0; s < containers; s++) {
+        sets[s] = setCreateInterned(pool);
+    }
+    seconds = measureSets(sets, containers, vocabulary, draws, set_adds, set_words);
+    printResult("Set, interned elements", internPoolGetMemory(pool), 0, seconds, set_operations);
+    for (int s = 0; s < containers; s++) {
+        setDestroy(sets[s]);
+    }
+    internPoolDestroy(pool);
+
+    for (int i = 0; i < words; i++) {
+        free(vocabulary[i]);
+    }
+    free(vocabulary);
+    free(draws);
+    free(maps);
+    free(sets);
+    return 0;
+}
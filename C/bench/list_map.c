@@ -0,0 +1,234 @@
+#include "list_map.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define NULL_LIST_MAP_SIZE -1
+
+typedef struct node_t {
+    MapDataElement data;
+    MapKeyElement key;
+    struct node_t* next;
+} Node;
+
+static void removeNodeElement(ListMap map, Node* node);
+static bool addNewElement(ListMap map, MapKeyElement keyElement, MapDataElement dataElement);
+static bool updateExistingElement(ListMap map, MapKeyElement keyElement, MapDataElement dataElement);
+
+struct list_map_t {
+    Node* head;
+    int size;
+    copyMapDataElements copyDataElement;
+    copyMapKeyElements copyKeyElement;
+    freeMapDataElements freeDataElement;
+    freeMapKeyElements freeKeyElement;
+    compareMapKeyElements compareKeyElements;
+};
+
+ListMap listMapCreate(copyMapDataElements copyDataElement,
+                      copyMapKeyElements copyKeyElement,
+                      freeMapDataElements freeDataElement,
+                      freeMapKeyElements freeKeyElement,
+                      compareMapKeyElements compareKeyElements)
+{
+    if(copyDataElement == NULL || copyKeyElement == NULL ||
+       freeDataElement == NULL || freeKeyElement == NULL || compareKeyElements == NULL ) {
+        return NULL; 
+    }
+    ListMap map = (ListMap)malloc(sizeof(*map));
+    if(map == NULL) {
+        return NULL;
+    }
+    map->size = 0;
+    map->head = NULL; 
+    map->copyDataElement = copyDataElement;
+    map->copyKeyElement = copyKeyElement;
+    map->freeDataElement = freeDataElement;
+    map->freeKeyElement = freeKeyElement;
+    map->compareKeyElements = compareKeyElements;
+
+    return map;
+}
+
+void listMapDestroy(ListMap map)
+{
+    if(map == NULL) {
+        return;
+    }
+    listMapClear(map);
+    free(map);
+}
+
+int listMapGetSize(ListMap map)
+{
+    if (map == NULL) {
+        return NULL_LIST_MAP_SIZE;
+    }
+
+    return map->size;
+}
+
+bool listMapContains(ListMap map, MapKeyElement element)
+{
+    if(map == NULL || element == NULL) {
+        return false;
+    }
+    Node* ptr = map->head;
+    while(ptr != NULL) {
+        if(!(map->compareKeyElements(ptr->key , element))) {
+            return true;
+        }
+        ptr = ptr->next;
+    }
+    return false;
+}
+
+MapResult listMapPut(ListMap map, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    if (map == NULL || keyElement == NULL || dataElement == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    if (!listMapContains(map, keyElement))  {
+        if (!addNewElement(map, keyElement, dataElement)) {
+            return MAP_OUT_OF_MEMORY;
+        }
+    }
+    else {
+        if (!updateExistingElement(map, keyElement, dataElement)) {
+            return MAP_OUT_OF_MEMORY;
+        }
+    }
+
+    return MAP_SUCCESS;
+}
+
+static bool addNewElement(ListMap map, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    Node* new_node = (Node*)malloc(sizeof(*new_node));
+    if (new_node == NULL) {
+        return false;
+    }
+    
+    new_node->key = map->copyKeyElement(keyElement);
+    if(new_node->key == NULL) {
+        free(new_node);
+        return false;
+    }
+
+    new_node->data = map->copyDataElement(dataElement);
+    if(new_node->data == NULL) {
+        free(new_node->key);
+        free(new_node);
+        return false;
+    }
+
+    Node* ptr = map->head;
+    if (ptr == NULL) { // map was empty, adding its head
+        new_node->next = NULL;
+        map->head = new_node;
+        map->size++;
+        return true;
+    }
+    
+    Node* next = ptr->next;
+    while(next != NULL && map->compareKeyElements(keyElement, next->key) > 0) {
+        ptr = next;
+        next = ptr->next;
+    } // ptr is now the last element whose key's smaller than keyElement
+    
+
+    if (ptr == map->head && map->compareKeyElements(keyElement, ptr->key) < 0) {
+        new_node->next = ptr;
+        map->head = new_node;
+    }
+    else {
+        ptr->next = new_node;
+        new_node->next = next;
+    }
+
+    map->size++;
+    return true;
+}
+
+static bool updateExistingElement(ListMap map, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    Node* ptr = map->head;
+    while (map->compareKeyElements(keyElement, ptr->key)) {
+        ptr = ptr->next;
+    }
+    MapDataElement data = ptr->data;
+    ptr->data = map->copyDataElement(dataElement);
+    map->freeDataElement(data);
+    if (ptr->data == NULL) {
+        return false;
+    }
+    return true;
+}
+
+MapDataElement listMapGet(ListMap map, MapKeyElement keyElement)
+{
+    if(map == NULL || keyElement == NULL) {
+        return NULL;
+    }
+    Node* ptr = map->head; 
+    while(ptr != NULL) {
+        if(!(map->compareKeyElements(ptr->key ,keyElement))) {
+            return ptr->data;
+        }
+        ptr = ptr->next;
+    }
+    return NULL;
+}
+
+MapResult listMapClear(ListMap map)
+{
+    if (map == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    while(map->head != NULL) {
+        Node* ptr = map->head;
+        map->head = map->head->next;
+        removeNodeElement(map, ptr);
+    }
+
+    return MAP_SUCCESS;
+}
+
+MapResult listMapRemove(ListMap map, MapKeyElement keyElement)
+{
+    if(map == NULL || keyElement == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (map->head == NULL) {
+        return MAP_ITEM_DOES_NOT_EXIST;
+    }
+
+    Node* ptr = map->head;
+    if(!(map->compareKeyElements(ptr->key , keyElement))) {
+        map->head = map->head->next;
+        removeNodeElement(map , ptr);
+        return MAP_SUCCESS;
+    }
+
+    while(ptr->next != NULL) {
+        if(!(map->compareKeyElements(ptr->next->key , keyElement))) {
+            Node* next = ptr->next;
+            ptr->next = next->next;
+            removeNodeElement(map, next);
+            return MAP_SUCCESS;
+        }
+        ptr = ptr->next;
+    }
+    
+    return MAP_ITEM_DOES_NOT_EXIST;   
+}
+
+static void removeNodeElement(ListMap map, Node* node)
+{
+    map->freeDataElement(node->data);
+    map->freeKeyElement(node->key);
+    map->size--;
+    free(node);
+}
@@ -0,0 +1,27 @@
+#ifndef LIST_MAP_H_
+#define LIST_MAP_H_
+
+#include "../ordered_map.h"
+
+/**
+* The ordered map as it was before it was stored in a B-tree: a sorted singly linked list,
+* whose every operation scans it from the head. It is kept here only as the baseline of the
+* benchmarks, with the same element functions and results as the Map of ordered_map.h.
+*/
+
+typedef struct list_map_t * ListMap;
+
+ListMap listMapCreate(copyMapDataElements   copyDataElement,
+                      copyMapKeyElements    copyKeyElement,
+                      freeMapDataElements   freeDataElement,
+                      freeMapKeyElements    freeKeyElement,
+                      compareMapKeyElements compareKeyElements);
+void listMapDestroy(ListMap map);
+int listMapGetSize(ListMap map);
+bool listMapContains(ListMap map, MapKeyElement element);
+MapResult listMapPut(ListMap map, MapKeyElement keyElement, MapDataElement dataElement);
+MapDataElement listMapGet(ListMap map, MapKeyElement keyElement);
+MapResult listMapRemove(ListMap map, MapKeyElement keyElement);
+MapResult listMapClear(ListMap map);
+
+#endif
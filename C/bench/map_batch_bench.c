@@ -0,0 +1,167 @@
+#define _POSIX_C_SOURCE 200112L
+
+/**
+* Compares looking up a batch of keys with mapGetMany to looking up the same keys one by one
+* with mapGet, and putting a batch with mapPutMany to putting its pairs one by one.
+* The batches are either random keys of the whole map, or clustered in a small part of it.
+*
+* A batch saves the cache misses of the searches, but every key still takes about as many calls
+* to the compare function as mapGet does. So the lookups are also timed a second time right after
+* the first (warm), when the nodes on their paths are already in the cache: the time that is left
+* is the cost of the comparisons, and the speedup of a batch cannot go much beyond cold / warm.
+*
+* Usage: map_batch_bench [keys] [batch size] [batches]
+*/
+
+#include "../ordered_map.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define DEFAULT_KEYS 1000000
+#define DEFAULT_BATCH 1000
+#define DEFAULT_BATCHES 1000
+#define CLUSTER_SPAN 64 // a clustered batch falls in a range of CLUSTER_SPAN times its size
+
+/**
+* Fills keys with batches * batch keys (of even numbers, which are in the map), batch after batch.
+*/
+static void drawKeys(int* keys, int size, int batch, int batches, bool clustered, unsigned long long* state)
+{
+    for (int b = 0; b < batches; b++) {
+        int span = (clustered ? CLUSTER_SPAN * batch : size);
+        span = (span < size ? span : size);
+        int start = (int)(benchRandom(state) % (unsigned int)(size - span + 1));
+        for (int i = 0; i < batch; i++) {
+            keys[b * batch + i] = 2 * (start + (int)(benchRandom(state) % (unsigned int)span));
+        }
+    }
+}
+
+static void measureGets(const char* name, Map map, int* keys, int batch, int batches)
+{
+    MapKeyElement* key_elements = (MapKeyElement*)malloc(batch * sizeof(MapKeyElement));
+    MapDataElement* data_elements = (MapDataElement*)malloc(batch * sizeof(MapDataElement));
+    if (key_elements == NULL || data_elements == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    long long single_sum = 0, warm_sum = 0, batch_sum = 0;
+    double start = benchNow();
+    for (int i = 0; i < batch * batches; i++) {
+        int* data = (int*)mapGet(map, &keys[i]);
+        single_sum += (data != NULL ? *data : 0);
+    }
+    double single = benchNow() - start;
+
+    double warm = 0;
+    for (int b = 0; b < batches; b++) {
+        for (int i = b * batch; i < (b + 1) * batch; i++) {
+            mapGet(map, &keys[i]); // brings the paths of the batch into the cache
+        }
+        start = benchNow();
+        for (int i = b * batch; i < (b + 1) * batch; i++) {
+            int* data = (int*)mapGet(map, &keys[i]);
+            warm_sum += (data != NULL ? *data : 0);
+        }
+        warm += benchNow() - start;
+    }
+
+    start = benchNow();
+    for (int b = 0; b < batches; b++) {
+        for (int i = 0; i < batch; i++) {
+            key_elements[i] = &keys[b * batch + i];
+        }
+        mapGetMany(map, key_elements, batch, data_elements);
+        for (int i = 0; i < batch; i++) {
+            batch_sum += (data_elements[i] != NULL ? *(int*)data_elements[i] : 0);
+        }
+    }
+    double batched = benchNow() - start;
+
+    printf("%-24s mapGet %7.1f us (warm %7.1f us)   mapGetMany %7.1f us   speedup %5.2fx (warm bound %5.2fx)%s\n",
+           name, single * 1e6 / batches, warm * 1e6 / batches, batched * 1e6 / batches, single / batched,
+           single / warm, (single_sum == warm_sum && single_sum == batch_sum ? "" : "   (results differ!)"));
+    free(key_elements);
+    free(data_elements);
+}
+
+static void measurePuts(const char* name, Map map, int* keys, int batch, int batches)
+{
+    MapKeyElement* key_elements = (MapKeyElement*)malloc(batch * sizeof(MapKeyElement));
+    MapDataElement* data_elements = (MapDataElement*)malloc(batch * sizeof(MapDataElement));
+    if (key_elements == NULL || data_elements == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    // the keys are already in the map, so both ways replace the same data and the map does not grow
+    double start = benchNow();
+    for (int i = 0; i < batch * batches; i++) {
+        mapPut(map, &keys[i], &keys[i]);
+    }
+    double single = benchNow() - start;
+
+    start = benchNow();
+    for (int b = 0; b < batches; b++) {
+        for (int i = 0; i < batch; i++) {
+            key_elements[i] = &keys[b * batch + i];
+            data_elements[i] = &keys[b * batch + i];
+        }
+        mapPutMany(map, key_elements, data_elements, batch);
+    }
+    double batched = benchNow() - start;
+
+    printf("%-24s mapPut %7.1f us                      mapPutMany %7.1f us   speedup %5.2fx\n", name,
+           single * 1e6 / batches, batched * 1e6 / batches, single / batched);
+    free(key_elements);
+    free(data_elements);
+}
+
+int main(int argc, char** argv)
+{
+    int size = (argc > 1 ? atoi(argv[1]) : DEFAULT_KEYS);
+    int batch = (argc > 2 ? atoi(argv[2]) : DEFAULT_BATCH);
+    int batches = (argc > 3 ? atoi(argv[3]) : DEFAULT_BATCHES);
+    if (size < 1 || batch < 1 || batches < 1) {
+        fprintf(stderr, "usage: %s [keys] [batch size] [batches]\n", argv[0]);
+        return 1;
+    }
+
+    Map map = mapCreate(benchCopyInt, benchCopyInt, benchFreeInt, benchFreeInt, benchCompareInts);
+    Map inline_map = mapCreateInline(sizeof(int), sizeof(int), benchCompareInts);
+    int* keys = (int*)malloc((size_t)batch * batches * sizeof(int));
+    if (map == NULL || inline_map == NULL || keys == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < size; i++) {
+        int key = 2 * i;
+        mapPut(map, &key, &key);
+        mapPut(inline_map, &key, &key);
+    }
+
+    printf("%d keys, %d batches of %d keys, time per batch\n", size, batches, batch);
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    for (int clustered = 0; clustered <= 1; clustered++) {
+        drawKeys(keys, size, batch, batches, clustered, &state);
+        const char* order = (clustered ? "clustered" : "random");
+        char name[64];
+        snprintf(name, sizeof(name), "Map, %s", order);
+        measureGets(name, map, keys, batch, batches);
+        snprintf(name, sizeof(name), "inline Map, %s", order);
+        measureGets(name, inline_map, keys, batch, batches);
+        snprintf(name, sizeof(name), "Map, %s", order);
+        measurePuts(name, map, keys, batch, batches);
+        snprintf(name, sizeof(name), "inline Map, %s", order);
+        measurePuts(name, inline_map, keys, batch, batches);
+    }
+
+    mapDestroy(map);
+    mapDestroy(inline_map);
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,123 @@
+#define _POSIX_C_SOURCE 200112L
+
+/**
+* Counts the calls to the compare function per put, with a counting comparator, for three ways
+* of filling a map with the same keys: searching twice (mapContains and then mapPut, as the
+* map's put used to do), mapPut alone, and mapPutHint with the cursor of the previous put.
+* The keys come in ascending order, descending order, runs of consecutive keys which start
+* at random places, or a random order.
+*
+* Usage: map_hint_bench [keys]
+*/
+
+#include "../ordered_map.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_KEYS 1000000
+#define RUN_LENGTH 100
+
+typedef enum { SEARCH_TWICE, PUT, PUT_HINT, METHODS_COUNT } Method;
+
+static const char* const method_names[METHODS_COUNT] = { "mapContains + mapPut", "mapPut", "mapPutHint" };
+
+static long long comparisons = 0;
+
+static int compareCounting(void* element1, void* element2)
+{
+    comparisons++;
+    return benchCompareInts(element1, element2);
+}
+
+static void drawKeys(int* keys, int size, const char* order, unsigned long long* state)
+{
+    for (int i = 0; i < size; i++) {
+        keys[i] = i;
+    }
+    if (order[0] == 'd') { // descending
+        for (int i = 0; i < size; i++) {
+            keys[i] = size - 1 - i;
+        }
+    }
+    else if (order[0] == 'r' && order[1] == 'u') { // runs: shuffle the runs, keep the keys inside each
+        int runs = (size + RUN_LENGTH - 1) / RUN_LENGTH;
+        for (int i = runs - 1; i > 0; i--) {
+            int j = (int)(benchRandom(state) % (unsigned int)(i + 1));
+            for (int k = 0; k < RUN_LENGTH && i * RUN_LENGTH + k < size && j * RUN_LENGTH + k < size; k++) {
+                int key = keys[i * RUN_LENGTH + k];
+                keys[i * RUN_LENGTH + k] = keys[j * RUN_LENGTH + k];
+                keys[j * RUN_LENGTH + k] = key;
+            }
+        }
+    }
+    else if (order[0] == 'r') { // random
+        for (int i = size - 1; i > 0; i--) {
+            int j = (int)(benchRandom(state) % (unsigned int)(i + 1));
+            int key = keys[i];
+            keys[i] = keys[j];
+            keys[j] = key;
+        }
+    }
+}
+
+static void measure(Method method, int* keys, int size)
+{
+    Map map = mapCreate(benchCopyInt, benchCopyInt, benchFreeInt, benchFreeInt, compareCounting);
+    if (map == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    MapCursor hint = { 0 }; // points at no map, so the first put ignores it
+    comparisons = 0;
+    double start = benchNow();
+    for (int i = 0; i < size; i++) {
+        MapResult result;
+        if (method == SEARCH_TWICE) {
+            mapContains(map, &keys[i]);
+            result = mapPut(map, &keys[i], &keys[i]);
+        }
+        else if (method == PUT) {
+            result = mapPut(map, &keys[i], &keys[i]);
+        }
+        else {
+            result = mapPutHint(map, &hint, &keys[i], &keys[i]);
+        }
+        if (result != MAP_SUCCESS) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    double seconds = benchNow() - start;
+    printf("  %-22s %8.2f compares per put %10.1f ns per put\n", method_names[method],
+           (double)comparisons / size, seconds * 1e9 / size);
+    mapDestroy(map);
+}
+
+int main(int argc, char** argv)
+{
+    int size = (argc > 1 ? atoi(argv[1]) : DEFAULT_KEYS);
+    if (size < 1) {
+        fprintf(stderr, "usage: %s [keys]\n", argv[0]);
+        return 1;
+    }
+    int* keys = (int*)malloc((size_t)size * sizeof(int));
+    if (keys == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    const char* const orders[] = { "ascending", "descending", "runs of 100", "random" };
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    for (size_t o = 0; o < sizeof(orders) / sizeof(orders[0]); o++) {
+        drawKeys(keys, size, orders[o], &state);
+        printf("%d keys, %s\n", size, orders[o]);
+        for (int method = 0; method < METHODS_COUNT; method++) {
+            measure(method, keys, size);
+        }
+    }
+
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,141 @@
+#define _POSIX_C_SOURCE 200112L
+
+/**
+* Compares visiting the keys in a range [low, high) with mapRangeForEach to scanning the whole
+* map with mapForEach and filtering its keys, at ranges of about 0.1%, 1%, 10% and 100% of the
+* keys. Then compares removing such a range with mapRemoveRange to finding its keys with a full
+* scan and removing them one by one with mapRemove (each on a fresh copy of the map).
+*
+* Usage: map_range_bench [keys] [scans per range size]
+*/
+
+#include "../ordered_map.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_KEYS 1000000
+#define DEFAULT_SCANS 100
+
+typedef struct range_t {
+    int low;
+    int high;
+    long long sum;  // of the data of the visited pairs
+    int* keys;      // if not NULL, the visited keys are stored here
+    int count;
+} Range;
+
+static bool visitRange(MapKeyElement keyElement, MapDataElement dataElement, void* context)
+{
+    (void)keyElement;
+    Range* range = (Range*)context;
+    range->sum += *(int*)dataElement;
+    return true;
+}
+
+static bool filterRange(MapKeyElement keyElement, MapDataElement dataElement, void* context)
+{
+    Range* range = (Range*)context;
+    int key = *(int*)keyElement;
+    if (key >= range->low && key < range->high) {
+        range->sum += *(int*)dataElement;
+        if (range->keys != NULL) {
+            range->keys[range->count++] = key;
+        }
+    }
+    return true;
+}
+
+static Range drawRange(int size, int span, unsigned long long* state)
+{
+    Range range = { 0, 0, 0, NULL, 0 };
+    range.low = (int)(benchRandom(state) % (unsigned int)(size - span + 1));
+    range.high = range.low + span;
+    return range;
+}
+
+static void measureScans(Map map, int size, int span, int scans, unsigned long long* state)
+{
+    double range_seconds = 0, filter_seconds = 0;
+    bool same = true;
+    for (int i = 0; i < scans; i++) {
+        Range ranged = drawRange(size, span, state), filtered = ranged;
+        double start = benchNow();
+        mapRangeForEach(map, &ranged.low, &ranged.high, visitRange, &ranged);
+        range_seconds += benchNow() - start;
+        start = benchNow();
+        mapForEach(map, filterRange, &filtered);
+        filter_seconds += benchNow() - start;
+        same = same && ranged.sum == filtered.sum;
+    }
+    printf("  %-16s %9.3f ms   %-22s %9.3f ms   speedup %7.1fx%s\n", "mapRangeForEach",
+           range_seconds * 1e3 / scans, "mapForEach + filter", filter_seconds * 1e3 / scans,
+           filter_seconds / range_seconds,
+           (same ? "" : "   (results differ!)"));
+}
+
+static void measureRemoval(Map map, int size, int span, unsigned long long* state)
+{
+    Map ranged = mapCopy(map), filtered = mapCopy(map);
+    Range range = drawRange(size, span, state);
+    range.keys = (int*)malloc((size_t)span * sizeof(int));
+    if (ranged == NULL || filtered == NULL || range.keys == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    double start = benchNow();
+    mapRemoveRange(ranged, &range.low, &range.high);
+    double range_seconds = benchNow() - start;
+
+    start = benchNow();
+    mapForEach(filtered, filterRange, &range);
+    for (int i = 0; i < range.count; i++) {
+        mapRemove(filtered, &range.keys[i]);
+    }
+    double filter_seconds = benchNow() - start;
+
+    printf("  %-16s %9.3f ms   %-22s %9.3f ms   speedup %7.1fx%s\n", "mapRemoveRange",
+           range_seconds * 1e3, "mapForEach + mapRemove", filter_seconds * 1e3, filter_seconds / range_seconds,
+           (mapGetSize(ranged) == size - span && mapGetSize(filtered) == size - span ? "" : "   (results differ!)"));
+    free(range.keys);
+    mapDestroy(ranged);
+    mapDestroy(filtered);
+}
+
+int main(int argc, char** argv)
+{
+    int size = (argc > 1 ? atoi(argv[1]) : DEFAULT_KEYS);
+    int scans = (argc > 2 ? atoi(argv[2]) : DEFAULT_SCANS);
+    if (size < 1 || scans < 1) {
+        fprintf(stderr, "usage: %s [keys] [scans per range size]\n", argv[0]);
+        return 1;
+    }
+
+    Map map = mapCreate(benchCopyInt, benchCopyInt, benchFreeInt, benchFreeInt, benchCompareInts);
+    if (map == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int key = 0; key < size; key++) {
+        if (mapPut(map, &key, &key) != MAP_SUCCESS) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    }
+
+    const double selectivities[] = { 0.001, 0.01, 0.1, 1 };
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    printf("%d keys, %d scans per range size, time per scan or removal\n", size, scans);
+    for (size_t s = 0; s < sizeof(selectivities) / sizeof(selectivities[0]); s++) {
+        int span = (int)(size * selectivities[s]);
+        span = (span < 1 ? 1 : span);
+        printf("ranges of %d keys (%g%%)\n", span, selectivities[s] * 100);
+        measureScans(map, size, span, scans, &state);
+        measureRemoval(map, size, span, &state);
+    }
+
+    mapDestroy(map);
+    return 0;
+}
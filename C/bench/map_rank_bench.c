@@ -0,0 +1,104 @@
+#define _POSIX_C_SOURCE 200112L
+
+/**
+* Compares the order statistics of the map with walking it: selecting the k-th smallest key with
+* mapGetByRank against stepping a cursor k times from the first key, and ranking a key with mapRank
+* against counting the smaller keys with a cursor. The ranks and keys are drawn uniformly, so a walk
+* visits half of the map on average.
+*
+* Usage: map_rank_bench [keys] [queries]
+*/
+
+#include "../ordered_map.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_KEYS 1000000
+#define DEFAULT_QUERIES 1000
+#define WALK_QUERIES_DIVISOR 10 // the walks are slow, so they answer only a part of the queries
+
+static int* walkToRank(Map map, int rank)
+{
+    MapCursor cursor;
+    bool valid = mapCursorFirst(map, &cursor);
+    for (int i = 0; valid && i < rank; i++) {
+        valid = mapCursorNext(&cursor);
+    }
+    return (valid ? (int*)mapCursorGetKey(&cursor) : NULL);
+}
+
+static int walkRank(Map map, int key)
+{
+    MapCursor cursor;
+    int rank = 0;
+    for (bool valid = mapCursorFirst(map, &cursor); valid && *(int*)mapCursorGetKey(&cursor) < key;
+         valid = mapCursorNext(&cursor)) {
+        rank++;
+    }
+    return rank;
+}
+
+int main(int argc, char** argv)
+{
+    int size = (argc > 1 ? atoi(argv[1]) : DEFAULT_KEYS);
+    int queries = (argc > 2 ? atoi(argv[2]) : DEFAULT_QUERIES);
+    if (size < 1 || queries < WALK_QUERIES_DIVISOR) {
+        fprintf(stderr, "usage: %s [keys] [queries (at least %d)]\n", argv[0], WALK_QUERIES_DIVISOR);
+        return 1;
+    }
+    int walk_queries = queries / WALK_QUERIES_DIVISOR;
+
+    Map map = mapCreate(benchCopyInt, benchCopyInt, benchFreeInt, benchFreeInt, benchCompareInts);
+    int* ranks = (int*)malloc((size_t)queries * sizeof(int));
+    if (map == NULL || ranks == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < size; i++) {
+        int key = 2 * i; // so the odd keys are ranked between them
+        mapPut(map, &key, &key);
+    }
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < queries; i++) {
+        ranks[i] = (int)(benchRandom(&state) % (unsigned int)size);
+    }
+
+    long long tree_sum = 0, walk_sum = 0;
+    double start = benchNow();
+    for (int i = 0; i < queries; i++) {
+        int* key = (int*)mapGetByRank(map, ranks[i]);
+        tree_sum += (i < walk_queries ? *key : 0);
+    }
+    double tree = (benchNow() - start) / queries;
+    start = benchNow();
+    for (int i = 0; i < walk_queries; i++) {
+        walk_sum += *walkToRank(map, ranks[i]);
+    }
+    double walk = (benchNow() - start) / walk_queries;
+    printf("%d keys\n", size);
+    printf("select  mapGetByRank %10.3f us   cursor walk %10.1f us   speedup %9.1fx%s\n", tree * 1e6,
+           walk * 1e6, walk / tree, (tree_sum == walk_sum ? "" : "   (results differ!)"));
+
+    tree_sum = 0;
+    walk_sum = 0;
+    start = benchNow();
+    for (int i = 0; i < queries; i++) {
+        int key = 2 * ranks[i] + (i % 2); // every other key is absent
+        int rank = mapRank(map, &key);
+        tree_sum += (i < walk_queries ? rank : 0);
+    }
+    tree = (benchNow() - start) / queries;
+    start = benchNow();
+    for (int i = 0; i < walk_queries; i++) {
+        walk_sum += walkRank(map, 2 * ranks[i] + (i % 2));
+    }
+    walk = (benchNow() - start) / walk_queries;
+    printf("rank    mapRank      %10.3f us   cursor walk %10.1f us   speedup %9.1fx%s\n", tree * 1e6,
+           walk * 1e6, walk / tree, (tree_sum == walk_sum ? "" : "   (results differ!)"));
+
+    mapDestroy(map);
+    free(ranks);
+    return 0;
+}
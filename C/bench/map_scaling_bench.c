@@ -0,0 +1,157 @@
+#define _POSIX_C_SOURCE 200112L
+
+/**
+* Measures how put, get and remove of the B-tree Map scale from 1K keys up to the given number,
+* growing tenfold, next to the sorted linked list the map was stored in before (see list_map.h).
+* Every size puts its keys in a random order into an empty map, gets all of them and then removes
+* all of them, each in another random order. The list takes quadratic time to fill, so it is only
+* measured up to its own, smaller limit.
+*
+* Usage: map_scaling_bench [max keys] [max list keys]
+*/
+
+#include "../ordered_map.h"
+#include "list_map.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MIN_KEYS 1000
+#define DEFAULT_MAX_KEYS 10000000
+#define DEFAULT_MAX_LIST_KEYS 10000
+
+typedef struct timings_t {
+    double put;
+    double get;
+    double remove;
+} Timings;
+
+static void shuffle(int* keys, int size, unsigned long long* state)
+{
+    for (int i = size - 1; i > 0; i--) {
+        int j = (int)(benchRandom(state) % (unsigned int)(i + 1));
+        int key = keys[i];
+        keys[i] = keys[j];
+        keys[j] = key;
+    }
+}
+
+/**
+* Times the operations of one map, in nanoseconds per operation.
+* Exits if the map did not find a key it was given, so a broken map cannot look fast.
+*/
+static Timings measureMap(int* keys, int size, unsigned long long* state)
+{
+    Map map = mapCreate(benchCopyInt, benchCopyInt, benchFreeInt, benchFreeInt, benchCompareInts);
+    if (map == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    Timings timings;
+    bool failed = false;
+    shuffle(keys, size, state);
+    double start = benchNow();
+    for (int i = 0; i < size; i++) {
+        failed |= (mapPut(map, &keys[i], &keys[i]) != MAP_SUCCESS);
+    }
+    timings.put = (benchNow() - start) * 1e9 / size;
+
+    shuffle(keys, size, state);
+    start = benchNow();
+    for (int i = 0; i < size; i++) {
+        int* data = (int*)mapGet(map, &keys[i]);
+        failed |= (data == NULL || *data != keys[i]);
+    }
+    timings.get = (benchNow() - start) * 1e9 / size;
+
+    shuffle(keys, size, state);
+    start = benchNow();
+    for (int i = 0; i < size; i++) {
+        failed |= (mapRemove(map, &keys[i]) != MAP_SUCCESS);
+    }
+    timings.remove = (benchNow() - start) * 1e9 / size;
+
+    if (failed || mapGetSize(map) != 0) {
+        fprintf(stderr, "the map lost keys at size %d\n", size);
+        exit(1);
+    }
+    mapDestroy(map);
+    return timings;
+}
+
+static Timings measureListMap(int* keys, int size, unsigned long long* state)
+{
+    ListMap map = listMapCreate(benchCopyInt, benchCopyInt, benchFreeInt, benchFreeInt, benchCompareInts);
+    if (map == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    Timings timings;
+    bool failed = false;
+    shuffle(keys, size, state);
+    double start = benchNow();
+    for (int i = 0; i < size; i++) {
+        failed |= (listMapPut(map, &keys[i], &keys[i]) != MAP_SUCCESS);
+    }
+    timings.put = (benchNow() - start) * 1e9 / size;
+
+    shuffle(keys, size, state);
+    start = benchNow();
+    for (int i = 0; i < size; i++) {
+        int* data = (int*)listMapGet(map, &keys[i]);
+        failed |= (data == NULL || *data != keys[i]);
+    }
+    timings.get = (benchNow() - start) * 1e9 / size;
+
+    shuffle(keys, size, state);
+    start = benchNow();
+    for (int i = 0; i < size; i++) {
+        failed |= (listMapRemove(map, &keys[i]) != MAP_SUCCESS);
+    }
+    timings.remove = (benchNow() - start) * 1e9 / size;
+
+    if (failed || listMapGetSize(map) != 0) {
+        fprintf(stderr, "the list map lost keys at size %d\n", size);
+        exit(1);
+    }
+    listMapDestroy(map);
+    return timings;
+}
+
+int main(int argc, char** argv)
+{
+    int max_keys = (argc > 1 ? atoi(argv[1]) : DEFAULT_MAX_KEYS);
+    int max_list_keys = (argc > 2 ? atoi(argv[2]) : DEFAULT_MAX_LIST_KEYS);
+    if (max_keys < MIN_KEYS || max_list_keys < 0) {
+        fprintf(stderr, "usage: %s [max keys (at least %d)] [max list keys]\n", argv[0], MIN_KEYS);
+        return 1;
+    }
+    int* keys = (int*)malloc((size_t)max_keys * sizeof(int));
+    if (keys == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    printf("time per operation in ns, keys put, got and removed in random orders\n");
+    printf("%-10s %10s %10s %10s   %11s %11s %11s\n", "keys", "put", "get", "remove",
+           "list put", "list get", "list remove");
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    for (long long size = MIN_KEYS; size <= max_keys; size *= 10) {
+        for (int i = 0; i < size; i++) {
+            keys[i] = i;
+        }
+        Timings tree = measureMap(keys, (int)size, &state);
+        printf("%-10lld %10.1f %10.1f %10.1f", size, tree.put, tree.get, tree.remove);
+        if (size <= max_list_keys) {
+            Timings list = measureListMap(keys, (int)size, &state);
+            printf("   %11.1f %11.1f %11.1f\n", list.put, list.get, list.remove);
+        }
+        else {
+            printf("   %11s %11s %11s\n", "-", "-", "-");
+        }
+    }
+
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,191 @@
+#define _POSIX_C_SOURCE 200112L
+
+/**
+* Measures how listApplyParallel, listFilterParallel and setFilterParallel scale with the
+* number of threads of their pool, from 1 up to the given number, next to listApply, listFilter
+* and setFilter on the same elements. The work per element is a loop of the given length,
+* so that it costs more than walking to the element (as the parallel functions expect).
+*
+* Usage: parallel_bench [max threads] [elements] [work per element]
+*/
+
+#include "../list.h"
+#include "../set.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#define DEFAULT_ELEMENTS 1000000
+#define DEFAULT_WORK 200
+
+typedef struct pair_t {
+    int key;
+    int value; // set by the apply function from the key alone, so applying it again changes nothing
+} Pair;
+
+typedef enum { APPLY_LIST, FILTER_LIST, FILTER_SET, OPERATIONS_COUNT } Operation;
+
+static const char* const operation_names[OPERATIONS_COUNT] = { "list apply", "list filter", "set filter" };
+
+static int work_per_element = DEFAULT_WORK;
+
+static int spin(int key)
+{
+    unsigned long long state = (unsigned long long)key * 0x9E3779B97F4A7C15ULL + 1;
+    unsigned int result = 0;
+    for (int i = 0; i < work_per_element; i++) {
+        result += benchRandom(&state);
+    }
+    return (int)(result >> 1);
+}
+
+static Element copyPair(Element element)
+{
+    Pair* copy = (Pair*)malloc(sizeof(Pair));
+    if (copy != NULL) {
+        *copy = *(Pair*)element;
+    }
+    return copy;
+}
+
+static void freePair(Element element)
+{
+    free(element);
+}
+
+static bool equalPairs(Element element1, Element element2)
+{
+    return ((Pair*)element1)->key == ((Pair*)element2)->key;
+}
+
+static size_t hashPair(Element element)
+{
+    return (size_t)(unsigned int)((Pair*)element)->key;
+}
+
+static Element applySpin(Element element)
+{
+    Pair* pair = (Pair*)element;
+    pair->value = spin(pair->key);
+    return element;
+}
+
+static bool passesSpin(Element element, void* param)
+{
+    (void)param;
+    return spin(((Pair*)element)->key) % 2 == 0;
+}
+
+/**
+* Runs an operation, serially if pool is NULL, and returns its time in seconds.
+* The result is a checksum of the elements it produced, to compare the serial and parallel runs.
+*/
+static double runOperation(Operation operation, List list, Set set, ThreadPool pool, long long* result)
+{
+    double start = benchNow();
+    *result = 0;
+    if (operation == APPLY_LIST) {
+        ListResult status = (pool == NULL ? listApply(list, applySpin) : listApplyParallel(list, applySpin, pool));
+        double seconds = benchNow() - start;
+        for (Pair* pair = listGetFirst(list); status == LIST_SUCCESS && pair != NULL; pair = listGetNext(list)) {
+            *result += pair->value;
+            pair->value = 0;
+        }
+        return seconds;
+    }
+
+    int size;
+    double seconds;
+    if (operation == FILTER_LIST) {
+        List filtered = (pool == NULL ? listFilter(list, passesSpin, NULL) : listFilterParallel(list, passesSpin, NULL, pool));
+        seconds = benchNow() - start;
+        size = listGetSize(filtered);
+        listDestroy(filtered);
+    }
+    else {
+        Set filtered = (pool == NULL ? setFilter(set, passesSpin, NULL) : setFilterParallel(set, passesSpin, NULL, pool));
+        seconds = benchNow() - start;
+        size = setGetSize(filtered);
+        setDestroy(filtered);
+    }
+    *result = size;
+    return seconds;
+}
+
+/**
+* Doubles the number of threads, but always ends with max_threads itself.
+*/
+static int nextThreads(int threads, int max_threads)
+{
+    if (threads < max_threads && threads * 2 > max_threads) {
+        return max_threads;
+    }
+    return threads * 2;
+}
+
+int main(int argc, char** argv)
+{
+    int max_threads = (argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN));
+    int elements = (argc > 2 ? atoi(argv[2]) : DEFAULT_ELEMENTS);
+    work_per_element = (argc > 3 ? atoi(argv[3]) : DEFAULT_WORK);
+    if (max_threads < 1 || elements < 1 || work_per_element < 1) {
+        fprintf(stderr, "usage: %s [max threads] [elements] [work per element]\n", argv[0]);
+        return 1;
+    }
+
+    List list = listCreate(copyPair, freePair);
+    Set set = setCreateHashed(copyPair, freePair, equalPairs, hashPair);
+    if (list == NULL || set == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < elements; i++) {
+        Pair pair = { i, 0 };
+        if (listInsertLast(list, &pair) != LIST_SUCCESS || setAdd(set, &pair) != SET_SUCCESS) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    }
+
+    printf("%d elements, %d steps of work per element, time in ms (speedup over the serial function)\n",
+           elements, work_per_element);
+    printf("%-8s", "threads");
+    for (int operation = 0; operation < OPERATIONS_COUNT; operation++) {
+        printf(" %22s", operation_names[operation]);
+    }
+    printf("\n");
+
+    double serial[OPERATIONS_COUNT];
+    long long expected[OPERATIONS_COUNT];
+    printf("%-8s", "serial");
+    for (int operation = 0; operation < OPERATIONS_COUNT; operation++) {
+        serial[operation] = runOperation(operation, list, set, NULL, &expected[operation]);
+        printf(" %12.1f          ", serial[operation] * 1e3);
+    }
+    printf("\n");
+
+    for (int threads = 1; threads <= max_threads; threads = nextThreads(threads, max_threads)) {
+        ThreadPool pool = threadPoolCreate(threads);
+        if (pool == NULL) {
+            fprintf(stderr, "could not start %d threads\n", threads);
+            return 1;
+        }
+        bool same = true;
+        printf("%-8d", threads);
+        for (int operation = 0; operation < OPERATIONS_COUNT; operation++) {
+            long long result;
+            double seconds = runOperation(operation, list, set, pool, &result);
+            same = same && result == expected[operation];
+            printf(" %12.1f (%6.2fx)", seconds * 1e3, serial[operation] / seconds);
+        }
+        printf("%s\n", (same ? "" : "   (results differ!)"));
+        threadPoolDestroy(pool);
+    }
+
+    listDestroy(list);
+    setDestroy(set);
+    return 0;
+}
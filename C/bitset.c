@@ -0,0 +1,398 @@
+#include "bitset.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VECTOR_WORDS 4
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VECTOR_WORDS 2
+#else
+#define VECTOR_WORDS 1
+#endif
+
+/* The value v is bit v % 64 of word v / 64. The words are allocated in whole vectors,
+ * so the vector loops have no remainder, and the bits past the universe are always 0. */
+#define WORD_BITS 64
+#define WORD_COUNT(universe) (((size_t)(universe) + VECTOR_WORDS * WORD_BITS - 1) / (VECTOR_WORDS * WORD_BITS) * VECTOR_WORDS)
+
+typedef enum {
+    OPERATION_UNION,
+    OPERATION_INTERSECTION,
+    OPERATION_DIFFERENCE
+} Operation;
+
+static BitSet allocateBitSet(int universe);
+static BitSet combineInto(BitSet set1, BitSet set2, Operation operation);
+static int    combineWords(uint64_t* result, const uint64_t* words1, const uint64_t* words2,
+                           size_t count, Operation operation);
+static int    countWords(const uint64_t* words, size_t count);
+static int    lowestBit(uint64_t word);
+
+struct bitset_t {
+    uint64_t* words;
+    size_t word_count;
+    int universe;
+    int size; // kept exact by every change, so reading it never writes to the set
+};
+
+BitSet bitSetCreate(int universe)
+{
+    if (universe <= 0) {
+        return NULL;
+    }
+    BitSet set = allocateBitSet(universe);
+    if (set == NULL) {
+        return NULL;
+    }
+    memset(set->words, 0, set->word_count * sizeof(uint64_t));
+
+    return set;
+}
+
+BitSet bitSetCopy(BitSet set)
+{
+    if (set == NULL) {
+        return NULL;
+    }
+    BitSet new_set = allocateBitSet(set->universe);
+    if (new_set == NULL) {
+        return NULL;
+    }
+    memcpy(new_set->words, set->words, set->word_count * sizeof(uint64_t));
+    new_set->size = set->size;
+
+    return new_set;
+}
+
+void bitSetDestroy(BitSet set)
+{
+    if (set == NULL) {
+        return;
+    }
+    free(set->words);
+    free(set);
+}
+
+BitSetResult bitSetAdd(BitSet set, int value)
+{
+    if (set == NULL) {
+        return BITSET_NULL_ARG;
+    }
+    if (value < 0 || value >= set->universe) {
+        return BITSET_OUT_OF_RANGE;
+    }
+    uint64_t bit = (uint64_t)1 << (value % WORD_BITS);
+    uint64_t* word = &set->words[value / WORD_BITS];
+    if (*word & bit) {
+        return BITSET_ITEM_ALREADY_EXISTS;
+    }
+    *word |= bit;
+    set->size++;
+
+    return BITSET_SUCCESS;
+}
+
+BitSetResult bitSetRemove(BitSet set, int value)
+{
+    if (set == NULL) {
+        return BITSET_NULL_ARG;
+    }
+    if (value < 0 || value >= set->universe) {
+        return BITSET_OUT_OF_RANGE;
+    }
+    uint64_t bit = (uint64_t)1 << (value % WORD_BITS);
+    uint64_t* word = &set->words[value / WORD_BITS];
+    if (!(*word & bit)) {
+        return BITSET_ITEM_DOES_NOT_EXIST;
+    }
+    *word &= ~bit;
+    set->size--;
+
+    return BITSET_SUCCESS;
+}
+
+BitSetResult bitSetClear(BitSet set)
+{
+    if (set == NULL) {
+        return BITSET_NULL_ARG;
+    }
+    memset(set->words, 0, set->word_count * sizeof(uint64_t));
+    set->size = 0;
+
+    return BITSET_SUCCESS;
+}
+
+bool bitSetContains(BitSet set, int value)
+{
+    if (set == NULL || value < 0 || value >= set->universe) {
+        return false;
+    }
+    return (set->words[value / WORD_BITS] >> (value % WORD_BITS)) & 1;
+}
+
+int bitSetGetSize(BitSet set)
+{
+    if (set == NULL) {
+        return 0;
+    }
+    return set->size;
+}
+
+int bitSetGetUniverse(BitSet set)
+{
+    if (set == NULL) {
+        return 0;
+    }
+    return set->universe;
+}
+
+bool bitSetIsEmpty(BitSet set)
+{
+    return set && bitSetGetSize(set) == 0;
+}
+
+BitSet bitSetUnion(BitSet set1, BitSet set2)
+{
+    return combineInto(set1, set2, OPERATION_UNION);
+}
+
+BitSet bitSetIntersection(BitSet set1, BitSet set2)
+{
+    return combineInto(set1, set2, OPERATION_INTERSECTION);
+}
+
+BitSet bitSetDifference(BitSet set1, BitSet set2)
+{
+    return combineInto(set1, set2, OPERATION_DIFFERENCE);
+}
+
+BitSetResult bitSetUniteWith(BitSet set, BitSet other)
+{
+    if (set == NULL || other == NULL) {
+        return BITSET_NULL_ARG;
+    }
+    if (set->universe != other->universe) {
+        return BITSET_INCOMPATIBLE_SETS;
+    }
+    set->size = combineWords(set->words, set->words, other->words, set->word_count, OPERATION_UNION);
+    return BITSET_SUCCESS;
+}
+
+BitSetResult bitSetIntersectWith(BitSet set, BitSet other)
+{
+    if (set == NULL || other == NULL) {
+        return BITSET_NULL_ARG;
+    }
+    if (set->universe != other->universe) {
+        return BITSET_INCOMPATIBLE_SETS;
+    }
+    set->size = combineWords(set->words, set->words, other->words, set->word_count, OPERATION_INTERSECTION);
+    return BITSET_SUCCESS;
+}
+
+BitSetResult bitSetSubtract(BitSet set, BitSet other)
+{
+    if (set == NULL || other == NULL) {
+        return BITSET_NULL_ARG;
+    }
+    if (set->universe != other->universe) {
+        return BITSET_INCOMPATIBLE_SETS;
+    }
+    set->size = combineWords(set->words, set->words, other->words, set->word_count, OPERATION_DIFFERENCE);
+    return BITSET_SUCCESS;
+}
+
+BitSet bitSetFilter(BitSet set, BitConditionFunction condition, void* param)
+{
+    if (set == NULL || condition == NULL) {
+        return NULL;
+    }
+    BitSet new_set = bitSetCreate(set->universe);
+    if (new_set == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < set->word_count; i++) {
+        for (uint64_t word = set->words[i]; word != 0; word &= word - 1) {
+            int value = (int)(i * WORD_BITS) + lowestBit(word);
+            if (condition(value, param)) {
+                new_set->words[i] |= word & -word;
+                new_set->size++;
+            }
+        }
+    }
+
+    return new_set;
+}
+
+BitSetResult bitSetForEach(BitSet set, BitVisitFunction visit, void* context)
+{
+    if (set == NULL || visit == NULL) {
+        return BITSET_NULL_ARG;
+    }
+
+    for (size_t i = 0; i < set->word_count; i++) {
+        for (uint64_t word = set->words[i]; word != 0; word &= word - 1) {
+            if (!visit((int)(i * WORD_BITS) + lowestBit(word), context)) {
+                return BITSET_SUCCESS;
+            }
+        }
+    }
+
+    return BITSET_SUCCESS;
+}
+
+int bitSetNext(BitSet set, int value)
+{
+    if (set == NULL || value >= set->universe) {
+        return -1;
+    }
+    if (value < 0) {
+        value = 0;
+    }
+
+    size_t i = (size_t)value / WORD_BITS;
+    uint64_t word = set->words[i] & (~(uint64_t)0 << (value % WORD_BITS));
+    while (word == 0) {
+        if (++i == set->word_count) {
+            return -1;
+        }
+        word = set->words[i];
+    }
+
+    return (int)(i * WORD_BITS) + lowestBit(word);
+}
+
+/* Allocates a set with its words left uninitialized. */
+static BitSet allocateBitSet(int universe)
+{
+    BitSet set = (BitSet)malloc(sizeof(*set));
+    if (set == NULL) {
+        return NULL;
+    }
+    set->word_count = WORD_COUNT(universe);
+    set->words = (uint64_t*)malloc(set->word_count * sizeof(uint64_t));
+    if (set->words == NULL) {
+        free(set);
+        return NULL;
+    }
+    set->universe = universe;
+    set->size = 0;
+
+    return set;
+}
+
+static BitSet combineInto(BitSet set1, BitSet set2, Operation operation)
+{
+    if (set1 == NULL || set2 == NULL || set1->universe != set2->universe) {
+        return NULL;
+    }
+    BitSet set = allocateBitSet(set1->universe);
+    if (set == NULL) {
+        return NULL;
+    }
+    set->size = combineWords(set->words, set1->words, set2->words, set->word_count, operation);
+
+    return set;
+}
+
+/* Stores the words of the combined set in result, which may be one of the operands, and returns
+ * the number of values in it. The words are counted right after they are stored, while they are still in cache. */
+static int combineWords(uint64_t* result, const uint64_t* words1, const uint64_t* words2,
+                         size_t count, Operation operation)
+{
+#if defined(__AVX2__)
+    for (size_t i = 0; i < count; i += VECTOR_WORDS) {
+        __m256i vector1 = _mm256_loadu_si256((const __m256i*)(words1 + i));
+        __m256i vector2 = _mm256_loadu_si256((const __m256i*)(words2 + i));
+        __m256i vector = (operation == OPERATION_UNION ? _mm256_or_si256(vector1, vector2) :
+                          operation == OPERATION_INTERSECTION ? _mm256_and_si256(vector1, vector2) :
+                          _mm256_andnot_si256(vector2, vector1));
+        _mm256_storeu_si256((__m256i*)(result + i), vector);
+    }
+#elif defined(__SSE2__)
+    for (size_t i = 0; i < count; i += VECTOR_WORDS) {
+        __m128i vector1 = _mm_loadu_si128((const __m128i*)(words1 + i));
+        __m128i vector2 = _mm_loadu_si128((const __m128i*)(words2 + i));
+        __m128i vector = (operation == OPERATION_UNION ? _mm_or_si128(vector1, vector2) :
+                          operation == OPERATION_INTERSECTION ? _mm_and_si128(vector1, vector2) :
+                          _mm_andnot_si128(vector2, vector1));
+        _mm_storeu_si128((__m128i*)(result + i), vector);
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        result[i] = (operation == OPERATION_UNION ? words1[i] | words2[i] :
+                     operation == OPERATION_INTERSECTION ? words1[i] & words2[i] :
+                     words1[i] & ~words2[i]);
+    }
+#endif
+    return countWords(result, count);
+}
+
+/* Returns the number of bits set in the words. Every byte is counted on its own,
+ * and the counts of the bytes are summed with a sum of absolute differences from 0. */
+static int countWords(const uint64_t* words, size_t count)
+{
+#if defined(__AVX2__)
+    // the counts of the two halves of each byte are looked up in a table of the counts of 0..15
+    const __m256i counts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_half = _mm256_set1_epi8(0x0F);
+    __m256i total = _mm256_setzero_si256();
+    for (size_t i = 0; i < count; i += VECTOR_WORDS) {
+        __m256i vector = _mm256_loadu_si256((const __m256i*)(words + i));
+        __m256i bytes = _mm256_add_epi8(
+            _mm256_shuffle_epi8(counts, _mm256_and_si256(vector, low_half)),
+            _mm256_shuffle_epi8(counts, _mm256_and_si256(_mm256_srli_epi16(vector, 4), low_half)));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, total);
+    return (int)(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+#elif defined(__SSE2__)
+    // SSE2 has no byte shuffle, so the bits are added in pairs, then in nibbles, then in bytes
+    const __m128i pairs = _mm_set1_epi8(0x55);
+    const __m128i nibbles = _mm_set1_epi8(0x33);
+    const __m128i bytes = _mm_set1_epi8(0x0F);
+    __m128i total = _mm_setzero_si128();
+    for (size_t i = 0; i < count; i += VECTOR_WORDS) {
+        __m128i vector = _mm_loadu_si128((const __m128i*)(words + i));
+        vector = _mm_sub_epi8(vector, _mm_and_si128(_mm_srli_epi64(vector, 1), pairs));
+        vector = _mm_add_epi8(_mm_and_si128(vector, nibbles), _mm_and_si128(_mm_srli_epi64(vector, 2), nibbles));
+        vector = _mm_and_si128(_mm_add_epi8(vector, _mm_srli_epi64(vector, 4)), bytes);
+        total = _mm_add_epi64(total, _mm_sad_epu8(vector, _mm_setzero_si128()));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, total);
+    return (int)(lanes[0] + lanes[1]);
+#else
+    int total = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t word = words[i];
+        word = word - ((word >> 1) & 0x5555555555555555ULL);
+        word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+        word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        total += (int)((word * 0x0101010101010101ULL) >> 56); // the sum of the bytes ends up in the top byte
+    }
+    return total;
+#endif
+}
+
+/* The index of the lowest set bit of a word which is not 0. */
+static int lowestBit(uint64_t word)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(word);
+#else
+    int index = 0;
+    for (; !(word & 1); word >>= 1) {
+        index++;
+    }
+    return index;
+#endif
+}
@@ -0,0 +1,52 @@
+#ifndef BITSET_H_
+#define BITSET_H_
+
+#include <stdbool.h>
+
+/* A set of the integers in [0, universe), kept as one bit per value in an array of words.
+ * Union, intersection and difference combine whole words at a time (with AVX2 or SSE2 when
+ * the compiler targets them, e.g. with -mavx2), so two sets of 65536 values are combined
+ * in a few hundred cycles. Membership is a single load. */
+
+typedef bool (*BitConditionFunction)(int value, void* param);
+typedef bool (*BitVisitFunction)(int value, void* context); // return false to stop the visit
+
+typedef struct bitset_t* BitSet;
+
+typedef enum {
+    BITSET_SUCCESS,
+    BITSET_OUT_OF_MEMORY,
+    BITSET_NULL_ARG,
+    BITSET_OUT_OF_RANGE,
+    BITSET_ITEM_ALREADY_EXISTS,
+    BITSET_ITEM_DOES_NOT_EXIST,
+    BITSET_INCOMPATIBLE_SETS
+} BitSetResult;
+
+BitSet bitSetCreate(int universe); // the values must be in [0, universe)
+BitSet bitSetCopy(BitSet set);
+void bitSetDestroy(BitSet set);
+BitSetResult bitSetAdd(BitSet set, int value);
+BitSetResult bitSetRemove(BitSet set, int value);
+BitSetResult bitSetClear(BitSet set);
+bool bitSetContains(BitSet set, int value);
+int bitSetGetSize(BitSet set);
+int bitSetGetUniverse(BitSet set);
+bool bitSetIsEmpty(BitSet set);
+BitSet bitSetUnion(BitSet set1, BitSet set2); // the sets must have the same universe
+BitSet bitSetIntersection(BitSet set1, BitSet set2);
+BitSet bitSetDifference(BitSet set1, BitSet set2); // the values of set1 which are not in set2
+BitSetResult bitSetUniteWith(BitSet set, BitSet other);
+BitSetResult bitSetIntersectWith(BitSet set, BitSet other);
+BitSetResult bitSetSubtract(BitSet set, BitSet other);
+BitSet bitSetFilter(BitSet set, BitConditionFunction condition, void* param);
+BitSetResult bitSetForEach(BitSet set, BitVisitFunction visit, void* context); // in ascending order
+int bitSetNext(BitSet set, int value); // the smallest value in the set which is >= value, or -1
+
+// Macro to enable simple iteration, in ascending order
+#define BITSET_FOREACH(value, set) \
+    for (int value = bitSetNext(set, 0); \
+        value >= 0; \
+        value = bitSetNext(set, value + 1))
+
+#endif /* BITSET_H_ */
@@ -0,0 +1,213 @@
+#include "bloom_filter.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define NULL_FILTER_COUNT -1
+
+/**
+* The bits are split into blocks of one cache line. The high bits of an element's hash pick
+* its block, and its low bits pick hash_count bits inside the block (by double hashing).
+* The step between the bits is taken from the middle bits, and not from the high ones: in a large
+* filter every high bit picks the block, and elements of the same block would then all step alike.
+* A filter of single blocks needs a little more bits per element than a plain Bloom filter
+* for the same rate, so it gets 1.5 * hash_count bits per element instead of 1.44 * hash_count.
+*/
+#define BLOCK_BYTES 64
+#define BLOCK_BITS (BLOCK_BYTES * 8)
+#define BLOCK_WORDS (BLOCK_BYTES / sizeof(uint64_t))
+#define MAX_HASH_COUNT 16
+
+typedef struct block_t {
+    uint64_t words[BLOCK_WORDS];
+} Block;
+
+static bool allocateBlocks(BloomFilter filter, int capacity);
+static Block* findBlock(BloomFilter filter, size_t hash, uint32_t* bit, uint32_t* step);
+static uint64_t mixHash(size_t hash);
+
+struct bloom_filter_t {
+    Block* blocks; // aligned to a cache line, inside allocation
+    void* allocation;
+    size_t block_count;
+    int hash_count;
+    int capacity;
+    int count;
+    double false_positive_rate;
+    // the statistics are counted by lookups, which may run at once, so they are relaxed atomics:
+    // every count is exact, but the three of them are not read together at one instant
+    atomic_ullong negatives;
+    atomic_ullong hits;
+    atomic_ullong false_positives;
+};
+
+BloomFilter bloomFilterCreate(int capacity, double falsePositiveRate)
+{
+    if (capacity <= 0 || !(falsePositiveRate > 0 && falsePositiveRate < 1)) {
+        return NULL;
+    }
+    BloomFilter filter = (BloomFilter)malloc(sizeof(*filter));
+    if (filter == NULL) {
+        return NULL;
+    }
+    filter->hash_count = 0; // the number of halvings from 1 down to the rate, so rate ~ 2^-hash_count
+    for (double rate = 1; rate > falsePositiveRate && filter->hash_count < MAX_HASH_COUNT; rate /= 2) {
+        filter->hash_count++;
+    }
+    filter->false_positive_rate = falsePositiveRate;
+    atomic_init(&filter->negatives, 0);
+    atomic_init(&filter->hits, 0);
+    atomic_init(&filter->false_positives, 0);
+    if (!allocateBlocks(filter, capacity)) {
+        free(filter);
+        return NULL;
+    }
+
+    return filter;
+}
+
+void bloomFilterDestroy(BloomFilter filter)
+{
+    if (filter == NULL) {
+        return;
+    }
+    free(filter->allocation);
+    free(filter);
+}
+
+bool bloomFilterReset(BloomFilter filter, int capacity)
+{
+    if (filter == NULL || capacity <= 0) {
+        return false;
+    }
+    void* allocation = filter->allocation;
+    if (!allocateBlocks(filter, capacity)) {
+        return false;
+    }
+    free(allocation);
+    return true;
+}
+
+void bloomFilterAdd(BloomFilter filter, size_t hash)
+{
+    if (filter == NULL) {
+        return;
+    }
+    uint32_t bit, step;
+    Block* block = findBlock(filter, hash, &bit, &step);
+    for (int i = 0; i < filter->hash_count; i++, bit += step) {
+        block->words[(bit % BLOCK_BITS) / 64] |= (uint64_t)1 << (bit % 64);
+    }
+    filter->count++;
+}
+
+bool bloomFilterMayContain(BloomFilter filter, size_t hash)
+{
+    if (filter == NULL) {
+        return true;
+    }
+    uint32_t bit, step;
+    const Block* block = findBlock(filter, hash, &bit, &step);
+    for (int i = 0; i < filter->hash_count; i++, bit += step) {
+        if (!(block->words[(bit % BLOCK_BITS) / 64] & ((uint64_t)1 << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void bloomFilterCountLookup(BloomFilter filter, bool mayContain, bool found)
+{
+    if (filter == NULL) {
+        return;
+    }
+    atomic_ullong* counter = (!mayContain ? &filter->negatives : found ? &filter->hits : &filter->false_positives);
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
+
+int bloomFilterGetCount(BloomFilter filter)
+{
+    if (filter == NULL) {
+        return NULL_FILTER_COUNT;
+    }
+    return filter->count;
+}
+
+int bloomFilterGetCapacity(BloomFilter filter)
+{
+    if (filter == NULL) {
+        return NULL_FILTER_COUNT;
+    }
+    return filter->capacity;
+}
+
+double bloomFilterGetFalsePositiveRate(BloomFilter filter)
+{
+    if (filter == NULL) {
+        return 0;
+    }
+    return filter->false_positive_rate;
+}
+
+BloomFilterStatistics bloomFilterGetStatistics(BloomFilter filter)
+{
+    BloomFilterStatistics statistics;
+    memset(&statistics, 0, sizeof(statistics));
+    if (filter != NULL) {
+        statistics.negatives = atomic_load_explicit(&filter->negatives, memory_order_relaxed);
+        statistics.hits = atomic_load_explicit(&filter->hits, memory_order_relaxed);
+        statistics.false_positives = atomic_load_explicit(&filter->false_positives, memory_order_relaxed);
+    }
+    return statistics;
+}
+
+/**
+* Allocates empty blocks for the capacity, and replaces the filter's blocks with them
+* (without freeing the old ones). Returns false if the allocation failed, and then
+* the filter is left untouched.
+*/
+static bool allocateBlocks(BloomFilter filter, int capacity)
+{
+    size_t bits = (size_t)capacity * (size_t)filter->hash_count * 3 / 2;
+    size_t block_count = (bits + BLOCK_BITS - 1) / BLOCK_BITS;
+    void* allocation = calloc(block_count * BLOCK_BYTES + BLOCK_BYTES - 1, 1);
+    if (allocation == NULL) {
+        return false;
+    }
+    uintptr_t address = ((uintptr_t)allocation + BLOCK_BYTES - 1) / BLOCK_BYTES * BLOCK_BYTES;
+    filter->blocks = (Block*)address;
+    filter->allocation = allocation;
+    filter->block_count = block_count;
+    filter->capacity = capacity;
+    filter->count = 0;
+    return true;
+}
+
+/**
+* Returns the block of a hash, and sets the first of its bits in the block and the step to the next one.
+*/
+static Block* findBlock(BloomFilter filter, size_t hash, uint32_t* bit, uint32_t* step)
+{
+    uint64_t mixed = mixHash(hash);
+    *bit = (uint32_t)mixed;
+    *step = (uint32_t)((mixed >> 16) ^ (mixed << 7)) | 1;
+    return &filter->blocks[(size_t)(((mixed >> 32) * filter->block_count) >> 32)];
+}
+
+/**
+* The finalizer of MurmurHash3, so that hashes which differ only in a few bits
+* (such as the identity hash of small integers) spread over all of the blocks and bits.
+*/
+static uint64_t mixHash(size_t hash)
+{
+    uint64_t mixed = (uint64_t)hash;
+    mixed ^= mixed >> 33;
+    mixed *= 0xFF51AFD7ED558CCDULL;
+    mixed ^= mixed >> 33;
+    mixed *= 0xC4CEB9FE1A85EC53ULL;
+    mixed ^= mixed >> 33;
+    return mixed;
+}
@@ -0,0 +1,150 @@
+#ifndef BLOOM_FILTER_H_
+#define BLOOM_FILTER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+* A Blocked Bloom Filter (ADT)
+*
+* The filter is given the hash of every element of a set, and answers whether an element
+* may be in the set: a "no" is always right, while a "yes" is wrong at about the false positive
+* rate the filter was created with, as long as it was not given more hashes than its capacity.
+* All of the bits of an element are in one 64-byte block, so a lookup reads a single cache line.
+*
+* A Set or a Map can keep a filter (see setCreateFiltered and mapEnableFilter), and then
+* a lookup of an element which is not in it is usually answered by the filter alone.
+* They count the results of their lookups in the filter's statistics, to help size it.
+*
+* The ADT provides the following methods:
+*   bloomFilterCreate
+*   bloomFilterDestroy
+*   bloomFilterReset
+*   bloomFilterAdd
+*   bloomFilterMayContain
+*   bloomFilterCountLookup
+*   bloomFilterGetCount
+*   bloomFilterGetCapacity
+*   bloomFilterGetFalsePositiveRate
+*   bloomFilterGetStatistics
+*
+*   NOTE: elements cannot be removed from a filter, so it is rebuilt with bloomFilterReset
+*         once it was given more hashes than its capacity.
+*/
+
+// ============================ TYPEDEFS ============================ //
+typedef struct bloom_filter_t * BloomFilter;
+
+/**
+* The results of the lookups which were counted by bloomFilterCountLookup.
+*/
+typedef struct bloom_filter_statistics_t {
+    unsigned long long negatives;       // the filter ruled the element out
+    unsigned long long hits;            // the filter passed the element, and it was found
+    unsigned long long false_positives; // the filter passed the element, but it was not found
+} BloomFilterStatistics;
+
+
+// ============================ FUNCTIONS ============================ //
+/**
+* bloomFilterCreate: Allocates and returns a new empty filter.
+*
+* @param capacity - The number of hashes the filter is sized for.
+* @param falsePositiveRate - The rate of wrong "yes" answers at full capacity, between 0 and 1.
+* @return
+* 	NULL - if the capacity is not positive, the rate is not between 0 and 1, or if allocations failed.
+* 	A new BloomFilter in case of success.
+*/
+BloomFilter bloomFilterCreate(int capacity, double falsePositiveRate);
+
+/**
+* bloomFilterDestroy: Deallocates a filter.
+*
+* @param filter - Filter to be deallocated. If filter is NULL nothing will be done.
+*/
+void bloomFilterDestroy(BloomFilter filter);
+
+/**
+* bloomFilterReset: Removes all of the hashes from a filter, and resizes it for a new capacity
+* (with the same false positive rate). The statistics are kept.
+*
+* @param filter - The filter to reset.
+* @param capacity - The number of hashes the filter is sized for from now on.
+* @return
+* 	false if a NULL was sent, the capacity is not positive or the allocation failed,
+* 	and then the filter is left untouched.
+* 	true otherwise.
+*/
+bool bloomFilterReset(BloomFilter filter, int capacity);
+
+/**
+* bloomFilterAdd: Adds the hash of an element to a filter.
+* The hash is mixed before it is used, so it does not have to be uniform.
+*
+* @param filter - The filter to add to. If filter is NULL nothing will be done.
+* @param hash - The hash of the element.
+*/
+void bloomFilterAdd(BloomFilter filter, size_t hash);
+
+/**
+* bloomFilterMayContain: Checks if an element may have been added to a filter.
+*
+* @param filter - The filter to check.
+* @param hash - The hash of the element.
+* @return
+* 	false - if the element was surely not added to the filter.
+* 	true - if the element may have been added to the filter, or if filter is NULL.
+*/
+bool bloomFilterMayContain(BloomFilter filter, size_t hash);
+
+/**
+* bloomFilterCountLookup: Counts the result of a lookup in the filter's statistics.
+* Lookups may be counted from many threads at once, along with bloomFilterMayContain.
+*
+* @param filter - The filter whose statistics are updated. If filter is NULL nothing will be done.
+* @param mayContain - What bloomFilterMayContain answered for the element.
+* @param found - Whether the element was found (only counted if mayContain is true).
+*/
+void bloomFilterCountLookup(BloomFilter filter, bool mayContain, bool found);
+
+/**
+* bloomFilterGetCount: Returns the number of hashes added to a filter since it was created or reset.
+*
+* @param filter - The filter which count is requested.
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of added hashes (including repeated ones).
+*/
+int bloomFilterGetCount(BloomFilter filter);
+
+/**
+* bloomFilterGetCapacity: Returns the number of hashes a filter is sized for.
+*
+* @param filter - The filter which capacity is requested.
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the capacity of the filter.
+*/
+int bloomFilterGetCapacity(BloomFilter filter);
+
+/**
+* bloomFilterGetFalsePositiveRate: Returns the false positive rate a filter was created with.
+*
+* @param filter - The filter which rate is requested.
+* @return
+* 	0 if a NULL pointer was sent.
+* 	Otherwise the target false positive rate of the filter.
+*/
+double bloomFilterGetFalsePositiveRate(BloomFilter filter);
+
+/**
+* bloomFilterGetStatistics: Returns the counted results of the lookups in a filter.
+*
+* @param filter - The filter which statistics are requested.
+* @return
+* 	All zeros if a NULL pointer was sent.
+* 	Otherwise the statistics of the filter.
+*/
+BloomFilterStatistics bloomFilterGetStatistics(BloomFilter filter);
+
+#endif
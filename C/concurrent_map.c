@@ -0,0 +1,339 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "concurrent_map.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define DEFAULT_SHARDS 64
+#define MAX_SHARDS (1 << 16)
+#define CACHE_LINE_SIZE 64
+
+/**
+* Readers do not share a lock word, which every one of them would have to write, so that its
+* cache line would move between the cores on every lookup. Instead, every reader thread gets
+* one of READER_SLOTS rows of counters, one counter per shard, and a reader of a shard only
+* increments its own counter. A writer of a shard raises the shard's writing flag and then
+* waits until the counters of the shard in all of the rows are zero, while a reader which
+* finds the flag raised steps back and reads under the shard's mutex instead.
+* Threads which share a row are still correct, they only share its cache lines.
+*/
+#define READER_SLOTS 64
+
+typedef struct shard_t {
+    pthread_mutex_t lock; // held by the writers of the shard and by readers which met a writer
+    atomic_bool writing;
+    Map map;
+    char padding[CACHE_LINE_SIZE]; // keeps the locks of neighbouring shards on different cache lines
+} Shard;
+
+typedef enum read_mode_t {
+    READ_COUNTED, // announced in the thread's row of counters
+    READ_LOCKED,  // a writer was active, so the shard's mutex is held
+    READ_NESTED   // called from a visit of the same shard, which already keeps the writers out
+} ReadMode;
+
+typedef struct visit_context_t {
+    visitMapElements visit;
+    void* context;
+    bool stopped;
+} VisitContext;
+
+static Shard* findShard(ConcurrentMap map, MapKeyElement keyElement);
+static atomic_int* readerCounter(ConcurrentMap map, Shard* shard);
+static ReadMode readLock(Shard* shard, atomic_int* counter);
+static void readUnlock(Shard* shard, atomic_int* counter, ReadMode mode);
+static void writeLock(ConcurrentMap map, Shard* shard);
+static void writeUnlock(Shard* shard);
+static bool visitShardElements(MapKeyElement keyElement, MapDataElement dataElement, void* context);
+
+static atomic_int next_reader_slot = 0;
+static _Thread_local int reader_slot = -1;
+static _Thread_local Shard* visited_shard = NULL; // the shard which concurrentMapForEach is visiting
+
+struct concurrent_map_t {
+    Shard* shards;
+    atomic_int* readers; // READER_SLOTS rows of row_size counters, each row on its own cache lines
+    int row_size;
+    int shards_count;
+    int shift;  // how many bits of the mixed hash are dropped to get a shard index
+    copyMapDataElements copyDataElement;
+    hashMapKeyElements hashKeyElement;
+};
+
+ConcurrentMap concurrentMapCreate(int shards,
+                                  copyMapDataElements copyDataElement,
+                                  copyMapKeyElements copyKeyElement,
+                                  freeMapDataElements freeDataElement,
+                                  freeMapKeyElements freeKeyElement,
+                                  compareMapKeyElements compareKeyElements,
+                                  hashMapKeyElements hashKeyElement)
+{
+    if(copyDataElement == NULL || copyKeyElement == NULL || freeDataElement == NULL ||
+       freeKeyElement == NULL || compareKeyElements == NULL || hashKeyElement == NULL) {
+        return NULL;
+    }
+    if (shards <= 0) {
+        shards = DEFAULT_SHARDS;
+    }
+    if (shards > MAX_SHARDS) {
+        shards = MAX_SHARDS;
+    }
+
+    ConcurrentMap map = (ConcurrentMap)malloc(sizeof(*map));
+    if (map == NULL) {
+        return NULL;
+    }
+    map->shards_count = 1;
+    map->shift = 64;
+    while (map->shards_count < shards) {
+        map->shards_count *= 2;
+        map->shift--;
+    }
+    map->copyDataElement = copyDataElement;
+    map->hashKeyElement = hashKeyElement;
+
+    int counters_per_line = CACHE_LINE_SIZE / sizeof(atomic_int);
+    map->row_size = (map->shards_count + counters_per_line - 1) / counters_per_line * counters_per_line;
+    map->shards = (Shard*)malloc(sizeof(Shard) * map->shards_count);
+    map->readers = (atomic_int*)aligned_alloc(CACHE_LINE_SIZE, sizeof(atomic_int) * map->row_size * READER_SLOTS);
+    if (map->shards == NULL || map->readers == NULL) {
+        free(map->shards);
+        free(map->readers);
+        free(map);
+        return NULL;
+    }
+    for (int i = 0; i < map->row_size * READER_SLOTS; i++) {
+        atomic_init(&map->readers[i], 0);
+    }
+    for (int i = 0; i < map->shards_count; i++) {
+        Shard* shard = &map->shards[i];
+        atomic_init(&shard->writing, false);
+        shard->map = mapCreate(copyDataElement, copyKeyElement, freeDataElement, freeKeyElement, compareKeyElements);
+        if (shard->map == NULL || pthread_mutex_init(&shard->lock, NULL) != 0) {
+            mapDestroy(shard->map);
+            map->shards_count = i; // destroy only the shards which were initialized
+            concurrentMapDestroy(map);
+            return NULL;
+        }
+    }
+
+    return map;
+}
+
+void concurrentMapDestroy(ConcurrentMap map)
+{
+    if (map == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < map->shards_count; i++) {
+        pthread_mutex_destroy(&map->shards[i].lock);
+        mapDestroy(map->shards[i].map);
+    }
+    free(map->shards);
+    free(map->readers);
+    free(map);
+}
+
+int concurrentMapGetSize(ConcurrentMap map)
+{
+    if (map == NULL) {
+        return -1;
+    }
+
+    int size = 0;
+    for (int i = 0; i < map->shards_count; i++) {
+        Shard* shard = &map->shards[i];
+        atomic_int* counter = readerCounter(map, shard);
+        ReadMode mode = readLock(shard, counter);
+        size += mapGetSize(shard->map);
+        readUnlock(shard, counter, mode);
+    }
+
+    return size;
+}
+
+bool concurrentMapContains(ConcurrentMap map, MapKeyElement element)
+{
+    if (map == NULL || element == NULL) {
+        return false;
+    }
+
+    Shard* shard = findShard(map, element);
+    atomic_int* counter = readerCounter(map, shard);
+    ReadMode mode = readLock(shard, counter);
+    bool contains = mapContains(shard->map, element);
+    readUnlock(shard, counter, mode);
+
+    return contains;
+}
+
+MapResult concurrentMapPut(ConcurrentMap map, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    if (map == NULL || keyElement == NULL || dataElement == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    Shard* shard = findShard(map, keyElement);
+    writeLock(map, shard);
+    MapResult result = mapPut(shard->map, keyElement, dataElement);
+    writeUnlock(shard);
+
+    return result;
+}
+
+MapResult concurrentMapGet(ConcurrentMap map, MapKeyElement keyElement, MapDataElement* dataElement)
+{
+    if (map == NULL || keyElement == NULL || dataElement == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    MapResult result = MAP_SUCCESS;
+    Shard* shard = findShard(map, keyElement);
+    atomic_int* counter = readerCounter(map, shard);
+    ReadMode mode = readLock(shard, counter);
+    MapDataElement data = mapGet(shard->map, keyElement);
+    if (data == NULL) {
+        result = MAP_ITEM_DOES_NOT_EXIST;
+    }
+    else {
+        // the copy must be made under the lock, before a writer can free the element
+        *dataElement = map->copyDataElement(data);
+        if (*dataElement == NULL) {
+            result = MAP_OUT_OF_MEMORY;
+        }
+    }
+    readUnlock(shard, counter, mode);
+
+    return result;
+}
+
+MapResult concurrentMapRemove(ConcurrentMap map, MapKeyElement keyElement)
+{
+    if (map == NULL || keyElement == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    Shard* shard = findShard(map, keyElement);
+    writeLock(map, shard);
+    MapResult result = mapRemove(shard->map, keyElement);
+    writeUnlock(shard);
+
+    return result;
+}
+
+MapResult concurrentMapClear(ConcurrentMap map)
+{
+    if (map == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    for (int i = 0; i < map->shards_count; i++) {
+        Shard* shard = &map->shards[i];
+        writeLock(map, shard);
+        mapClear(shard->map);
+        writeUnlock(shard);
+    }
+
+    return MAP_SUCCESS;
+}
+
+MapResult concurrentMapForEach(ConcurrentMap map, visitMapElements visit, void* context)
+{
+    if (map == NULL || visit == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    VisitContext visit_context = { visit, context, false };
+    for (int i = 0; i < map->shards_count && !visit_context.stopped; i++) {
+        Shard* shard = &map->shards[i];
+        atomic_int* counter = readerCounter(map, shard);
+        ReadMode mode = readLock(shard, counter);
+        Shard* outer = visited_shard;
+        visited_shard = shard;
+        mapForEach(shard->map, visitShardElements, &visit_context);
+        visited_shard = outer;
+        readUnlock(shard, counter, mode);
+    }
+
+    return MAP_SUCCESS;
+}
+
+static Shard* findShard(ConcurrentMap map, MapKeyElement keyElement)
+{
+    if (map->shards_count == 1) {
+        return &map->shards[0];
+    }
+    // Fibonacci hashing spreads the high bits over every shard, even if the user's hash is weak
+    unsigned long long hash = (unsigned long long)map->hashKeyElement(keyElement) * 0x9E3779B97F4A7C15ULL;
+    return &map->shards[hash >> map->shift];
+}
+
+static atomic_int* readerCounter(ConcurrentMap map, Shard* shard)
+{
+    if (reader_slot < 0) {
+        reader_slot = atomic_fetch_add_explicit(&next_reader_slot, 1, memory_order_relaxed) % READER_SLOTS;
+    }
+    return &map->readers[reader_slot * map->row_size + (shard - map->shards)];
+}
+
+/**
+* Announces a reader of the shard, or takes the shard's mutex if a writer is active.
+* The announcement and the writer's flag are both sequentially consistent, so either the reader
+* sees the flag, or the writer sees the announcement and waits for it.
+* A read from inside a visit of the same shard does neither: the visit already keeps the writers
+* out, and waiting for one of them would never end, because the writer waits for the visit.
+*/
+static ReadMode readLock(Shard* shard, atomic_int* counter)
+{
+    if (shard == visited_shard) {
+        return READ_NESTED;
+    }
+    atomic_fetch_add(counter, 1);
+    if (!atomic_load(&shard->writing)) {
+        return READ_COUNTED;
+    }
+    atomic_fetch_sub_explicit(counter, 1, memory_order_release);
+    pthread_mutex_lock(&shard->lock);
+    return READ_LOCKED;
+}
+
+static void readUnlock(Shard* shard, atomic_int* counter, ReadMode mode)
+{
+    if (mode == READ_COUNTED) {
+        atomic_fetch_sub_explicit(counter, 1, memory_order_release);
+    }
+    else if (mode == READ_LOCKED) {
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+static void writeLock(ConcurrentMap map, Shard* shard)
+{
+    pthread_mutex_lock(&shard->lock);
+    atomic_store(&shard->writing, true);
+    int index = (int)(shard - map->shards);
+    for (int slot = 0; slot < READER_SLOTS; slot++) {
+        while (atomic_load_explicit(&map->readers[slot * map->row_size + index], memory_order_acquire) != 0) {
+            sched_yield();
+        }
+    }
+}
+
+static void writeUnlock(Shard* shard)
+{
+    atomic_store_explicit(&shard->writing, false, memory_order_release);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+static bool visitShardElements(MapKeyElement keyElement, MapDataElement dataElement, void* context)
+{
+    VisitContext* visit_context = (VisitContext*)context;
+    if (!visit_context->visit(keyElement, dataElement, visit_context->context)) {
+        visit_context->stopped = true;
+    }
+    return !visit_context->stopped;
+}
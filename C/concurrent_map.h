@@ -0,0 +1,169 @@
+#ifndef CONCURRENT_MAP_H_
+#define CONCURRENT_MAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ordered_map.h"
+
+/**
+* A Generic Thread-Safe Map Container (ADT)
+*
+* The map is split into shards, and every key belongs to the shard chosen by a hash function
+* given by the user. Each shard is an ordered Map with its own writer lock, so writers only block
+* the threads which use the same shard. Readers do not take a shared lock: every reader thread
+* announces itself in a counter of its own, so any number of threads may look keys up at once
+* without writing to a common cache line.
+*
+* The ADT provides the following methods:
+*   concurrentMapCreate
+*   concurrentMapDestroy
+*   concurrentMapGetSize
+*   concurrentMapContains
+*   concurrentMapPut
+*   concurrentMapGet     - NOTE: returns a copy of the data element.
+*   concurrentMapRemove
+*   concurrentMapClear
+*   concurrentMapForEach
+*
+*   NOTE: unlike Map, there is no internal iterator, and no element of the map is ever
+*         returned to the caller, because another thread could free it at any moment.
+*
+*   NOTE: keys are ordered only within their shard, so concurrentMapForEach does not
+*         visit the pairs in order.
+*
+*   NOTE: the functions must not be called on a map while it is being destroyed.
+*/
+
+// ============================ TYPEDEFS ============================ //
+typedef struct concurrent_map_t * ConcurrentMap;
+
+
+// ============================ FUNCTIONS ============================ //
+/**
+* concurrentMapCreate: Allocates and returns a new empty concurrent map.
+*
+* @param shards             - The number of shards, which is rounded up to a power of 2.
+*                             If it is not positive, a default number is used.
+*                             Use more shards than the number of threads that are expected to write.
+* @param copyDataElement    - A Function pointer for copying data elements.
+* @param copyKeyElement     - A Function pointer for copying key elements.
+* @param freeDataElement    - A Function pointer for removing data elements.
+* @param freeKeyElement     - A Function pointer for removing key elements.
+* @param compareKeyElements - A Function pointer for comparing key elements.
+* @param hashKeyElement     - A Function pointer for hashing key elements.
+* @return
+* 	NULL - if one of the parameters is NULL or if allocations failed.
+* 	A new ConcurrentMap in case of success.
+*/
+ConcurrentMap concurrentMapCreate(int shards,
+                                  copyMapDataElements   copyDataElement,
+                                  copyMapKeyElements    copyKeyElement,
+                                  freeMapDataElements   freeDataElement,
+                                  freeMapKeyElements    freeKeyElement,
+                                  compareMapKeyElements compareKeyElements,
+                                  hashMapKeyElements    hashKeyElement);
+
+/**
+* concurrentMapDestroy: Deallocates an existing map and all of it's elements by using the stored free functions.
+* No other thread may use the map during or after this operation.
+*
+* @param map - Map to be deallocated. If map is NULL nothing will be done.
+*/
+void concurrentMapDestroy(ConcurrentMap map);
+
+/**
+* concurrentMapGetSize: Returns the number of elements in a map.
+* While other threads modify the map, the result is only an estimate.
+*
+* @param map - The map which size is requested.
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of elements in the map.
+*/
+int concurrentMapGetSize(ConcurrentMap map);
+
+/**
+* concurrentMapContains: Checks if a key element exists in the map.
+*
+* @param map - The map to search in.
+* @param element - The element to look for. Will be compared using the comparison function.
+* @return
+* 	false - if one or more of the inputs is null, or if the key element was not found.
+* 	true - if the key element was found in the map.
+*/
+bool concurrentMapContains(ConcurrentMap map, MapKeyElement element);
+
+/**
+* concurrentMapPut: Gives a specified key a specific value.
+* If the key exists, the value will be overridden.
+* Copies of the key and data elements are stored in the map.
+*
+* @param map - The map for which to reassign the data element.
+* @param keyElement - The key element which need to be reassigned.
+* @param dataElement - The new data element to associate with the given key.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as one of the parameters.
+* 	MAP_OUT_OF_MEMORY if an allocation failed (Meaning the function for copying an element failed).
+* 	MAP_SUCCESS if the paired elements had been inserted successfully.
+*/
+MapResult concurrentMapPut(ConcurrentMap map, MapKeyElement keyElement, MapDataElement dataElement);
+
+/**
+* concurrentMapGet: Returns a COPY of the data element associated with a specific key in the map.
+* The copy belongs to the caller, who should free it.
+*
+* @param map - The map for which to get the data element from.
+* @param keyElement - The key element which need to be found and whos data we want to get.
+* @param dataElement - Set to a copy of the data element, on success.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as one of the parameters.
+*   MAP_ITEM_DOES_NOT_EXIST if the key element does not exist in the map.
+* 	MAP_OUT_OF_MEMORY if copying the data element failed.
+* 	MAP_SUCCESS if the data element had been copied successfully.
+*/
+MapResult concurrentMapGet(ConcurrentMap map, MapKeyElement keyElement, MapDataElement* dataElement);
+
+/**
+* concurrentMapRemove: Removes a pair of key and data elements from the map.
+* The elements are removed and deallocated using the free functions.
+*
+* @param map - The map to remove the elements from.
+* @param keyElement - The key element to find and remove from the map.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent to the function.
+*   MAP_ITEM_DOES_NOT_EXIST if an equal key item does not already exists in the map.
+* 	MAP_SUCCESS if the paired elements had been removed successfully.
+*/
+MapResult concurrentMapRemove(ConcurrentMap map, MapKeyElement keyElement);
+
+/**
+* concurrentMapClear: Removes all key and data elements from target map.
+* The elements are deallocated using the stored free functions.
+* The shards are cleared one after the other, not all at once.
+*
+* @param map - Target map to remove all element from.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult concurrentMapClear(ConcurrentMap map);
+
+/**
+* concurrentMapForEach: Calls a function on every pair in the map until it returns false.
+* The shards are visited one after the other, each of them in order and under its read lock,
+* so the function sees a consistent view of every shard, but not of the whole map.
+* The elements are passed as they are in the map (and not copies), must not be modified in a way
+* which changes their order, and must not be kept after the function returns.
+* The function must not call the methods which modify this map.
+*
+* @param map - The map to iterate over.
+* @param visit - The function to call on each pair.
+* @param context - A parameter passed as is to every call of visit.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or visit.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult concurrentMapForEach(ConcurrentMap map, visitMapElements visit, void* context);
+
+#endif
@@ -0,0 +1,486 @@
+#include "frozen_map.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define NULL_MAP_SIZE -1
+
+/**
+* The keys are kept in an implicit balanced binary search tree: key 1 is the root, and the
+* children of key k are keys 2k and 2k+1. A search goes down from the root and always takes
+* the same number of steps, and the key it ends at is found from the turns it took.
+*
+* The snapshot owns one copy of the bytes of every element, in Eytzinger order. When all of the
+* keys (or all of the data elements) have the same size, they are packed back to back without
+* any index, so element k is at k * stride. Otherwise they are packed one after the other,
+* each aligned to its size, and an array of offsets tells where each one starts.
+* The arrays start at a cache line, so the 2^d descendants of element k which are d levels down
+* share the cache line at (2^d * k) * stride, and the search prefetches it d levels ahead.
+*/
+#define CACHE_LINE_SIZE 64
+#define MAX_ALIGNMENT 16
+
+/**
+* The perfect hash index splits the keys into buckets of about BUCKET_SIZE keys by one hash,
+* and places the largest buckets first: for every bucket, it looks for a displacement d for
+* which all of its keys fall in free slots, where the slot of a key is (f + d * g) % slots
+* for two more hashes of the key, f and g. A lookup then hashes the key, reads the
+* displacement of its bucket, and compares the key to the single one in its slot.
+*/
+#define BUCKET_SIZE 4
+#define MAX_DISPLACEMENT 4096 // if no displacement works for a bucket, try other hashes
+#define MAX_HASH_SEEDS 4       // if no hashes work for all of the buckets, give up the index
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address)
+#endif
+
+typedef struct element_array_t {
+    unsigned char* bytes;
+    size_t stride;   // the size of every element, if they all have the same size
+    size_t* offsets; // NULL if they all have the same size, and otherwise where element k starts
+    int prefetch_shift; // descendants this many levels down share a cache line of the array (0 for none)
+} ElementArray;
+
+typedef struct key_hashes_t {
+    unsigned long long bucket;
+    unsigned long long first;  // f, where the key's probing starts
+    unsigned long long second; // g, how far each displacement moves the key
+} KeyHashes;
+
+static bool buildElements(ElementArray* array, void** elements, int size, sizeMapElements sizeElement);
+static size_t elementAlignment(size_t size);
+static void* elementAt(const ElementArray* array, int index);
+static void prefetchElement(const ElementArray* array, int size, int index);
+static int firstIndex(int size);
+static int nextIndex(int size, int index);
+static int lowerBound(FrozenMap map, MapKeyElement keyElement);
+static int findIndex(FrozenMap map, MapKeyElement keyElement);
+static unsigned long long mixHash(size_t hash, unsigned long long seed);
+static KeyHashes hashKey(FrozenMap map, size_t hash, unsigned long long seed);
+static bool buildHashIndex(FrozenMap map);
+static bool placeBuckets(FrozenMap map, size_t* user_hashes, KeyHashes* hashes, int* order, int* bucket_starts);
+
+struct frozen_map_t {
+    int size;
+    ElementArray keys; // keys 1..size in Eytzinger order, there is no key 0
+    ElementArray data; // data element k is paired with key k
+    compareMapKeyElements compareKeyElements;
+    hashMapKeyElements hashKeyElement; // NULL if the map has no hash index
+    unsigned long long seed;
+    int buckets_count;
+    unsigned int* displacements;
+    int slots_count;
+    int* slots; // the index in keys of the key in each slot, or 0 for an empty slot
+};
+
+FrozenMap mapFreeze(Map map, sizeMapElements sizeKeyElement, sizeMapElements sizeDataElement,
+                    hashMapKeyElements hashKeyElement)
+{
+    if (map == NULL || sizeKeyElement == NULL || sizeDataElement == NULL) {
+        return NULL;
+    }
+    FrozenMap frozen = (FrozenMap)malloc(sizeof(*frozen));
+    if (frozen == NULL) {
+        return NULL;
+    }
+    memset(frozen, 0, sizeof(*frozen));
+    frozen->size = mapGetSize(map);
+    frozen->compareKeyElements = mapGetCompareFunction(map);
+
+    // the map's elements in Eytzinger order, until their bytes are copied
+    MapKeyElement* keys = (MapKeyElement*)malloc((frozen->size + 1) * sizeof(MapKeyElement));
+    MapDataElement* data = (MapDataElement*)malloc((frozen->size + 1) * sizeof(MapDataElement));
+    bool built = (keys != NULL && data != NULL);
+    if (built) {
+        MapCursor cursor;
+        int index = firstIndex(frozen->size);
+        for (bool valid = mapCursorFirst(map, &cursor); valid; valid = mapCursorNext(&cursor)) {
+            keys[index] = mapCursorGetKey(&cursor);
+            data[index] = mapCursorGetData(&cursor);
+            index = nextIndex(frozen->size, index);
+        }
+        built = buildElements(&frozen->keys, keys, frozen->size, sizeKeyElement) &&
+                buildElements(&frozen->data, data, frozen->size, sizeDataElement);
+    }
+    free(keys);
+    free(data);
+    if (!built) {
+        frozenMapDestroy(frozen);
+        return NULL;
+    }
+
+    if (hashKeyElement != NULL && frozen->size > 0) {
+        frozen->hashKeyElement = hashKeyElement;
+        if (!buildHashIndex(frozen)) {
+            frozen->hashKeyElement = NULL;
+        }
+    }
+
+    return frozen;
+}
+
+void frozenMapDestroy(FrozenMap map)
+{
+    if (map == NULL) {
+        return;
+    }
+    free(map->keys.bytes);
+    free(map->keys.offsets);
+    free(map->data.bytes);
+    free(map->data.offsets);
+    free(map->displacements);
+    free(map->slots);
+    free(map);
+}
+
+int frozenMapGetSize(FrozenMap map)
+{
+    if (map == NULL) {
+        return NULL_MAP_SIZE;
+    }
+    return map->size;
+}
+
+bool frozenMapContains(FrozenMap map, MapKeyElement element)
+{
+    if (map == NULL || element == NULL) {
+        return false;
+    }
+    return findIndex(map, element) != 0;
+}
+
+MapDataElement frozenMapGet(FrozenMap map, MapKeyElement keyElement)
+{
+    if (map == NULL || keyElement == NULL) {
+        return NULL;
+    }
+    int index = findIndex(map, keyElement);
+    return (index == 0 ? NULL : elementAt(&map->data, index));
+}
+
+MapResult frozenMapForEach(FrozenMap map, visitMapElements visit, void* context)
+{
+    return frozenMapRangeForEach(map, NULL, NULL, visit, context);
+}
+
+MapResult frozenMapRangeForEach(FrozenMap map, MapKeyElement low, MapKeyElement high,
+                                visitMapElements visit, void* context)
+{
+    if (map == NULL || visit == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    int index = (low == NULL ? firstIndex(map->size) : lowerBound(map, low));
+    for (; index != 0; index = nextIndex(map->size, index)) {
+        MapKeyElement key = elementAt(&map->keys, index);
+        if (high != NULL && map->compareKeyElements(key, high) >= 0) {
+            break;
+        }
+        if (!visit(key, elementAt(&map->data, index), context)) {
+            break;
+        }
+    }
+
+    return MAP_SUCCESS;
+}
+
+// ============================ ELEMENTS ============================ //
+
+/**
+* Copies the bytes of elements[1..size] into the array. Returns false if an allocation failed
+* or an element is empty.
+*/
+static bool buildElements(ElementArray* array, void** elements, int size, sizeMapElements sizeElement)
+{
+    array->stride = (size > 0 ? sizeElement(elements[1]) : 0);
+    bool same_size = true;
+    size_t total = 0;
+    for (int i = 1; i <= size; i++) {
+        size_t element_size = sizeElement(elements[i]);
+        if (element_size == 0) {
+            return false;
+        }
+        same_size = same_size && element_size == array->stride;
+        size_t alignment = elementAlignment(element_size);
+        total = (total + alignment - 1) / alignment * alignment + element_size;
+    }
+    if (same_size) {
+        total = (size + 1) * array->stride; // no element 0, but index k stays at k * stride
+    }
+    else {
+        array->offsets = (size_t*)malloc((size + 1) * sizeof(size_t));
+        if (array->offsets == NULL) {
+            return false;
+        }
+    }
+    if (total == 0) {
+        return true; // an empty map has no bytes
+    }
+    array->bytes = (unsigned char*)aligned_alloc(CACHE_LINE_SIZE,
+                                                 (total + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE);
+    if (array->bytes == NULL) {
+        return false;
+    }
+
+    size_t offset = 0;
+    for (int i = 1; i <= size; i++) {
+        size_t element_size = sizeElement(elements[i]);
+        if (same_size) {
+            offset = i * array->stride;
+        }
+        else {
+            size_t alignment = elementAlignment(element_size);
+            offset = (offset + alignment - 1) / alignment * alignment;
+            array->offsets[i] = offset;
+        }
+        memcpy(array->bytes + offset, elements[i], element_size);
+        offset += element_size;
+    }
+
+    // what the search reads to go down the tree is the stride, or an offset
+    size_t unit = (same_size ? array->stride : sizeof(size_t));
+    array->prefetch_shift = 0;
+    while (((size_t)2 << array->prefetch_shift) * unit <= CACHE_LINE_SIZE) {
+        array->prefetch_shift++;
+    }
+    return true;
+}
+
+/**
+* Returns the alignment which an element of the given size may need: the largest power of 2
+* which divides the size (the alignment of a type always divides its size), up to MAX_ALIGNMENT.
+*/
+static size_t elementAlignment(size_t size)
+{
+    size_t alignment = 1;
+    while (alignment < MAX_ALIGNMENT && size % (2 * alignment) == 0) {
+        alignment *= 2;
+    }
+    return alignment;
+}
+
+static void* elementAt(const ElementArray* array, int index)
+{
+    return array->bytes + (array->offsets == NULL ? index * array->stride : array->offsets[index]);
+}
+
+/**
+* Asks for the cache line of the descendants of the given element, prefetch_shift levels down.
+*/
+static void prefetchElement(const ElementArray* array, int size, int index)
+{
+    if (array->prefetch_shift == 0) {
+        return;
+    }
+    int ahead = index << array->prefetch_shift;
+    if (ahead > size) {
+        return;
+    }
+    if (array->offsets == NULL) {
+        PREFETCH(array->bytes + ahead * array->stride);
+    }
+    else {
+        PREFETCH(&array->offsets[ahead]);
+    }
+}
+
+// ============================ EYTZINGER ORDER ============================ //
+
+/**
+* Returns the index of the smallest key, which is the leftmost node of the tree (0 if it is empty).
+*/
+static int firstIndex(int size)
+{
+    int index = (size == 0 ? 0 : 1);
+    while (2 * index <= size && index != 0) {
+        index *= 2;
+    }
+    return index;
+}
+
+/**
+* Returns the index of the key which comes after the given one in order (0 if it is the last).
+*/
+static int nextIndex(int size, int index)
+{
+    if (2 * index + 1 <= size) {
+        // the leftmost node of the right subtree
+        index = 2 * index + 1;
+        while (2 * index <= size) {
+            index *= 2;
+        }
+        return index;
+    }
+    // go up while coming from a right child, and then up once more (the root's parent is 0)
+    while (index & 1) {
+        index >>= 1;
+    }
+    return index >> 1;
+}
+
+/**
+* Returns the index of the first key which is not smaller than the given key (0 if there is none).
+*/
+static int lowerBound(FrozenMap map, MapKeyElement keyElement)
+{
+    int index = 1;
+    while (index <= map->size) {
+        prefetchElement(&map->keys, map->size, index);
+        index = 2 * index + (map->compareKeyElements(elementAt(&map->keys, index), keyElement) < 0);
+    }
+    // the last left turn was at the answer: undo the right turns after it, and then that left turn
+    while (index & 1) {
+        index >>= 1;
+    }
+    return index >> 1;
+}
+
+/**
+* Returns the index of the given key, or 0 if it is not in the map.
+*/
+static int findIndex(FrozenMap map, MapKeyElement keyElement)
+{
+    int index;
+    if (map->hashKeyElement != NULL) {
+        KeyHashes hashes = hashKey(map, map->hashKeyElement(keyElement), map->seed);
+        unsigned int displacement = map->displacements[hashes.bucket];
+        index = map->slots[(hashes.first + displacement * hashes.second) % map->slots_count];
+    }
+    else {
+        index = lowerBound(map, keyElement);
+    }
+    return (index != 0 && map->compareKeyElements(elementAt(&map->keys, index), keyElement) == 0 ? index : 0);
+}
+
+// ============================ PERFECT HASH ============================ //
+
+/**
+* A strong mix of the user's hash (the finalizer of splitmix64), so that weak hashes
+* still spread well, and different seeds give unrelated hashes.
+*/
+static unsigned long long mixHash(size_t hash, unsigned long long seed)
+{
+    unsigned long long mixed = (unsigned long long)hash + seed * 0x9E3779B97F4A7C15ULL;
+    mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBULL;
+    return mixed ^ (mixed >> 31);
+}
+
+static KeyHashes hashKey(FrozenMap map, size_t hash, unsigned long long seed)
+{
+    KeyHashes hashes;
+    hashes.bucket = mixHash(hash, 3 * seed + 1) % map->buckets_count;
+    hashes.first = mixHash(hash, 3 * seed + 2) % map->slots_count;
+    hashes.second = 1 + mixHash(hash, 3 * seed + 3) % (map->slots_count - 1); // never 0, so displacements move the key
+    return hashes;
+}
+
+/**
+* Builds the perfect hash index of the map. Returns false if an allocation failed,
+* or if no perfect hash was found (which happens when too many keys have the same hash).
+*/
+static bool buildHashIndex(FrozenMap map)
+{
+    map->buckets_count = map->size / BUCKET_SIZE + 1;
+    map->slots_count = map->size + map->size / 4 + 1;
+    map->displacements = (unsigned int*)malloc(map->buckets_count * sizeof(unsigned int));
+    map->slots = (int*)malloc(map->slots_count * sizeof(int));
+    size_t* user_hashes = (size_t*)malloc((map->size + 1) * sizeof(size_t));
+    KeyHashes* hashes = (KeyHashes*)malloc((map->size + 1) * sizeof(KeyHashes));
+    int* order = (int*)malloc(map->size * sizeof(int));
+    int* bucket_starts = (int*)malloc((map->buckets_count + 1) * sizeof(int));
+
+    bool built = false;
+    if (map->displacements != NULL && map->slots != NULL && user_hashes != NULL &&
+        hashes != NULL && order != NULL && bucket_starts != NULL) {
+        for (int i = 1; i <= map->size; i++) {
+            user_hashes[i] = map->hashKeyElement(elementAt(&map->keys, i));
+        }
+        for (map->seed = 0; map->seed < MAX_HASH_SEEDS; map->seed++) {
+            built = placeBuckets(map, user_hashes, hashes, order, bucket_starts);
+            if (built) {
+                break;
+            }
+        }
+    }
+
+    free(user_hashes);
+    free(hashes);
+    free(order);
+    free(bucket_starts);
+    if (!built) {
+        free(map->displacements);
+        free(map->slots);
+        map->displacements = NULL;
+        map->slots = NULL;
+    }
+    return built;
+}
+
+/**
+* Tries to place all of the keys in the slots with the map's current seed.
+* The keys are grouped by bucket in order, where bucket b holds order[bucket_starts[b]] up to
+* (and not including) order[bucket_starts[b + 1]].
+*/
+static bool placeBuckets(FrozenMap map, size_t* user_hashes, KeyHashes* hashes, int* order, int* bucket_starts)
+{
+    memset(bucket_starts, 0, (map->buckets_count + 1) * sizeof(int));
+    int largest = 0;
+    for (int i = 1; i <= map->size; i++) {
+        hashes[i] = hashKey(map, user_hashes[i], map->seed);
+        int count = ++bucket_starts[hashes[i].bucket + 1];
+        largest = (count > largest ? count : largest);
+    }
+    for (int b = 0; b < map->buckets_count; b++) {
+        bucket_starts[b + 1] += bucket_starts[b];
+    }
+    for (int i = 1; i <= map->size; i++) {
+        order[bucket_starts[hashes[i].bucket]++] = i; // moves every start to the start of the next bucket
+    }
+    for (int b = map->buckets_count; b > 0; b--) {
+        bucket_starts[b] = bucket_starts[b - 1];
+    }
+    bucket_starts[0] = 0;
+
+    memset(map->slots, 0, map->slots_count * sizeof(int));
+    memset(map->displacements, 0, map->buckets_count * sizeof(unsigned int));
+    // the largest buckets are the hardest to place, so they are placed while most of the slots are free
+    for (int size = largest; size > 0; size--) {
+        for (int b = 0; b < map->buckets_count; b++) {
+            int start = bucket_starts[b];
+            if (bucket_starts[b + 1] - start != size) {
+                continue;
+            }
+            bool placed = false;
+            for (unsigned int displacement = 0; displacement < MAX_DISPLACEMENT && !placed; displacement++) {
+                int count = 0;
+                for (; count < size; count++) {
+                    KeyHashes* key = &hashes[order[start + count]];
+                    int* slot = &map->slots[(key->first + displacement * key->second) % map->slots_count];
+                    if (*slot != 0) {
+                        break;
+                    }
+                    *slot = order[start + count];
+                }
+                placed = (count == size);
+                if (placed) {
+                    map->displacements[b] = displacement;
+                }
+                while (!placed && count > 0) {
+                    count--;
+                    KeyHashes* key = &hashes[order[start + count]];
+                    map->slots[(key->first + displacement * key->second) % map->slots_count] = 0;
+                }
+            }
+            if (!placed) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
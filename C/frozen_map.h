@@ -0,0 +1,133 @@
+#ifndef FROZEN_MAP_H_
+#define FROZEN_MAP_H_
+
+#include <stdbool.h>
+
+#include "ordered_map.h"
+
+/**
+* A Generic Read-Only Ordered-Map Container (ADT)
+*
+* A frozen map is an immutable snapshot of a Map, made for maps which are built once and then
+* only read. The bytes of the keys are copied into one array in Eytzinger order (the order of
+* a breadth-first walk over a balanced binary search tree), and the data elements into another,
+* so a search walks down the array without branching on the result of the comparisons or
+* following pointers, and the first levels of the search share a few cache lines.
+* Keys of the same size (such as numbers or fixed-size structs) are packed back to back.
+*
+* Optionally, the snapshot also has a perfect hash index (built by hash-and-displace),
+* and then a lookup of an exact key costs a single comparison.
+*
+* Only flat elements can be frozen: elements whose bytes are all of their content (no pointers),
+* such as numbers, fixed-size structs or strings, the same as in mapSaveToFile. The size of each
+* element is given by the user, and the elements which are passed to the functions of a frozen map
+* point at the copied bytes.
+*
+* The ADT provides the following methods:
+*   mapFreeze
+*   frozenMapDestroy
+*   frozenMapGetSize
+*   frozenMapContains
+*   frozenMapGet
+*   frozenMapForEach
+*   frozenMapRangeForEach
+*
+*   NOTE: the frozen map holds its own copies of the elements, and nothing else of the map
+*         it was made of, so that map may be modified or destroyed afterwards.
+*
+*   NOTE: a frozen map is never modified, so any number of threads may read it at once.
+*/
+
+// ============================ TYPEDEFS ============================ //
+typedef struct frozen_map_t * FrozenMap;
+
+
+// ============================ FUNCTIONS ============================ //
+/**
+* mapFreeze: Creates a read-only snapshot of a map, with copies of the bytes of its pairs.
+* This takes O(n) time, plus the time it takes to build the hash index (expected O(n)).
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to take a snapshot of.
+* @param sizeKeyElement - A Function pointer which returns the size of a key element.
+* @param sizeDataElement - A Function pointer which returns the size of a data element.
+* @param hashKeyElement - A Function pointer for hashing key elements, or NULL for no hash index.
+*                         If the keys' hashes collide too much for a perfect hash,
+*                         the snapshot is made without a hash index.
+* @return
+* 	NULL if a NULL was sent as map or as a size function, an element has a size of 0,
+* 	or a memory allocation failed.
+* 	Otherwise, a new FrozenMap containing the same elements as the given Map.
+*/
+FrozenMap mapFreeze(Map map, sizeMapElements sizeKeyElement, sizeMapElements sizeDataElement,
+                    hashMapKeyElements hashKeyElement);
+
+/**
+* frozenMapDestroy: Deallocates a frozen map and all of it's elements.
+*
+* @param map - Map to be deallocated. If map is NULL nothing will be done.
+*/
+void frozenMapDestroy(FrozenMap map);
+
+/**
+* frozenMapGetSize: Returns the number of elements in a frozen map.
+*
+* @param map - The map which size is requested.
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of elements in the map.
+*/
+int frozenMapGetSize(FrozenMap map);
+
+/**
+* frozenMapContains: Checks if a key element exists in the frozen map.
+*
+* @param map - The map to search in.
+* @param element - The element to look for. Will be compared using the comparison function.
+* @return
+* 	false - if one or more of the inputs is null, or if the key element was not found.
+* 	true - if the key element was found in the map.
+*/
+bool frozenMapContains(FrozenMap map, MapKeyElement element);
+
+/**
+* frozenMapGet: Returns the data associated with a specific key in the frozen map.
+*
+* @param map - The map for which to get the data element from.
+* @param keyElement - The key element which need to be found and whos data we want to get.
+* @return
+* 	NULL if a NULL pointer was sent or if the map does not contain the requested key.
+* 	Otherwise, the data element associated with the key (not a copy!).
+*/
+MapDataElement frozenMapGet(FrozenMap map, MapKeyElement keyElement);
+
+/**
+* frozenMapForEach: Calls a function on every pair in the frozen map, in order, until it returns false.
+* The elements are passed as they are in the map (and not copies), and must not be modified.
+*
+* @param map - The map to iterate over.
+* @param visit - The function to call on each pair.
+* @param context - A parameter passed as is to every call of visit.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or visit.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult frozenMapForEach(FrozenMap map, visitMapElements visit, void* context);
+
+/**
+* frozenMapRangeForEach: Calls a function on every pair whose key is in [low, high), in order,
+* until it returns false. The first pair is found in O(log n) comparisons.
+*
+* @param map - The map to iterate over.
+* @param low - The smallest key to visit, or NULL to start from the first key.
+* @param high - The key to stop before, or NULL to go on to the last key.
+* @param visit - The function to call on each pair.
+* @param context - A parameter passed as is to every call of visit.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or visit.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult frozenMapRangeForEach(FrozenMap map, MapKeyElement low, MapKeyElement high,
+                                visitMapElements visit, void* context);
+
+#endif
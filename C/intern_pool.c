@@ -0,0 +1,214 @@
+#include "intern_pool.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define NULL_POOL_SIZE -1
+
+/**
+* The strings are copied into blocks of BLOCK_SIZE bytes, and a string which does not fit
+* in what is left of the current block starts a new one (a longer string gets a block of its own).
+* The strings are found by an open addressing hash table of pointers into the blocks,
+* which doubles when it becomes more than 3/4 full.
+*/
+#define BLOCK_SIZE (64 * 1024)
+#define INITIAL_CAPACITY 64 // a power of 2, so a hash is reduced to an index by a mask
+
+typedef struct block_t {
+    struct block_t* next;
+    size_t used;
+    size_t capacity;
+    char bytes[];
+} Block;
+
+typedef struct slot_t {
+    size_t hash;
+    const char* string; // NULL for an empty slot
+} Slot;
+
+static size_t hashString(const char* string, size_t* length);
+static Slot* findSlot(InternPool pool, const char* string, size_t hash);
+static char* allocateString(InternPool pool, size_t size);
+static bool growTable(InternPool pool);
+
+struct intern_pool_t {
+    Block* blocks; // the current block first
+    Slot* slots;
+    size_t capacity;
+    int size;
+    size_t memory;
+};
+
+InternPool internPoolCreate(void)
+{
+    InternPool pool = (InternPool)malloc(sizeof(*pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->slots = (Slot*)calloc(INITIAL_CAPACITY, sizeof(Slot));
+    if (pool->slots == NULL) {
+        free(pool);
+        return NULL;
+    }
+    pool->blocks = NULL;
+    pool->capacity = INITIAL_CAPACITY;
+    pool->size = 0;
+    pool->memory = sizeof(*pool) + INITIAL_CAPACITY * sizeof(Slot);
+
+    return pool;
+}
+
+void internPoolDestroy(InternPool pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    while (pool->blocks != NULL) {
+        Block* block = pool->blocks;
+        pool->blocks = block->next;
+        free(block);
+    }
+    free(pool->slots);
+    free(pool);
+}
+
+const char* internPoolIntern(InternPool pool, const char* string)
+{
+    if (pool == NULL || string == NULL) {
+        return NULL;
+    }
+
+    size_t length;
+    size_t hash = hashString(string, &length);
+    Slot* slot = findSlot(pool, string, hash);
+    if (slot->string != NULL) {
+        return slot->string;
+    }
+    if (4 * (size_t)(pool->size + 1) > 3 * pool->capacity) {
+        if (!growTable(pool)) {
+            return NULL;
+        }
+        slot = findSlot(pool, string, hash);
+    }
+
+    char* copy = allocateString(pool, length + 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+    memcpy(copy, string, length + 1);
+    slot->hash = hash;
+    slot->string = copy;
+    pool->size++;
+
+    return copy;
+}
+
+const char* internPoolFind(InternPool pool, const char* string)
+{
+    if (pool == NULL || string == NULL) {
+        return NULL;
+    }
+    size_t length;
+    return findSlot(pool, string, hashString(string, &length))->string;
+}
+
+int internPoolGetSize(InternPool pool)
+{
+    if (pool == NULL) {
+        return NULL_POOL_SIZE;
+    }
+    return pool->size;
+}
+
+size_t internPoolGetMemory(InternPool pool)
+{
+    if (pool == NULL) {
+        return 0;
+    }
+    return pool->memory;
+}
+
+/**
+* The FNV-1a hash of a string, which also measures its length on the way.
+*/
+static size_t hashString(const char* string, size_t* length)
+{
+    unsigned long long hash = 0xCBF29CE484222325ULL;
+    const unsigned char* byte = (const unsigned char*)string;
+    for (; *byte != '\0'; byte++) {
+        hash = (hash ^ *byte) * 0x100000001B3ULL;
+    }
+    *length = (size_t)(byte - (const unsigned char*)string);
+    return (size_t)(hash ^ (hash >> 32));
+}
+
+/**
+* Returns the slot which holds the string, or the empty slot where it should be added.
+* The table is never full, so the probing always ends.
+*/
+static Slot* findSlot(InternPool pool, const char* string, size_t hash)
+{
+    size_t mask = pool->capacity - 1;
+    for (size_t index = hash & mask; ; index = (index + 1) & mask) {
+        Slot* slot = &pool->slots[index];
+        if (slot->string == NULL || (slot->hash == hash && strcmp(slot->string, string) == 0)) {
+            return slot;
+        }
+    }
+}
+
+/**
+* Returns room for size bytes in the current block, or in a new block if it is full.
+*/
+static char* allocateString(InternPool pool, size_t size)
+{
+    Block* block = pool->blocks;
+    if (block == NULL || block->capacity - block->used < size) {
+        size_t capacity = (size > BLOCK_SIZE ? size : BLOCK_SIZE);
+        block = (Block*)malloc(sizeof(Block) + capacity);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->used = 0;
+        block->capacity = capacity;
+        if (size > BLOCK_SIZE && pool->blocks != NULL) { // keep filling the current block afterwards
+            block->next = pool->blocks->next;
+            pool->blocks->next = block;
+        }
+        else {
+            block->next = pool->blocks;
+            pool->blocks = block;
+        }
+        pool->memory += sizeof(Block) + capacity;
+    }
+
+    char* bytes = block->bytes + block->used;
+    block->used += size;
+    return bytes;
+}
+
+static bool growTable(InternPool pool)
+{
+    size_t capacity = 2 * pool->capacity;
+    Slot* slots = (Slot*)calloc(capacity, sizeof(Slot));
+    if (slots == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < pool->capacity; i++) {
+        if (pool->slots[i].string == NULL) {
+            continue;
+        }
+        size_t index = pool->slots[i].hash & (capacity - 1);
+        while (slots[index].string != NULL) {
+            index = (index + 1) & (capacity - 1);
+        }
+        slots[index] = pool->slots[i];
+    }
+
+    free(pool->slots);
+    pool->memory += (capacity - pool->capacity) * sizeof(Slot);
+    pool->slots = slots;
+    pool->capacity = capacity;
+    return true;
+}
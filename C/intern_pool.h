@@ -0,0 +1,93 @@
+#ifndef INTERN_POOL_H_
+#define INTERN_POOL_H_
+
+#include <stddef.h>
+
+/**
+* A String Interning Pool (ADT)
+*
+* The pool keeps a single copy of every string it is given, so equal strings are stored once,
+* and two interned strings are equal exactly when they are the same pointer.
+* The strings are packed one after the other in large blocks (an append-only arena),
+* so interning a string which is not yet in the pool costs no allocation of its own,
+* and interning a string which is already in the pool allocates nothing.
+*
+* A Map or a Set with string keys can be given a pool (see mapCreateInterned and setCreateInterned),
+* and then it keeps the pool's strings instead of copying every key it is given.
+*
+* The ADT provides the following methods:
+*   internPoolCreate
+*   internPoolDestroy
+*   internPoolIntern
+*   internPoolFind
+*   internPoolGetSize
+*   internPoolGetMemory
+*
+*   NOTE: strings are never removed from a pool, they are all freed together when it is destroyed.
+*         So the pool must outlive every map and set which uses it.
+*/
+
+// ============================ TYPEDEFS ============================ //
+typedef struct intern_pool_t * InternPool;
+
+
+// ============================ FUNCTIONS ============================ //
+/**
+* internPoolCreate: Allocates and returns a new empty pool.
+*
+* @return
+* 	NULL - if allocations failed.
+* 	A new InternPool in case of success.
+*/
+InternPool internPoolCreate(void);
+
+/**
+* internPoolDestroy: Deallocates a pool and all of its strings.
+*
+* @param pool - Pool to be deallocated. If pool is NULL nothing will be done.
+*/
+void internPoolDestroy(InternPool pool);
+
+/**
+* internPoolIntern: Returns the pool's copy of a string, and adds it to the pool if it is not there yet.
+*
+* @param pool - The pool to intern the string in.
+* @param string - The string to intern.
+* @return
+* 	NULL if a NULL was sent or a memory allocation failed.
+* 	Otherwise, the pool's copy of the string, which is valid until the pool is destroyed.
+*/
+const char* internPoolIntern(InternPool pool, const char* string);
+
+/**
+* internPoolFind: Returns the pool's copy of a string, without adding it to the pool.
+*
+* @param pool - The pool to search in.
+* @param string - The string to look for.
+* @return
+* 	NULL if a NULL was sent or the string is not in the pool.
+* 	Otherwise, the pool's copy of the string.
+*/
+const char* internPoolFind(InternPool pool, const char* string);
+
+/**
+* internPoolGetSize: Returns the number of distinct strings in a pool.
+*
+* @param pool - The pool which size is requested.
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of strings in the pool.
+*/
+int internPoolGetSize(InternPool pool);
+
+/**
+* internPoolGetMemory: Returns the number of bytes a pool has allocated, for its strings and its index.
+*
+* @param pool - The pool which memory usage is requested.
+* @return
+* 	0 if a NULL pointer was sent.
+* 	Otherwise the number of allocated bytes.
+*/
+size_t internPoolGetMemory(InternPool pool);
+
+#endif
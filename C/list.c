@@ -2,16 +2,47 @@
 
 #include <stdlib.h>
 
+#define PARALLEL_TASKS_PER_THREAD 8 // more tasks than threads, so the threads which finish early take more of them
+#define MIN_PARALLEL_TASK_SIZE 64   // fewer elements are not worth a task of their own
+#define SORT_BINS 32 // bin i of the merge sort holds 2^i nodes, so the bins can hold any list
+
 typedef struct node_t {
     Element data;
     struct node_t* next;
+    struct node_t* prev;
 } Node;
 
+typedef struct list_task_t {
+    Node* first;
+    int count;
+    ElemApplyFunction function;
+    ElemConditionFunction condition;
+    void* param;
+    bool* passed; // the results of condition, one for each of the task's elements
+    ElemCompareFunction compare;
+    Node* second; // the sorted nodes which are merged into first
+} ListTask;
+
 static void removeNodeElement (List list, Node* node);
 static Node* createNode(List list, Element element);
+static Node* wrapElement(List list, Element data);
+static void  appendNode(List list, Node* node);
+static void  linkBefore(List list, Node* node, Node* next);
+static void  linkChain(List list, Node* first, Node* last, int count, Node* next);
+static bool  areCompatible(List list1, List list2);
+static void  unlinkNode(List list, Node* node);
+static void  relinkPrevious(List list);
+static ListTask* splitTasks(List list, ThreadPool pool, int* task_count);
+static void applyTask(void* task);
+static void filterTask(void* task);
+static void sortTask(void* task);
+static void mergeTask(void* task);
+static Node* sortNodes(Node* head, ElemCompareFunction compare);
+static Node* mergeNodes(Node* first, Node* second, ElemCompareFunction compare);
 
 struct list_t {
     Node* head;
+    Node* tail;
     Node* iterator;
     int size;
     ElemCopyFunction copyElement;
@@ -29,6 +60,7 @@ List listCreate(ElemCopyFunction copyElement, ElemFreeFunction freeElement)
     }
     list->size = 0;
     list->head = NULL; 
+    list->tail = NULL;
 
     list->iterator = NULL;
     list->copyElement = copyElement;
@@ -58,7 +90,7 @@ List listCopy(List list)
     new_list->size = 0;
     Node* ptr = list->head;
     while (ptr != NULL) {
-        if (listInsertLast(new_list, ptr->data) != LIST_SUCCESS) { // TODO: replace with something more efficient
+        if (listInsertLast(new_list, ptr->data) != LIST_SUCCESS) {
             listDestroy(new_list);
             return NULL;
         }
@@ -90,10 +122,7 @@ ListResult listInsertFirst(List list, Element element)
     if (node == NULL) {
         return LIST_OUT_OF_MEMORY;
     }
-
-    Node* next = list->head;
-    node->next = next;
-    list->head = node;
+    linkBefore(list, node, list->head);
 
     return LIST_SUCCESS;
 }
@@ -104,18 +133,26 @@ ListResult listInsertLast(List list, Element element)
         return LIST_NULL_ARG;
     }
 
-    if (list->size == 0) {
-        return listInsertFirst(list, element);
-    }
-
     Node* node = createNode(list, element);
     if (node == NULL) {
         return LIST_OUT_OF_MEMORY;
     }
+    appendNode(list, node);
+
+    return LIST_SUCCESS;
+}
+
+ListResult listInsertLastTake(List list, Element element)
+{
+    if (list == NULL || element == NULL) {
+        return LIST_NULL_ARG;
+    }
 
-    Node* last = list->head;
-    for (; last->next != NULL; last = last->next);
-    last->next = node;
+    Node* node = wrapElement(list, element);
+    if (node == NULL) {
+        return LIST_OUT_OF_MEMORY;
+    }
+    appendNode(list, node);
 
     return LIST_SUCCESS;
 }
@@ -130,19 +167,12 @@ ListResult listInsertBeforeCurrent(List list, Element element)
         return LIST_INVALID_CURRENT;
     }
 
-    if (list->iterator == list->head) {
-        return listInsertFirst(list, element);
-    }
-
+    Node* current = list->iterator;
     Node* node = createNode(list, element);
     if (node == NULL) {
         return LIST_OUT_OF_MEMORY;
     }
-
-    Node* last = list->head;
-    for (; last->next != list->iterator; last = last->next);
-    node->next = last->next;
-    last->next = node;
+    linkBefore(list, node, current);
 
     return LIST_SUCCESS;
 }
@@ -157,37 +187,103 @@ ListResult listInsertAfterCurrent(List list, Element element)
         return LIST_INVALID_CURRENT;
     }
 
+    Node* current = list->iterator;
     Node* node = createNode(list, element);
     if (node == NULL) {
         return LIST_OUT_OF_MEMORY;
     }
-
-    node->next = list->iterator->next;
-    list->iterator->next = node;
+    linkBefore(list, node, current->next);
 
     return LIST_SUCCESS;
 }
 
 static Node* createNode(List list, Element element)
 {
-    Node* new_node = (Node*)malloc(sizeof(*new_node));
-    if (new_node == NULL) {
+    Element data = list->copyElement(element);
+    if (data == NULL) {
         return NULL;
     }
-    
-    new_node->data = list->copyElement(element);
-    if(new_node->data == NULL) {
-        free(new_node);
+
+    Node* new_node = wrapElement(list, data);
+    if (new_node == NULL) {
+        list->freeElement(data);
+    }
+
+    return new_node;
+}
+
+static Node* wrapElement(List list, Element data)
+{
+    Node* new_node = (Node*)malloc(sizeof(*new_node));
+    if (new_node == NULL) {
         return NULL;
     }
 
+    new_node->data = data;
     new_node->next = NULL;
+    new_node->prev = NULL;
     list->iterator = new_node;
     list->size++;
 
     return new_node;
 }
 
+static void appendNode(List list, Node* node)
+{
+    linkBefore(list, node, NULL);
+}
+
+/* Links a node right before next, or last in the list if next is NULL. */
+static void linkBefore(List list, Node* node, Node* next)
+{
+    linkChain(list, node, node, 0, next);
+}
+
+/* Links the chain of nodes from first to last right before next (last in the list if next is NULL),
+ * and adds count to the size of the list. */
+static void linkChain(List list, Node* first, Node* last, int count, Node* next)
+{
+    last->next = next;
+    first->prev = (next == NULL ? list->tail : next->prev);
+    if (first->prev == NULL) {
+        list->head = first;
+    }
+    else {
+        first->prev->next = first;
+    }
+    if (next == NULL) {
+        list->tail = last;
+    }
+    else {
+        next->prev = last;
+    }
+    list->size += count;
+}
+
+/* Nodes can only be moved between lists which copy and free their elements the same way. */
+static bool areCompatible(List list1, List list2)
+{
+    return list1 != list2 &&
+           list1->copyElement == list2->copyElement &&
+           list1->freeElement == list2->freeElement;
+}
+
+static void unlinkNode(List list, Node* node)
+{
+    if (node->prev == NULL) {
+        list->head = node->next;
+    }
+    else {
+        node->prev->next = node->next;
+    }
+    if (node->next == NULL) {
+        list->tail = node->prev;
+    }
+    else {
+        node->next->prev = node->prev;
+    }
+}
+
 Element listGetFirst(List list)
 {
     if (list == NULL || list->head == NULL) {
@@ -208,9 +304,29 @@ Element listGetNext(List list)
     return list->iterator->data;
 }
 
+Element listGetLast(List list)
+{
+    if (list == NULL || list->tail == NULL) {
+        return NULL;
+    }
+
+    list->iterator = list->tail;
+    return list->iterator->data;
+}
+
+Element listGetPrevious(List list)
+{
+    if (list == NULL || list->iterator == NULL || list->iterator->prev == NULL) {
+        return NULL;
+    }
+
+    list->iterator = list->iterator->prev;
+    return list->iterator->data;
+}
+
 Element listGetCurrent(List list)
 {
-    if(list == NULL) {
+    if(list == NULL || list->iterator == NULL) {
         return NULL;
     }
     return list->iterator->data;
@@ -225,20 +341,10 @@ ListResult listRemoveCurrent(List list)
         return LIST_INVALID_CURRENT;
     }
 
-    Node* ptr = list->head;
-    if(list->iterator = list->head) {
-        list->head = list->head->next;
-        list->iterator = list->head;
-        removeNodeElement(list, ptr);
-    }
-    else {
-        for (; ptr->next != list->iterator; ptr = ptr->next);
-        ptr->next = list->iterator->next;
-
-        Node* to_remove = list->iterator;
-        removeNodeElement(list, to_remove);
-        list->iterator = ptr->next;
-    }
+    Node* to_remove = list->iterator;
+    unlinkNode(list, to_remove);
+    list->iterator = to_remove->next;
+    removeNodeElement(list, to_remove);
 
     return LIST_SUCCESS;
 }
@@ -254,6 +360,8 @@ void listClear(List list)
         list->head = list->head->next;
         removeNodeElement(list, ptr);
     }
+    list->tail = NULL;
+    list->iterator = NULL;
 }
 
 static void removeNodeElement(List list, Node* node)
@@ -268,20 +376,127 @@ bool listIsEmpty(List list)
     return list && !list->size;
 }
 
+ListResult listConcat(List destination, List source)
+{
+    if (destination == NULL || source == NULL)
+        return LIST_NULL_ARG;
+    if (!areCompatible(destination, source))
+        return LIST_INCOMPATIBLE_LISTS;
+
+    if (source->head != NULL)
+        linkChain(destination, source->head, source->tail, source->size, NULL);
+    source->head = NULL;
+    source->tail = NULL;
+    source->iterator = NULL;
+    source->size = 0;
+
+    return LIST_SUCCESS;
+}
+
+ListResult listSplice(List destination, List source)
+{
+    if (destination == NULL || source == NULL)
+        return LIST_NULL_ARG;
+    if (!areCompatible(destination, source))
+        return LIST_INCOMPATIBLE_LISTS;
+    if (destination->iterator == NULL && destination->head != NULL)
+        return LIST_INVALID_CURRENT;
+
+    if (source->head != NULL) {
+        Node* next = (destination->iterator == NULL ? NULL : destination->iterator->next);
+        linkChain(destination, source->head, source->tail, source->size, next);
+    }
+    source->head = NULL;
+    source->tail = NULL;
+    source->iterator = NULL;
+    source->size = 0;
+
+    return LIST_SUCCESS;
+}
+
+ListResult listMoveCurrentTo(List list, List destination)
+{
+    if (list == NULL || destination == NULL)
+        return LIST_NULL_ARG;
+    if (list->iterator == NULL)
+        return LIST_INVALID_CURRENT;
+    if (list != destination && !areCompatible(list, destination))
+        return LIST_INCOMPATIBLE_LISTS;
+
+    Node* node = list->iterator;
+    list->iterator = node->next;
+    unlinkNode(list, node);
+    list->size--;
+    linkChain(destination, node, node, 1, NULL);
+
+    return LIST_SUCCESS;
+}
+
+ListResult listMergeSorted(List destination, List source, ElemCompareFunction compare)
+{
+    if (destination == NULL || source == NULL || compare == NULL)
+        return LIST_NULL_ARG;
+    if (!areCompatible(destination, source))
+        return LIST_INCOMPATIBLE_LISTS;
+
+    destination->head = mergeNodes(destination->head, source->head, compare);
+    destination->size += source->size;
+    relinkPrevious(destination);
+    source->head = NULL;
+    source->tail = NULL;
+    source->iterator = NULL;
+    source->size = 0;
+
+    return LIST_SUCCESS;
+}
+
+List listSplitAtCurrent(List list)
+{
+    if (list == NULL || list->iterator == NULL)
+        return NULL;
+
+    List result = listCreate(list->copyElement, list->freeElement);
+    if (result == NULL)
+        return NULL;
+
+    // count the shorter side, by walking from the current element to both ends at once
+    Node* first = list->iterator;
+    int moved = 1;
+    int kept = 0;
+    Node* forward = first->next;
+    Node* backward = first->prev;
+    for (; forward != NULL && backward != NULL; forward = forward->next, backward = backward->prev) {
+        moved++;
+        kept++;
+    }
+    if (forward == NULL)
+        kept = list->size - moved;
+    else
+        moved = list->size - kept;
+
+    result->head = first;
+    result->tail = list->tail;
+    result->size = moved;
+    result->iterator = first;
+    list->tail = first->prev;
+    if (list->tail == NULL)
+        list->head = NULL;
+    else
+        list->tail->next = NULL;
+    first->prev = NULL;
+    list->size = kept;
+    list->iterator = NULL;
+
+    return result;
+}
+
 ListResult listSort(List list, ElemCompareFunction compare)
 {
     if (list == NULL || compare == NULL)
         return LIST_NULL_ARG;
-    
-    for (Node* i = list->head; i != NULL; i = i->next) {
-        for (Node* j = i->next; j != NULL; j = j->next) {
-            if (compare(i->data, j->data)) {
-                Element tmp = i->data;
-                i->data = j->data;
-                j->data = tmp;
-            }
-        }
-    }
+
+    list->head = sortNodes(list->head, compare);
+    relinkPrevious(list);
 
     return LIST_SUCCESS;
 }
@@ -315,3 +530,222 @@ List listFilter(List list, ElemConditionFunction condition, void* param)
 
     return result;
 }
+
+ListResult listApplyParallel(List list, ElemApplyFunction function, ThreadPool pool)
+{
+    if (list == NULL || function == NULL || pool == NULL)
+        return LIST_NULL_ARG;
+
+    if (list->size == 0)
+        return LIST_SUCCESS;
+    int task_count;
+    ListTask* tasks = splitTasks(list, pool, &task_count);
+    if (tasks == NULL)
+        return LIST_OUT_OF_MEMORY;
+    for (int i = 0; i < task_count; i++) {
+        tasks[i].function = function;
+    }
+    threadPoolRun(pool, applyTask, tasks, sizeof(ListTask), task_count);
+    free(tasks);
+
+    return LIST_SUCCESS;
+}
+
+List listFilterParallel(List list, ElemConditionFunction condition, void* param, ThreadPool pool)
+{
+    if (list == NULL || condition == NULL || pool == NULL)
+        return NULL;
+
+    List result = listCreate(list->copyElement, list->freeElement);
+    if (result == NULL || list->size == 0)
+        return result;
+    int task_count;
+    ListTask* tasks = splitTasks(list, pool, &task_count);
+    bool* passed = (bool*)malloc(list->size * sizeof(bool));
+    if (tasks == NULL || passed == NULL) {
+        free(tasks);
+        free(passed);
+        listDestroy(result);
+        return NULL;
+    }
+    for (int i = 0, offset = 0; i < task_count; offset += tasks[i].count, i++) {
+        tasks[i].condition = condition;
+        tasks[i].param = param;
+        tasks[i].passed = passed + offset;
+    }
+    threadPoolRun(pool, filterTask, tasks, sizeof(ListTask), task_count);
+    free(tasks);
+
+    int index = 0;
+    for (Node* ptr = list->head; ptr != NULL; ptr = ptr->next, index++) {
+        if (!passed[index])
+            continue;
+        Node* node = createNode(result, ptr->data);
+        if (node == NULL) {
+            free(passed);
+            listDestroy(result);
+            return NULL;
+        }
+        appendNode(result, node);
+    }
+    free(passed);
+
+    return result;
+}
+
+ListResult listSortParallel(List list, ElemCompareFunction compare, ThreadPool pool)
+{
+    if (list == NULL || compare == NULL || pool == NULL)
+        return LIST_NULL_ARG;
+
+    if (list->size == 0)
+        return LIST_SUCCESS;
+    int task_count;
+    ListTask* tasks = splitTasks(list, pool, &task_count);
+    if (tasks == NULL)
+        return LIST_OUT_OF_MEMORY;
+    for (int i = 0; i < task_count; i++) { // cut the list into separate chunks
+        Node* last = tasks[i].first;
+        for (int j = 1; j < tasks[i].count; j++, last = last->next);
+        last->next = NULL;
+        tasks[i].compare = compare;
+    }
+    threadPoolRun(pool, sortTask, tasks, sizeof(ListTask), task_count);
+
+    while (task_count > 1) { // merge the chunks in pairs, until one is left
+        for (int i = 0; i < task_count / 2; i++) {
+            tasks[i].first = tasks[2 * i].first;
+            tasks[i].second = tasks[2 * i + 1].first;
+        }
+        threadPoolRun(pool, mergeTask, tasks, sizeof(ListTask), task_count / 2);
+        if (task_count % 2 == 1) {
+            tasks[task_count / 2].first = tasks[task_count - 1].first;
+        }
+        task_count = (task_count + 1) / 2;
+    }
+    if (task_count == 1)
+        list->head = tasks[0].first;
+    free(tasks);
+    relinkPrevious(list);
+
+    return LIST_SUCCESS;
+}
+
+/**
+* Splits a list which is not empty into consecutive chunks of about the same number of elements,
+* enough of them to keep all of the pool's threads busy. Returns NULL if the allocation failed.
+*/
+static ListTask* splitTasks(List list, ThreadPool pool, int* task_count)
+{
+    int count = threadPoolGetThreadCount(pool) * PARALLEL_TASKS_PER_THREAD;
+    int max_count = (list->size + MIN_PARALLEL_TASK_SIZE - 1) / MIN_PARALLEL_TASK_SIZE;
+    if (count > max_count)
+        count = max_count;
+
+    ListTask* tasks = (ListTask*)malloc(count * sizeof(ListTask));
+    if (tasks == NULL)
+        return NULL;
+    Node* ptr = list->head;
+    for (int i = 0; i < count; i++) {
+        tasks[i].first = ptr;
+        tasks[i].count = list->size / count + (i < list->size % count);
+        for (int j = 0; j < tasks[i].count; j++, ptr = ptr->next);
+    }
+    *task_count = count;
+
+    return tasks;
+}
+
+static void applyTask(void* task)
+{
+    ListTask* list_task = (ListTask*)task;
+    Node* ptr = list_task->first;
+    for (int i = 0; i < list_task->count; ptr->data = list_task->function(ptr->data), ptr = ptr->next, i++);
+}
+
+static void filterTask(void* task)
+{
+    ListTask* list_task = (ListTask*)task;
+    Node* ptr = list_task->first;
+    for (int i = 0; i < list_task->count; ptr = ptr->next, i++) {
+        list_task->passed[i] = list_task->condition(ptr->data, list_task->param);
+    }
+}
+
+/**
+* Sets the prev links and the tail of a list whose nodes were relinked by their next links alone.
+*/
+static void relinkPrevious(List list)
+{
+    Node* prev = NULL;
+    for (Node* ptr = list->head; ptr != NULL; prev = ptr, ptr = ptr->next) {
+        ptr->prev = prev;
+    }
+    list->tail = prev;
+}
+
+static void sortTask(void* task)
+{
+    ListTask* list_task = (ListTask*)task;
+    list_task->first = sortNodes(list_task->first, list_task->compare);
+}
+
+static void mergeTask(void* task)
+{
+    ListTask* list_task = (ListTask*)task;
+    list_task->first = mergeNodes(list_task->first, list_task->second, list_task->compare);
+}
+
+/**
+* Sorts a NULL-terminated chain of nodes with a bottom-up merge sort, and returns its new head.
+* The nodes are taken one at a time, and bins[i] holds a sorted run of 2^i of them (or NULL):
+* a new node is merged with the runs of bins 0, 1, ... until it finds an empty bin, like adding 1
+* to a binary counter. So most merges are of small runs of recently visited nodes, which stay
+* in the cache, and the runs are relinked in place without any memory but the bins.
+*/
+static Node* sortNodes(Node* head, ElemCompareFunction compare)
+{
+    Node* bins[SORT_BINS] = { NULL }; // the runs of higher bins come earlier in the list
+    while (head != NULL) {
+        Node* run = head;
+        head = head->next;
+        run->next = NULL;
+        int i = 0;
+        for (; i < SORT_BINS - 1 && bins[i] != NULL; i++) {
+            run = mergeNodes(bins[i], run, compare);
+            bins[i] = NULL;
+        }
+        bins[i] = run;
+    }
+
+    Node* sorted = NULL;
+    for (int i = 0; i < SORT_BINS; i++) {
+        if (bins[i] != NULL)
+            sorted = mergeNodes(bins[i], sorted, compare);
+    }
+    return sorted;
+}
+
+/**
+* Merges two sorted NULL-terminated chains of nodes into one, and returns its head.
+* A node is taken from second only if it is smaller, so equal elements of first come before
+* those of second, and the sort is stable.
+*/
+static Node* mergeNodes(Node* first, Node* second, ElemCompareFunction compare)
+{
+    Node head;
+    Node* tail = &head;
+    while (first != NULL && second != NULL) {
+        if (compare(first->data, second->data) <= 0) {
+            tail->next = first;
+            first = first->next;
+        }
+        else {
+            tail->next = second;
+            second = second->next;
+        }
+        tail = tail->next;
+    }
+    tail->next = (first != NULL ? first : second);
+    return head.next;
+}
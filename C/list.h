@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 
+#include "thread_pool.h"
+
 typedef void* Element;
 typedef Element (*ElemCopyFunction)(Element);
 typedef void (*ElemFreeFunction)(Element);
@@ -16,7 +18,8 @@ typedef enum {
     LIST_SUCCESS,
     LIST_OUT_OF_MEMORY,
     LIST_NULL_ARG,
-    LIST_INVALID_CURRENT
+    LIST_INVALID_CURRENT,
+    LIST_INCOMPATIBLE_LISTS
 } ListResult;
 
 List listCreate(ElemCopyFunction, ElemFreeFunction);
@@ -24,18 +27,33 @@ List listCopy(List list);
 void listDestroy(List list);
 Element listGetFirst(List list); // returns NULL if list is empty
 Element listGetNext(List list); // returns NULL if no more elements
+Element listGetLast(List list); // returns NULL if list is empty
+Element listGetPrevious(List list); // returns NULL if no more elements
 Element listGetCurrent(List list);
 ListResult listInsertFirst(List list, Element element);
 ListResult listInsertLast(List list, Element element);
+ListResult listInsertLastTake(List list, Element element); // takes ownership of element, no copy
 ListResult listInsertBeforeCurrent(List list, Element element);
 ListResult listInsertAfterCurrent(List list, Element element);
 ListResult listRemoveCurrent(List list);
 void listClear(List list);
 int listGetSize(List list);
 bool listIsEmpty(List list);
-ListResult listSort(List list, ElemCompareFunction compare);
+// These move nodes between lists without copying or freeing the elements, so both lists must have the same
+// copy and free functions (otherwise LIST_INCOMPATIBLE_LISTS), and the source list is left empty
+ListResult listConcat(List destination, List source); // O(1), appends source's elements to destination
+ListResult listSplice(List destination, List source); // O(1), inserts source's elements after destination's current element
+ListResult listMoveCurrentTo(List list, List destination); // O(1), moves the current element to the end of destination
+ListResult listMergeSorted(List destination, List source, ElemCompareFunction compare); // O(n + m), both must be sorted
+List listSplitAtCurrent(List list); // moves the elements from the current one to the end into a new list, in O(min(k, n - k))
+ListResult listSort(List list, ElemCompareFunction compare); // stable, O(n log n), relinks the nodes without copies
 ListResult listApply(List list, ElemApplyFunction function);
 List listFilter(List list, ElemConditionFunction condition, void* param);
+// The parallel versions split the list into chunks which the pool's threads run at once, so function and condition
+// must be safe to call from many threads (the elements which pass are still copied by the calling thread, in order)
+ListResult listApplyParallel(List list, ElemApplyFunction function, ThreadPool pool);
+List listFilterParallel(List list, ElemConditionFunction condition, void* param, ThreadPool pool);
+ListResult listSortParallel(List list, ElemCompareFunction compare, ThreadPool pool); // sorts chunks at once, then merges them
 
 // Macro to enable simple iteration
 #define LIST_FOREACH(Type, element, list) \
@@ -43,4 +61,10 @@ List listFilter(List list, ElemConditionFunction condition, void* param);
         element != NULL; \
         element = listGetNext(list))
 
+// Macro to iterate from the last element to the first
+#define LIST_FOREACH_REVERSE(Type, element, list) \
+    for (Type element = listGetLast(list); \
+        element != NULL; \
+        element = listGetPrevious(list))
+
 #endif /* LIST_H_ */ 
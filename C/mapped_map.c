@@ -0,0 +1,363 @@
+#define _POSIX_C_SOURCE 200112L // for mmap
+
+#include "mapped_map.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define NULL_MAP_SIZE -1
+
+/**
+* The layout of a map file, where every part starts at a multiple of FILE_ALIGNMENT:
+*   FileHeader
+*   FileEntry[count] - the offsets and sizes of the pairs, in ascending order of their keys
+*   the bytes of the elements, key then data, pair after pair in the same order
+* The index comes before the elements, so both are written in a single pass over the map
+* (the offsets of the elements are computed from their sizes in an earlier pass).
+* FILE_VERSION must change whenever the layout does.
+*/
+#define FILE_MAGIC "CMAPFILE"
+#define FILE_VERSION 1
+#define BYTE_ORDER_MARK 0x01020304 // reads differently on a machine of another byte order
+#define FILE_ALIGNMENT 16
+#define TEMPORARY_SUFFIX ".tmp" // the file is written next to its path, and renamed over it when it is complete
+#define ALIGN_UP(size) (((size) + FILE_ALIGNMENT - 1) / FILE_ALIGNMENT * FILE_ALIGNMENT)
+
+typedef struct file_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t count;
+    uint64_t file_size;
+} FileHeader;
+
+typedef struct file_entry_t {
+    uint64_t key_offset;
+    uint64_t key_size;
+    uint64_t data_offset;
+    uint64_t data_size;
+} FileEntry;
+
+static bool writeFile(Map map, FILE* file, sizeMapElements sizeKeyElement, sizeMapElements sizeDataElement);
+static bool syncDirectory(const char* path);
+static bool writePadding(FILE* file, uint64_t size);
+static bool writeIndex(Map map, FILE* file, sizeMapElements sizeKeyElement,
+                       sizeMapElements sizeDataElement, uint64_t* file_size);
+static bool writeElements(Map map, FILE* file, sizeMapElements sizeKeyElement, sizeMapElements sizeDataElement);
+static bool isValidHeader(const FileHeader* header, size_t mapped_size);
+static void* elementAt(MappedMap map, uint64_t offset, uint64_t size);
+static MapKeyElement keyAt(MappedMap map, int index);
+static MapDataElement dataAt(MappedMap map, int index);
+static int lowerBound(MappedMap map, MapKeyElement keyElement);
+
+struct mapped_map_t {
+    unsigned char* bytes; // the whole mapped file
+    size_t mapped_size;
+    const FileEntry* entries;
+    int size;
+    compareMapKeyElements compareKeyElements;
+};
+
+MapResult mapSaveToFile(Map map, const char* path, sizeMapElements sizeKeyElement, sizeMapElements sizeDataElement)
+{
+    if (map == NULL || path == NULL || sizeKeyElement == NULL || sizeDataElement == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+    size_t path_length = strlen(path);
+    char* temporary_path = (char*)malloc(path_length + sizeof(TEMPORARY_SUFFIX));
+    if (temporary_path == NULL) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    memcpy(temporary_path, path, path_length);
+    memcpy(temporary_path + path_length, TEMPORARY_SUFFIX, sizeof(TEMPORARY_SUFFIX));
+
+    // a crash or a failed write leaves the old file at path as it was, and only the temporary file incomplete
+    FILE* file = fopen(temporary_path, "wb");
+    bool written = (file != NULL && writeFile(map, file, sizeKeyElement, sizeDataElement));
+    if (file != NULL && fclose(file) != 0) {
+        written = false;
+    }
+    written = written && rename(temporary_path, path) == 0;
+    if (!written && file != NULL) {
+        remove(temporary_path);
+    }
+    free(temporary_path);
+    written = written && syncDirectory(path); // or the rename may not survive a crash
+
+    return (written ? MAP_SUCCESS : MAP_FILE_ERROR);
+}
+
+/**
+* Writes the whole map file, and makes sure that it reached the disk.
+*/
+static bool writeFile(Map map, FILE* file, sizeMapElements sizeKeyElement, sizeMapElements sizeDataElement)
+{
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+    header.version = FILE_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.count = (uint64_t)mapGetSize(map);
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   writePadding(file, ALIGN_UP(sizeof(header)) - sizeof(header)) &&
+                   writeIndex(map, file, sizeKeyElement, sizeDataElement, &header.file_size) &&
+                   writeElements(map, file, sizeKeyElement, sizeDataElement) &&
+                   fseek(file, 0, SEEK_SET) == 0 && // the file's size is only known now
+                   fwrite(&header, sizeof(header), 1, file) == 1;
+
+    return written && fflush(file) == 0 && fsync(fileno(file)) == 0;
+}
+
+/**
+* Makes sure that a rename into the directory of path reached the disk.
+*/
+static bool syncDirectory(const char* path)
+{
+    const char* slash = strrchr(path, '/');
+    char* directory = (slash == NULL ? NULL : (char*)malloc(slash - path + 2));
+    if (slash != NULL && directory == NULL) {
+        return false;
+    }
+    if (directory != NULL) {
+        size_t length = (slash == path ? 1 : (size_t)(slash - path)); // keep the root's slash
+        memcpy(directory, path, length);
+        directory[length] = '\0';
+    }
+
+    int descriptor = open(directory == NULL ? "." : directory, O_RDONLY);
+    free(directory);
+    if (descriptor < 0) {
+        return false;
+    }
+    bool synced = (fsync(descriptor) == 0);
+    close(descriptor);
+    return synced;
+}
+
+MappedMap mapOpenMapped(const char* path, compareMapKeyElements compareKeyElements)
+{
+    if (path == NULL || compareKeyElements == NULL) {
+        return NULL;
+    }
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0) {
+        return NULL;
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size < (off_t)sizeof(FileHeader)) {
+        close(descriptor);
+        return NULL;
+    }
+
+    size_t mapped_size = (size_t)status.st_size;
+    void* bytes = mmap(NULL, mapped_size, PROT_READ, MAP_SHARED, descriptor, 0);
+    close(descriptor); // the mapping stays after the descriptor is closed
+    if (bytes == MAP_FAILED) {
+        return NULL;
+    }
+    if (!isValidHeader((const FileHeader*)bytes, mapped_size)) {
+        munmap(bytes, mapped_size);
+        return NULL;
+    }
+
+    MappedMap map = (MappedMap)malloc(sizeof(*map));
+    if (map == NULL) {
+        munmap(bytes, mapped_size);
+        return NULL;
+    }
+    map->bytes = (unsigned char*)bytes;
+    map->mapped_size = mapped_size;
+    map->entries = (const FileEntry*)(map->bytes + ALIGN_UP(sizeof(FileHeader)));
+    map->size = (int)((const FileHeader*)bytes)->count;
+    map->compareKeyElements = compareKeyElements;
+
+    return map;
+}
+
+void mappedMapClose(MappedMap map)
+{
+    if (map == NULL) {
+        return;
+    }
+    munmap(map->bytes, map->mapped_size);
+    free(map);
+}
+
+int mappedMapGetSize(MappedMap map)
+{
+    if (map == NULL) {
+        return NULL_MAP_SIZE;
+    }
+    return map->size;
+}
+
+bool mappedMapContains(MappedMap map, MapKeyElement element)
+{
+    return mappedMapGet(map, element) != NULL;
+}
+
+MapDataElement mappedMapGet(MappedMap map, MapKeyElement keyElement)
+{
+    if (map == NULL || keyElement == NULL) {
+        return NULL;
+    }
+    int index = lowerBound(map, keyElement);
+    MapKeyElement key = keyAt(map, index);
+    if (key == NULL || map->compareKeyElements(key, keyElement) != 0) {
+        return NULL;
+    }
+    return dataAt(map, index);
+}
+
+MapResult mappedMapForEach(MappedMap map, visitMapElements visit, void* context)
+{
+    return mappedMapRangeForEach(map, NULL, NULL, visit, context);
+}
+
+MapResult mappedMapRangeForEach(MappedMap map, MapKeyElement low, MapKeyElement high,
+                                visitMapElements visit, void* context)
+{
+    if (map == NULL || visit == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    for (int index = (low == NULL ? 0 : lowerBound(map, low)); index < map->size; index++) {
+        MapKeyElement key = keyAt(map, index);
+        MapDataElement data = dataAt(map, index);
+        if (key == NULL || data == NULL) { // a damaged entry ends the scan
+            break;
+        }
+        if (high != NULL && map->compareKeyElements(key, high) >= 0) {
+            break;
+        }
+        if (!visit(key, data, context)) {
+            break;
+        }
+    }
+
+    return MAP_SUCCESS;
+}
+
+// ============================ WRITING ============================ //
+
+static bool writePadding(FILE* file, uint64_t size)
+{
+    static const unsigned char zeros[FILE_ALIGNMENT] = { 0 };
+    return size == 0 || fwrite(zeros, 1, size, file) == size;
+}
+
+/**
+* Writes the index of the pairs, and sets file_size to the size the whole file will have
+* once the elements are written after it.
+*/
+static bool writeIndex(Map map, FILE* file, sizeMapElements sizeKeyElement,
+                       sizeMapElements sizeDataElement, uint64_t* file_size)
+{
+    uint64_t offset = ALIGN_UP(sizeof(FileHeader)) + ALIGN_UP((uint64_t)mapGetSize(map) * sizeof(FileEntry));
+    MapCursor cursor;
+    for (bool valid = mapCursorFirst(map, &cursor); valid; valid = mapCursorNext(&cursor)) {
+        FileEntry entry;
+        entry.key_offset = offset;
+        entry.key_size = sizeKeyElement(mapCursorGetKey(&cursor));
+        entry.data_offset = ALIGN_UP(entry.key_offset + entry.key_size);
+        entry.data_size = sizeDataElement(mapCursorGetData(&cursor));
+        offset = ALIGN_UP(entry.data_offset + entry.data_size);
+        if (fwrite(&entry, sizeof(entry), 1, file) != 1) {
+            return false;
+        }
+    }
+    *file_size = offset;
+
+    uint64_t index_size = (uint64_t)mapGetSize(map) * sizeof(FileEntry);
+    return writePadding(file, ALIGN_UP(index_size) - index_size);
+}
+
+static bool writeElements(Map map, FILE* file, sizeMapElements sizeKeyElement, sizeMapElements sizeDataElement)
+{
+    MapCursor cursor;
+    for (bool valid = mapCursorFirst(map, &cursor); valid; valid = mapCursorNext(&cursor)) {
+        MapKeyElement key = mapCursorGetKey(&cursor);
+        MapDataElement data = mapCursorGetData(&cursor);
+        size_t key_size = sizeKeyElement(key);
+        size_t data_size = sizeDataElement(data);
+        if (fwrite(key, 1, key_size, file) != key_size ||
+            !writePadding(file, ALIGN_UP(key_size) - key_size) ||
+            fwrite(data, 1, data_size, file) != data_size ||
+            !writePadding(file, ALIGN_UP(data_size) - data_size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ============================ READING ============================ //
+
+/**
+* Checks the header of a mapped file, and that the whole index is inside the file.
+* The entries themselves are only checked when they are read, so opening the file
+* does not touch any page of the index.
+*/
+static bool isValidHeader(const FileHeader* header, size_t mapped_size)
+{
+    if (memcmp(header->magic, FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != FILE_VERSION || header->byte_order != BYTE_ORDER_MARK ||
+        header->file_size != mapped_size || header->count > INT_MAX) {
+        return false;
+    }
+    uint64_t index_end = ALIGN_UP(sizeof(FileHeader)) + header->count * sizeof(FileEntry);
+    return index_end <= mapped_size;
+}
+
+/**
+* Returns the element at the given offset of the file, or NULL if it does not fit in the file.
+*/
+static void* elementAt(MappedMap map, uint64_t offset, uint64_t size)
+{
+    if (offset > map->mapped_size || size > map->mapped_size - offset) {
+        return NULL;
+    }
+    return map->bytes + offset;
+}
+
+static MapKeyElement keyAt(MappedMap map, int index)
+{
+    if (index >= map->size) {
+        return NULL;
+    }
+    return elementAt(map, map->entries[index].key_offset, map->entries[index].key_size);
+}
+
+static MapDataElement dataAt(MappedMap map, int index)
+{
+    return elementAt(map, map->entries[index].data_offset, map->entries[index].data_size);
+}
+
+/**
+* Returns the index of the first key which is not smaller than the given key (size if there is none).
+* A damaged entry is treated as greater than every key.
+*/
+static int lowerBound(MappedMap map, MapKeyElement keyElement)
+{
+    int low = 0;
+    int high = map->size;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        MapKeyElement key = keyAt(map, middle);
+        if (key != NULL && map->compareKeyElements(key, keyElement) < 0) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low;
+}
@@ -0,0 +1,150 @@
+#ifndef MAPPED_MAP_H_
+#define MAPPED_MAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ordered_map.h"
+
+/**
+* A Generic Read-Only Ordered-Map Stored in a File (ADT)
+*
+* mapSaveToFile writes the pairs of a Map to a file, in order, and mapOpenMapped maps
+* that file into memory and searches it in place: nothing is read or rebuilt when the file
+* is opened, and the operating system only loads the pages a lookup actually touches.
+* So a map of any size is opened in constant time, and its first lookups get faster as
+* its hot pages are loaded.
+*
+* Only flat elements can be saved: elements whose bytes are all of their content
+* (no pointers), such as numbers, fixed-size structs or strings. The size of each element
+* is given by the user, and the elements which are passed to the functions of a mapped map
+* point at the bytes in the file, aligned to 16 bytes.
+*
+* The file starts with a header (a magic string, the format version and the byte order),
+* followed by an index of the pairs' offsets in ascending order of their keys, and then
+* by the elements themselves. A file is opened only on a machine with the same byte order that saved it.
+*
+* The ADT provides the following methods:
+*   mapSaveToFile
+*   mapOpenMapped
+*   mappedMapClose
+*   mappedMapGetSize
+*   mappedMapContains
+*   mappedMapGet
+*   mappedMapForEach
+*   mappedMapRangeForEach
+*
+*   NOTE: the elements of a mapped map are only valid until it is closed,
+*         and the file must not be modified while it is open.
+*
+*   NOTE: a mapped map is never modified, so any number of threads may read it at once.
+*/
+
+// ============================ TYPEDEFS ============================ //
+typedef struct mapped_map_t * MappedMap;
+
+
+// ============================ FUNCTIONS ============================ //
+/**
+* mapSaveToFile: Writes the pairs of a map to a file which can be opened by mapOpenMapped.
+* The file is first written as path with ".tmp" appended, flushed to the disk, and only then
+* renamed over path, so path always holds either the old file or the whole new one, even if the
+* process crashes or a write fails. A mapped map which is open on the old file keeps reading it.
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to save.
+* @param path - The path of the file.
+* @param sizeKeyElement - A Function pointer which returns the size of a key element.
+* @param sizeDataElement - A Function pointer which returns the size of a data element.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as one of the parameters.
+* 	MAP_OUT_OF_MEMORY if an allocation failed.
+* 	MAP_FILE_ERROR if the file could not be written (then the file at path is left as it was).
+* 	MAP_SUCCESS if the map was saved successfully.
+*/
+MapResult mapSaveToFile(Map map, const char* path, sizeMapElements sizeKeyElement, sizeMapElements sizeDataElement);
+
+/**
+* mapOpenMapped: Maps a file which was written by mapSaveToFile into memory.
+* Only the header is read, so this takes the same time whatever the size of the map is.
+*
+* @param path - The path of the file.
+* @param compareKeyElements - A Function pointer for comparing key elements, which must order
+*                             the keys the same way as the compare function of the saved map.
+* @return
+* 	NULL if a NULL was sent, the file could not be mapped, or it is not a valid map file
+* 	(of this version and byte order).
+* 	Otherwise, a new MappedMap.
+*/
+MappedMap mapOpenMapped(const char* path, compareMapKeyElements compareKeyElements);
+
+/**
+* mappedMapClose: Unmaps a mapped map and deallocates it.
+*
+* @param map - Map to be closed. If map is NULL nothing will be done.
+*/
+void mappedMapClose(MappedMap map);
+
+/**
+* mappedMapGetSize: Returns the number of pairs in a mapped map.
+*
+* @param map - The map which size is requested.
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of pairs in the map.
+*/
+int mappedMapGetSize(MappedMap map);
+
+/**
+* mappedMapContains: Checks if a key element exists in the mapped map.
+*
+* @param map - The map to search in.
+* @param element - The element to look for. Will be compared using the comparison function.
+* @return
+* 	false - if one or more of the inputs is null, or if the key element was not found.
+* 	true - if the key element was found in the map.
+*/
+bool mappedMapContains(MappedMap map, MapKeyElement element);
+
+/**
+* mappedMapGet: Returns the data associated with a specific key in the mapped map.
+* Takes O(log n) comparisons, and reads only the pages of the keys it compares.
+*
+* @param map - The map for which to get the data element from.
+* @param keyElement - The key element which need to be found and whos data we want to get.
+* @return
+* 	NULL if a NULL pointer was sent or if the map does not contain the requested key.
+* 	Otherwise, a pointer to the data element's bytes in the file (not a copy!).
+*/
+MapDataElement mappedMapGet(MappedMap map, MapKeyElement keyElement);
+
+/**
+* mappedMapForEach: Calls a function on every pair in the mapped map, in order, until it returns false.
+* The elements are passed as they are in the file, and must not be modified.
+*
+* @param map - The map to iterate over.
+* @param visit - The function to call on each pair.
+* @param context - A parameter passed as is to every call of visit.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or visit.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult mappedMapForEach(MappedMap map, visitMapElements visit, void* context);
+
+/**
+* mappedMapRangeForEach: Calls a function on every pair whose key is in [low, high), in order,
+* until it returns false. The first pair is found in O(log n) comparisons.
+*
+* @param map - The map to iterate over.
+* @param low - The smallest key to visit, or NULL to start from the first key.
+* @param high - The key to stop before, or NULL to go on to the last key.
+* @param visit - The function to call on each pair.
+* @param context - A parameter passed as is to every call of visit.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or visit.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult mappedMapRangeForEach(MappedMap map, MapKeyElement low, MapKeyElement high,
+                                visitMapElements visit, void* context);
+
+#endif
@@ -1,29 +1,184 @@
 #include "ordered_map.h"
+#include "intern_pool.h"
+#include "bloom_filter.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
 
 #define NULL_MAP_SIZE -1
 
+/**
+* The map is stored as a B-tree of wide nodes: every node holds up to MAX_KEYS sorted
+* key-data pairs, and an internal node holding n pairs has n+1 children.
+* Every node except the root holds at least MIN_KEYS pairs, so the tree stays a few levels
+* deep even for millions of keys, and each operation costs O(log n) comparisons.
+*/
+#define MIN_DEGREE 16
+#define MAX_KEYS (2 * MIN_DEGREE - 1)
+#define MIN_KEYS (MIN_DEGREE - 1)
+#define MAX_TREE_HEIGHT 32
+
+/**
+* The pairs of a node are stored in slots right after the node's header (and children):
+* first all of the key slots, then all of the data slots. A slot holds a pointer to a copied
+* element, or in an inline map the element's bytes themselves.
+*/
+#define SLOT_ALIGNMENT 16
+#define ALIGN_UP(size) (((size) + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT)
+#define LEAF_HEADER_SIZE ALIGN_UP(sizeof(Node))
+#define INTERNAL_HEADER_SIZE ALIGN_UP(sizeof(Node) + (NODE_SLOTS + 1) * sizeof(Node*))
+#define NODE_SLOTS (MAX_KEYS + 1) // one spare slot, so a node can overflow right before it is split
+
+#define INSERTION_SORT_SIZE 16
+#define PARALLEL_SORT_SIZE 65536 // arrays smaller than this are not worth another thread
+#define PARALLEL_SORT_DEPTH 3    // sort with up to 2^depth threads
+
+#define CACHE_LINE_SIZE 64
+#define MAX_PREFETCH_LINES 16
+#define BATCH_PREFETCH_DISTANCE 4 // a batch search prefetches the node of the group this many groups ahead
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address)
+#endif
+
 typedef struct node_t {
-    MapDataElement data;
-    MapKeyElement key;
-    struct node_t* next;
+    int count;
+    int size; // the number of pairs in the subtree rooted at this node
+    bool is_leaf;
+    struct node_t* parent;
+    struct node_t* children[]; // NODE_SLOTS + 1 of them in an internal node, none in a leaf
 } Node;
 
-static void removeNodeElement(Map map, Node* node);
-static bool addNewElement(Map map, MapKeyElement keyElement, MapDataElement dataElement);
-static bool updateExistingElement(Map map, MapKeyElement keyElement, MapDataElement dataElement);
+typedef struct position_t {
+    Node* node;
+    int index;
+} Position;
+
+typedef struct entry_t {
+    MapKeyElement key;
+    MapDataElement data;
+} Entry;
+
+typedef struct sort_task_t {
+    Entry* entries;
+    Entry* buffer;
+    int size;
+    compareMapKeyElements compare;
+    int depth;
+} SortTask;
+
+/**
+* The path of the last search of a batch, from the root (level 0) down to where it ended.
+* bound[level] is the smallest key which is greater than the whole subtree of path[level]
+* (NULL if there is none), so the next, greater key of the batch only climbs up the path
+* until it is below the bound, instead of starting over from the root.
+*/
+typedef struct finger_t {
+    int depth; // the level where the last search ended, or -1 before the first search
+    Node* path[MAX_TREE_HEIGHT];
+    int index[MAX_TREE_HEIGHT]; // the index taken in each node of the path
+    MapKeyElement bound[MAX_TREE_HEIGHT];
+} Finger;
+
+/**
+* The keys of a batch which a batch search takes down to node: the keys whose indices are
+* in order[first..end) of the search's current level.
+*/
+typedef struct batch_group_t {
+    Node* node;
+    int first;
+    int end;
+} BatchGroup;
+
+static Map createMap(size_t keySize, size_t dataSize, compareMapKeyElements compareKeyElements);
+static Node* createNode(Map map, bool is_leaf);
+static void destroyNode(Map map, Node* node);
+static void freeEntries(Map map, Node* node);
+static void freeNodes(Node* node);
+static Node* cloneNode(Map map, Node* source);
+static Node* buildNode(Map map, Entry* entries, int size, int height);
+static int treeHeight(int size);
+static bool replaceTree(Map map, Entry* entries, int size);
+static Map createEmptyCopy(Map map);
+static bool isMergeable(Map map1, Map map2);
+static bool duplicateEntry(Map map, Entry* entry);
+static void freeEntry(Map map, Entry* entry);
+static MapResult mergeByPutting(Map destination, Map source, MapMergePolicy policy);
+static Map filterByKeys(Map map, Map keys, bool common);
+static void sortEntries(Entry* entries, Entry* buffer, int size, compareMapKeyElements compare, int depth);
+static void* sortEntriesTask(void* task);
+static int removeDuplicates(Entry* entries, int size, compareMapKeyElements compare);
+static bool isSorted(Entry* entries, int size, compareMapKeyElements compare);
+static int childIndex(Node* parent, Node* child);
+static int findIndex(Map map, Node* node, MapKeyElement keyElement, bool* found);
+static int findIndexBetween(Map map, Node* node, int low, int high, MapKeyElement keyElement, bool* found);
+static int gallopIndex(Map map, Node* node, int start, MapKeyElement keyElement, bool* found);
+static bool sortBatch(Map map, Entry* entries, int size);
+static bool resolveBatch(Map map, MapKeyElement* keyElements, int size, Position* positions);
+static bool searchBatch(Map map, MapKeyElement* keyElements, int size, const bool* mayContain, Position* positions);
+static bool fingerSearch(Map map, Finger* finger, MapKeyElement keyElement, Position* position);
+static void fingerAt(Map map, Finger* finger, Position position);
+static void prefetchNode(Map map, Node* node);
+static void prefetchKeys(Map map, Node* node);
+static bool findPosition(Map map, MapKeyElement keyElement, Position* position);
+static bool findKey(Map map, MapKeyElement keyElement, Position* position);
+static void filterKey(Map map, MapKeyElement keyElement);
+static void refillFilter(Map map);
+static int findUpperIndex(Map map, Node* node, MapKeyElement keyElement);
+static bool findBound(Map map, MapKeyElement keyElement, bool upper, Position* position);
+static void removeAndAdvance(Map map, Position* position);
+static bool positionFirst(Map map, Position* position);
+static bool positionLast(Map map, Position* position);
+static bool positionNext(Position* position);
+static bool positionPrevious(Position* position);
+static void* keySlot(Map map, Node* node, int index);
+static void* dataSlot(Map map, Node* node, int index);
+static MapKeyElement getKey(Map map, Node* node, int index);
+static MapDataElement getData(Map map, Node* node, int index);
+static void setEntry(Map map, Node* node, int index, MapKeyElement keyElement, MapDataElement dataElement);
+static void copyEntry(Map map, Node* destination, int to, Node* source, int from);
+static void moveEntries(Map map, Node* destination, int to, Node* source, int from, int count);
+static void freeElements(Map map, Node* node, int index);
+static void insertGap(Map map, Node* node, int index);
+static void removeEntry(Map map, Node* node, int index);
+static bool insertElement(Map map, Position* position, MapKeyElement keyElement, MapDataElement dataElement);
+static void splitNode(Map map, Node* node, Node* right);
+static bool removeElement(Map map, Position position);
+static bool rebalance(Map map, Node* node);
+static void rotateLeft(Map map, Node* parent, int index);
+static void rotateRight(Map map, Node* parent, int index);
+static void mergeChildren(Map map, Node* parent, int index);
+static bool hintPosition(Map map, MapCursor* hint, MapKeyElement keyElement, Position* position, bool* found);
+static void setCursor(Map map, MapCursor* cursor, Position position);
+static bool cursorPosition(MapCursor* cursor, Position* position);
+static MapResult putElement(Map map, Position* position, bool found,
+                            MapKeyElement keyElement, MapDataElement dataElement);
+static MapKeyElement copyKey(Map map, MapKeyElement keyElement);
+static void freeKey(Map map, MapKeyElement keyElement);
+static int compareInternedKeys(MapKeyElement keyElement1, MapKeyElement keyElement2);
 
 struct ordered_map_t {
-    Node* head;
-    Node* iterator;
+    Node* root;
+    Position iterator;
     int size;
+    unsigned long version; // changes whenever pairs are added or removed, to detect invalidated cursors
     copyMapDataElements copyDataElement;
     copyMapKeyElements copyKeyElement;
     freeMapDataElements freeDataElement;
     freeMapKeyElements freeKeyElement;
     compareMapKeyElements compareKeyElements;
+    bool is_inline;    // the elements are stored by value in the nodes, without copy and free functions
+    size_t keySize;    // the size of a key slot
+    size_t dataSize;   // the size of a data slot
+    size_t dataOffset; // where the data slots start, after all of the key slots
+    MapKeyElement keyBuffer; // room for one key of an inline map, which is about to be moved
+    InternPool pool; // if not NULL, the keys are strings of this pool, and are never copied or freed
+    BloomFilter filter; // if not NULL, it has the hashes of all of the keys (and maybe of removed ones)
+    hashMapKeyElements hashKeyElement;
 };
 
 Map mapCreate(copyMapDataElements copyDataElement,
@@ -34,20 +189,79 @@ Map mapCreate(copyMapDataElements copyDataElement,
 {
     if(copyDataElement == NULL || copyKeyElement == NULL ||
        freeDataElement == NULL || freeKeyElement == NULL || compareKeyElements == NULL ) {
-        return NULL; 
+        return NULL;
     }
-    Map map = (Map)malloc(sizeof(*map));
+    Map map = createMap(sizeof(MapKeyElement), sizeof(MapDataElement), compareKeyElements);
     if(map == NULL) {
         return NULL;
     }
-    map->size = 0;
-    map->head = NULL; 
-    map->iterator = NULL;
     map->copyDataElement = copyDataElement;
     map->copyKeyElement = copyKeyElement;
     map->freeDataElement = freeDataElement;
     map->freeKeyElement = freeKeyElement;
+
+    return map;
+}
+
+Map mapCreateInline(size_t keySize, size_t dataSize, compareMapKeyElements compareKeyElements)
+{
+    if (keySize == 0 || dataSize == 0 || compareKeyElements == NULL) {
+        return NULL;
+    }
+    Map map = createMap(keySize, dataSize, compareKeyElements);
+    if (map == NULL) {
+        return NULL;
+    }
+    map->keyBuffer = malloc(keySize);
+    if (map->keyBuffer == NULL) {
+        free(map);
+        return NULL;
+    }
+    map->is_inline = true;
+
+    return map;
+}
+
+Map mapCreateInterned(InternPool pool, copyMapDataElements copyDataElement, freeMapDataElements freeDataElement)
+{
+    if (pool == NULL || copyDataElement == NULL || freeDataElement == NULL) {
+        return NULL;
+    }
+    Map map = createMap(sizeof(MapKeyElement), sizeof(MapDataElement), compareInternedKeys);
+    if (map == NULL) {
+        return NULL;
+    }
+    map->copyDataElement = copyDataElement;
+    map->freeDataElement = freeDataElement;
+    map->pool = pool;
+
+    return map;
+}
+
+static Map createMap(size_t keySize, size_t dataSize, compareMapKeyElements compareKeyElements)
+{
+    Map map = (Map)malloc(sizeof(*map));
+    if(map == NULL) {
+        return NULL;
+    }
+    map->size = 0;
+    map->root = NULL;
+    map->iterator.node = NULL;
+    map->iterator.index = 0;
+    map->version = 0;
+    map->copyDataElement = NULL;
+    map->copyKeyElement = NULL;
+    map->freeDataElement = NULL;
+    map->freeKeyElement = NULL;
     map->compareKeyElements = compareKeyElements;
+    map->is_inline = false;
+    map->keySize = keySize;
+    map->dataSize = dataSize;
+    map->dataOffset = ALIGN_UP(NODE_SLOTS * keySize);
+    map->keyBuffer = NULL;
+    map->pool = NULL;
+    map->filter = NULL;
+    map->hashKeyElement = NULL;
 
     return map;
 }
@@ -58,6 +272,8 @@ void mapDestroy(Map map)
         return;
     }
     mapClear(map);
+    free(map->keyBuffer);
+    bloomFilterDestroy(map->filter);
     free(map);
 }
 
@@ -66,30 +282,82 @@ Map mapCopy(Map map)
     if(map == NULL) {
         return NULL;
     }
-    Map new_map = mapCreate(map->copyDataElement, map->copyKeyElement, map->freeDataElement,
-                            map->freeKeyElement, map->compareKeyElements);
+    Map new_map = createEmptyCopy(map);
     if (new_map == NULL) {
         return NULL;
     }
-    new_map->size = 0;
-    Node* ptr = map->head;
-    while (ptr != NULL) {
-        if (mapPut(new_map, ptr->key, ptr->data) != MAP_SUCCESS) {
+    if (map->root != NULL) {
+        new_map->root = cloneNode(map, map->root);
+        if (new_map->root == NULL) {
             mapDestroy(new_map);
             return NULL;
         }
-        ptr = ptr->next;
     }
-    new_map->iterator = NULL;
-    new_map->copyDataElement = map->copyDataElement;
-    new_map->copyKeyElement = map->copyKeyElement;
-    new_map->freeDataElement = map->freeDataElement;
-    new_map->freeKeyElement = map->freeKeyElement;
-    new_map->compareKeyElements = map->compareKeyElements;
+    new_map->size = map->size;
+    refillFilter(new_map);
 
     return new_map;
 }
 
+Map mapCreateFromArrays(MapKeyElement* keyElements, MapDataElement* dataElements, int size,
+                        copyMapDataElements copyDataElement,
+                        copyMapKeyElements copyKeyElement,
+                        freeMapDataElements freeDataElement,
+                        freeMapKeyElements freeKeyElement,
+                        compareMapKeyElements compareKeyElements,
+                        bool sorted)
+{
+    if (keyElements == NULL || dataElements == NULL || size < 0) {
+        return NULL;
+    }
+    for (int i = 0; i < size; i++) {
+        if (keyElements[i] == NULL || dataElements[i] == NULL) {
+            return NULL;
+        }
+    }
+    Map map = mapCreate(copyDataElement, copyKeyElement, freeDataElement, freeKeyElement, compareKeyElements);
+    if (map == NULL || size == 0) {
+        return map;
+    }
+
+    Entry* entries = (Entry*)malloc(size * sizeof(Entry));
+    if (entries == NULL) {
+        mapDestroy(map);
+        return NULL;
+    }
+    for (int i = 0; i < size; i++) {
+        entries[i].key = keyElements[i];
+        entries[i].data = dataElements[i];
+    }
+
+    if (!sorted || !isSorted(entries, size, compareKeyElements)) {
+        Entry* buffer = (Entry*)malloc(size * sizeof(Entry));
+        if (buffer == NULL) {
+            free(entries);
+            mapDestroy(map);
+            return NULL;
+        }
+        sortEntries(entries, buffer, size, compareKeyElements, PARALLEL_SORT_DEPTH);
+        free(buffer);
+    }
+    size = removeDuplicates(entries, size, compareKeyElements);
+
+    int copied = 0;
+    for (; copied < size && duplicateEntry(map, &entries[copied]); copied++);
+
+    if (copied < size || !replaceTree(map, entries, size)) {
+        for (int i = 0; i < copied; i++) {
+            freeEntry(map, &entries[i]);
+        }
+        free(entries);
+        mapDestroy(map);
+        return NULL;
+    }
+
+    free(entries);
+    return map;
+}
+
 int mapGetSize(Map map)
 {
     if (map == NULL) {
@@ -99,19 +367,18 @@ int mapGetSize(Map map)
     return map->size;
 }
 
+compareMapKeyElements mapGetCompareFunction(Map map)
+{
+    return (map == NULL ? NULL : map->compareKeyElements);
+}
+
 bool mapContains(Map map, MapKeyElement element)
 {
     if(map == NULL || element == NULL) {
         return false;
     }
-    Node* ptr = map->head;
-    while(ptr != NULL) {
-        if(!(map->compareKeyElements(ptr->key , element))) {
-            return true;
-        }
-        ptr = ptr->next;
-    }
-    return false;
+    Position position;
+    return findKey(map, element, &position);
 }
 
 MapResult mapPut(Map map, MapKeyElement keyElement, MapDataElement dataElement)
@@ -120,81 +387,188 @@ MapResult mapPut(Map map, MapKeyElement keyElement, MapDataElement dataElement)
         return MAP_NULL_ARGUMENT;
     }
 
-    if (!mapContains(map, keyElement))  {
-        if (!addNewElement(map, keyElement, dataElement)) {
-            return MAP_OUT_OF_MEMORY;
-        }
+    Position position;
+    bool found = findPosition(map, keyElement, &position);
+    return putElement(map, &position, found, keyElement, dataElement);
+}
+
+MapResult mapPutHint(Map map, MapCursor* hint, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    if (map == NULL || hint == NULL || keyElement == NULL || dataElement == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    Position position;
+    bool found;
+    if (!hintPosition(map, hint, keyElement, &position, &found)) {
+        found = findPosition(map, keyElement, &position);
+    }
+    MapResult result = putElement(map, &position, found, keyElement, dataElement);
+    if (result == MAP_SUCCESS) {
+        setCursor(map, hint, position);
+    }
+    return result;
+}
+
+MapResult mapPutTake(Map map, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    if (map == NULL || keyElement == NULL || dataElement == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    Position position;
+    bool found = findPosition(map, keyElement, &position);
+    if (map->is_inline) {
+        return putElement(map, &position, found, keyElement, dataElement);
+    }
+
+    if (found) {
+        map->freeDataElement(getData(map, position.node, position.index));
+        *(MapDataElement*)dataSlot(map, position.node, position.index) = dataElement;
+        freeKey(map, keyElement); // the map already holds an equal key
     }
     else {
-        if (!updateExistingElement(map, keyElement, dataElement)) {
+        MapKeyElement key = (map->pool != NULL ? copyKey(map, keyElement) : keyElement);
+        if (key == NULL || !insertElement(map, &position, key, dataElement)) {
             return MAP_OUT_OF_MEMORY;
         }
     }
+    map->iterator.node = NULL;
 
     return MAP_SUCCESS;
 }
 
-static bool addNewElement(Map map, MapKeyElement keyElement, MapDataElement dataElement)
+MapResult mapPutMany(Map map, MapKeyElement* keyElements, MapDataElement* dataElements, int size)
 {
-    Node* new_node = (Node*)malloc(sizeof(*new_node));
-    if (new_node == NULL) {
-        return false;
+    if (map == NULL || keyElements == NULL || dataElements == NULL || size < 0) {
+        return MAP_NULL_ARGUMENT;
     }
-    
-    new_node->key = map->copyKeyElement(keyElement);
-    if(new_node->key == NULL) {
-        free(new_node);
-        return false;
+    for (int i = 0; i < size; i++) {
+        if (keyElements[i] == NULL || dataElements[i] == NULL) {
+            return MAP_NULL_ARGUMENT;
+        }
+    }
+    if (size == 0) {
+        return MAP_SUCCESS;
     }
 
-    new_node->data = map->copyDataElement(dataElement);
-    if(new_node->data == NULL) {
-        free(new_node->key);
-        free(new_node);
-        return false;
+    Position* positions = (Position*)malloc(size * sizeof(Position));
+    if (positions == NULL || !resolveBatch(map, keyElements, size, positions)) {
+        free(positions);
+        return MAP_OUT_OF_MEMORY;
     }
 
-    Node* ptr = map->head;
-    if (ptr == NULL) { // map was empty, adding its head
-        new_node->next = NULL;
-        map->head = new_node;
-        map->size++;
-        return true;
+    int missing = 0;
+    for (int i = 0; i < size; i++) {
+        missing += (positions[i].node == NULL);
+    }
+    Entry* entries = NULL;
+    if (missing > 0) {
+        entries = (Entry*)malloc(missing * sizeof(Entry));
+        if (entries == NULL) {
+            free(positions);
+            return MAP_OUT_OF_MEMORY;
+        }
     }
-    
-    Node* next = ptr->next;
-    while(next != NULL && map->compareKeyElements(keyElement, next->key) > 0) {
-        ptr = next;
-        next = ptr->next;
-    } // ptr is now the last element whose key's smaller than keyElement
-    
 
-    if (ptr == map->head && map->compareKeyElements(keyElement, ptr->key) < 0) {
-        new_node->next = ptr;
-        map->head = new_node;
+    // replacing the data of the keys which are in the map leaves the tree as it is, so all of
+    // their positions stay valid. The pairs of an equal key are put in their order, and the last one stays.
+    MapResult result = MAP_SUCCESS;
+    missing = 0;
+    for (int i = 0; i < size && result == MAP_SUCCESS; i++) {
+        if (positions[i].node != NULL) {
+            result = putElement(map, &positions[i], true, keyElements[i], dataElements[i]);
+        }
+        else {
+            entries[missing].key = keyElements[i];
+            entries[missing].data = dataElements[i];
+            missing++;
+        }
     }
-    else {
-        ptr->next = new_node;
-        new_node->next = next;
+    free(positions);
+
+    // the new keys are inserted in order, each search starting where the last one ended.
+    // The sort is stable, so the pairs of an equal new key are still put in their order.
+    if (result == MAP_SUCCESS && missing > 0 && !sortBatch(map, entries, missing)) {
+        result = MAP_OUT_OF_MEMORY;
+    }
+    Finger finger;
+    finger.depth = -1;
+    for (int i = 0; i < missing && result == MAP_SUCCESS; i++) {
+        Position position;
+        bool found = fingerSearch(map, &finger, entries[i].key, &position);
+        result = putElement(map, &position, found, entries[i].key, entries[i].data);
+        if (result == MAP_SUCCESS && !found) {
+            fingerAt(map, &finger, position); // the insertion may have split the nodes on the path
+        }
     }
 
-    map->size++;
-    return true;
+    free(entries);
+    return result;
 }
 
-static bool updateExistingElement(Map map, MapKeyElement keyElement, MapDataElement dataElement)
+MapResult mapFind(Map map, MapKeyElement keyElement, MapCursor* cursor)
 {
-    Node* ptr = map->head;
-    while (map->compareKeyElements(keyElement, ptr->key)) {
-        ptr = ptr->next;
+    if (map == NULL || keyElement == NULL || cursor == NULL) {
+        return MAP_NULL_ARGUMENT;
     }
-    MapDataElement data = ptr->data;
-    ptr->data = map->copyDataElement(dataElement);
-    map->freeDataElement(data);
-    if (ptr->data == NULL) {
-        return false;
+
+    Position position = { 0 }; // a miss may leave it untouched (when the filter rules the key out)
+    if (!findKey(map, keyElement, &position)) {
+        position.node = NULL;
+        position.index = 0;
+        setCursor(map, cursor, position);
+        return MAP_ITEM_DOES_NOT_EXIST;
     }
-    return true;
+    setCursor(map, cursor, position);
+    return MAP_SUCCESS;
+}
+
+/**
+* Puts a copy of the pair at the position found by a single search:
+* either over an existing pair with an equal key (found), or into an empty leaf slot.
+* On success, position is moved to where the pair ended up.
+*/
+static MapResult putElement(Map map, Position* position, bool found,
+                            MapKeyElement keyElement, MapDataElement dataElement)
+{
+    if (map->is_inline) {
+        if (found) {
+            memcpy(dataSlot(map, position->node, position->index), dataElement, map->dataSize);
+        }
+        else if (!insertElement(map, position, keyElement, dataElement)) {
+            return MAP_OUT_OF_MEMORY;
+        }
+        map->iterator.node = NULL;
+        return MAP_SUCCESS;
+    }
+
+    MapDataElement data = map->copyDataElement(dataElement);
+    if (data == NULL) {
+        return MAP_OUT_OF_MEMORY;
+    }
+
+    if (found) {
+        map->freeDataElement(getData(map, position->node, position->index));
+        *(MapDataElement*)dataSlot(map, position->node, position->index) = data;
+        map->iterator.node = NULL;
+        return MAP_SUCCESS;
+    }
+
+    MapKeyElement key = copyKey(map, keyElement);
+    if (key == NULL) {
+        map->freeDataElement(data);
+        return MAP_OUT_OF_MEMORY;
+    }
+
+    if (!insertElement(map, position, key, data)) {
+        map->freeDataElement(data);
+        freeKey(map, key);
+        return MAP_OUT_OF_MEMORY;
+    }
+    map->iterator.node = NULL;
+
+    return MAP_SUCCESS;
 }
 
 MapDataElement mapGet(Map map, MapKeyElement keyElement)
@@ -202,34 +576,137 @@ MapDataElement mapGet(Map map, MapKeyElement keyElement)
     if(map == NULL || keyElement == NULL) {
         return NULL;
     }
-    Node* ptr = map->head; 
-    while(ptr != NULL) {
-        if(!(map->compareKeyElements(ptr->key ,keyElement))) {
-            return ptr->data;
+    Position position;
+    if (!findKey(map, keyElement, &position)) {
+        return NULL;
+    }
+    return getData(map, position.node, position.index);
+}
+
+MapResult mapGetMany(Map map, MapKeyElement* keyElements, int size, MapDataElement* dataElements)
+{
+    if (map == NULL || keyElements == NULL || dataElements == NULL || size < 0) {
+        return MAP_NULL_ARGUMENT;
+    }
+    for (int i = 0; i < size; i++) {
+        if (keyElements[i] == NULL) {
+            return MAP_NULL_ARGUMENT;
         }
-        ptr = ptr->next;
     }
-    return NULL;
+    if (size == 0) {
+        return MAP_SUCCESS;
+    }
+
+    Position* positions = (Position*)malloc(size * sizeof(Position));
+    if (positions == NULL || !resolveBatch(map, keyElements, size, positions)) {
+        free(positions);
+        return MAP_OUT_OF_MEMORY;
+    }
+    for (int i = 0; i < size; i++) {
+        Position position = positions[i];
+        dataElements[i] = (position.node != NULL ? getData(map, position.node, position.index) : NULL);
+    }
+
+    free(positions);
+    return MAP_SUCCESS;
 }
 
 MapKeyElement mapGetFirst(Map map)
 {
-    if (map == NULL || map->head == NULL) {
+    if (map == NULL || !positionFirst(map, &map->iterator)) {
         return NULL;
     }
 
-    map->iterator = map->head;
-    return map->copyKeyElement(map->iterator->key);
+    return getKey(map, map->iterator.node, map->iterator.index);
 }
 
 MapKeyElement mapGetNext(Map map)
 {
-    if (map == NULL || map->iterator == NULL || map->iterator->next == NULL) {
+    if (map == NULL || !positionNext(&map->iterator)) {
+        return NULL;
+    }
+
+    return getKey(map, map->iterator.node, map->iterator.index);
+}
+
+bool mapCursorFirst(Map map, MapCursor* cursor)
+{
+    if (map == NULL || cursor == NULL) {
+        return false;
+    }
+    Position position;
+    bool valid = positionFirst(map, &position);
+    setCursor(map, cursor, position);
+    return valid;
+}
+
+bool mapCursorLast(Map map, MapCursor* cursor)
+{
+    if (map == NULL || cursor == NULL) {
+        return false;
+    }
+    Position position;
+    bool valid = positionLast(map, &position);
+    setCursor(map, cursor, position);
+    return valid;
+}
+
+bool mapCursorNext(MapCursor* cursor)
+{
+    Position position;
+    if (!cursorPosition(cursor, &position)) {
+        return false;
+    }
+    bool valid = positionNext(&position);
+    cursor->node = position.node;
+    cursor->index = position.index;
+    return valid;
+}
+
+bool mapCursorPrevious(MapCursor* cursor)
+{
+    Position position;
+    if (!cursorPosition(cursor, &position)) {
+        return false;
+    }
+    bool valid = positionPrevious(&position);
+    cursor->node = position.node;
+    cursor->index = position.index;
+    return valid;
+}
+
+MapKeyElement mapCursorGetKey(MapCursor* cursor)
+{
+    Position position;
+    if (!cursorPosition(cursor, &position)) {
+        return NULL;
+    }
+    return getKey(cursor->map, position.node, position.index);
+}
+
+MapDataElement mapCursorGetData(MapCursor* cursor)
+{
+    Position position;
+    if (!cursorPosition(cursor, &position)) {
         return NULL;
     }
+    return getData(cursor->map, position.node, position.index);
+}
+
+MapResult mapForEach(Map map, visitMapElements visit, void* context)
+{
+    if (map == NULL || visit == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    Position position;
+    for (bool valid = positionFirst(map, &position); valid; valid = positionNext(&position)) {
+        if (!visit(getKey(map, position.node, position.index), getData(map, position.node, position.index), context)) {
+            break;
+        }
+    }
 
-    map->iterator = map->iterator->next;
-    return map->copyKeyElement(map->iterator->key);
+    return MAP_SUCCESS;
 }
 
 MapResult mapClear(Map map)
@@ -238,10 +715,13 @@ MapResult mapClear(Map map)
         return MAP_NULL_ARGUMENT;
     }
 
-    while(map->head != NULL) {
-        Node* ptr = map->head;
-        map->head = map->head->next;
-        removeNodeElement(map, ptr);
+    destroyNode(map, map->root);
+    map->root = NULL;
+    map->size = 0;
+    map->iterator.node = NULL;
+    map->version++;
+    if (map->filter != NULL) { // if this fails, the filter keeps the old hashes, which only cost false positives
+        bloomFilterReset(map->filter, bloomFilterGetCapacity(map->filter));
     }
 
     return MAP_SUCCESS;
@@ -252,34 +732,1746 @@ MapResult mapRemove(Map map, MapKeyElement keyElement)
     if(map == NULL || keyElement == NULL) {
         return MAP_NULL_ARGUMENT;
     }
-    if (map->head == NULL) {
+
+    Position position;
+    if (!findKey(map, keyElement, &position)) {
         return MAP_ITEM_DOES_NOT_EXIST;
     }
 
-    Node* ptr = map->head;
-    if(!(map->compareKeyElements(ptr->key , keyElement))) {
-        map->head = map->head->next;
-        removeNodeElement(map , ptr);
-        return MAP_SUCCESS;
+    freeElements(map, position.node, position.index);
+    removeElement(map, position);
+    map->iterator.node = NULL;
+    map->version++;
+
+    return MAP_SUCCESS;
+}
+
+MapResult mapExtract(Map map, MapKeyElement keyElement, MapKeyElement* keyOut, MapDataElement* dataOut)
+{
+    if(map == NULL || keyElement == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (map->is_inline && ((keyOut != NULL && *keyOut == NULL) || (dataOut != NULL && *dataOut == NULL))) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    Position position;
+    if (!findKey(map, keyElement, &position)) {
+        return MAP_ITEM_DOES_NOT_EXIST;
+    }
+
+    MapKeyElement key = getKey(map, position.node, position.index);
+    MapDataElement data = getData(map, position.node, position.index);
+    if (map->is_inline) {
+        if (keyOut != NULL) {
+            memcpy(*keyOut, key, map->keySize);
+        }
+        if (dataOut != NULL) {
+            memcpy(*dataOut, data, map->dataSize);
+        }
+    }
+    else {
+        if (keyOut != NULL) {
+            *keyOut = key;
+        }
+        else {
+            freeKey(map, key);
+        }
+        if (dataOut != NULL) {
+            *dataOut = data;
+        }
+        else {
+            map->freeDataElement(data);
+        }
+    }
+    removeElement(map, position);
+    map->iterator.node = NULL;
+    map->version++;
+
+    return MAP_SUCCESS;
+}
+
+bool mapLowerBound(Map map, MapKeyElement keyElement, MapCursor* cursor)
+{
+    if (map == NULL || keyElement == NULL || cursor == NULL) {
+        return false;
+    }
+    Position position;
+    bool valid = findBound(map, keyElement, false, &position);
+    setCursor(map, cursor, position);
+    return valid;
+}
+
+bool mapUpperBound(Map map, MapKeyElement keyElement, MapCursor* cursor)
+{
+    if (map == NULL || keyElement == NULL || cursor == NULL) {
+        return false;
+    }
+    Position position;
+    bool valid = findBound(map, keyElement, true, &position);
+    setCursor(map, cursor, position);
+    return valid;
+}
+
+MapResult mapRangeForEach(Map map, MapKeyElement low, MapKeyElement high,
+                          visitMapElements visit, void* context)
+{
+    if (map == NULL || visit == NULL) {
+        return MAP_NULL_ARGUMENT;
     }
 
-    while(ptr->next != NULL) {
-        if(!(map->compareKeyElements(ptr->next->key , keyElement))) {
-            Node* next = ptr->next;
-            ptr->next = next->next;
-            removeNodeElement(map, next);
-            return MAP_SUCCESS;
+    Position position;
+    bool valid = (low == NULL ? positionFirst(map, &position) : findBound(map, low, false, &position));
+    for (; valid; valid = positionNext(&position)) {
+        MapKeyElement key = getKey(map, position.node, position.index);
+        if (high != NULL && map->compareKeyElements(key, high) >= 0) {
+            break;
+        }
+        if (!visit(key, getData(map, position.node, position.index), context)) {
+            break;
         }
-        ptr = ptr->next;
     }
-    
-    return MAP_ITEM_DOES_NOT_EXIST;   
+
+    return MAP_SUCCESS;
 }
 
-static void removeNodeElement(Map map, Node* node)
+MapResult mapRemoveRange(Map map, MapKeyElement low, MapKeyElement high)
 {
-    map->freeDataElement(node->data);
-    map->freeKeyElement(node->key);
-    map->size--;
-    free(node);
+    if (map == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    Position position;
+    if (low == NULL) {
+        positionFirst(map, &position);
+    }
+    else {
+        findBound(map, low, false, &position);
+    }
+    while (position.node != NULL &&
+           (high == NULL || map->compareKeyElements(getKey(map, position.node, position.index), high) < 0)) {
+        removeAndAdvance(map, &position);
+    }
+    map->iterator.node = NULL;
+    map->version++;
+
+    return MAP_SUCCESS;
+}
+
+MapKeyElement mapGetByRank(Map map, int rank)
+{
+    if (map == NULL || rank < 0 || rank >= map->size) {
+        return NULL;
+    }
+
+    Node* node = map->root;
+    while (!node->is_leaf) {
+        int index = 0;
+        for (; index < node->count; index++) {
+            int left = node->children[index]->size; // the number of pairs before this key in the subtree
+            if (rank < left) {
+                break;
+            }
+            if (rank == left) {
+                return getKey(map, node, index);
+            }
+            rank -= left + 1;
+        }
+        node = node->children[index];
+    }
+    return getKey(map, node, rank);
+}
+
+int mapRank(Map map, MapKeyElement keyElement)
+{
+    if (map == NULL || keyElement == NULL) {
+        return NULL_MAP_SIZE;
+    }
+
+    int rank = 0;
+    Node* node = map->root;
+    while (node != NULL) {
+        bool found;
+        int index = findIndex(map, node, keyElement, &found);
+        rank += index;
+        if (!node->is_leaf) {
+            for (int i = 0; i < index; i++) {
+                rank += node->children[i]->size;
+            }
+            if (found) {
+                rank += node->children[index]->size;
+            }
+        }
+        if (found || node->is_leaf) {
+            break;
+        }
+        node = node->children[index];
+    }
+    return rank;
+}
+
+MapResult mapMerge(Map destination, Map source, MapMergePolicy policy)
+{
+    if (destination == NULL || source == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (destination == source || source->size == 0) {
+        return MAP_SUCCESS;
+    }
+    if (!isMergeable(destination, source)) {
+        return mergeByPutting(destination, source, policy);
+    }
+
+    int total = destination->size + source->size;
+    Entry* entries = (Entry*)malloc(total * sizeof(Entry));
+    int* copies = (int*)malloc(source->size * sizeof(int)); // the entries which should hold copies of source's pairs
+    Entry* replaced = (Entry*)malloc(source->size * sizeof(Entry)); // destination's pairs which source overrides
+    if (entries == NULL || copies == NULL || replaced == NULL) {
+        free(entries);
+        free(copies);
+        free(replaced);
+        return MAP_OUT_OF_MEMORY;
+    }
+
+    // a single merge pass over both maps, which are sorted by the same compare function
+    int size = 0, copies_count = 0, replaced_count = 0;
+    Position first, second;
+    bool has_first = positionFirst(destination, &first);
+    bool has_second = positionFirst(source, &second);
+    while (has_first || has_second) {
+        Entry from_first = { NULL, NULL }, from_second = { NULL, NULL };
+        if (has_first) {
+            from_first.key = getKey(destination, first.node, first.index);
+            from_first.data = getData(destination, first.node, first.index);
+        }
+        if (has_second) {
+            from_second.key = getKey(source, second.node, second.index);
+            from_second.data = getData(source, second.node, second.index);
+        }
+        int compare = (!has_second ? -1 : !has_first ? 1 :
+                       destination->compareKeyElements(from_first.key, from_second.key));
+
+        if (compare < 0 || (compare == 0 && policy == MAP_MERGE_KEEP_DESTINATION)) {
+            entries[size++] = from_first;
+        }
+        else {
+            if (compare == 0) {
+                replaced[replaced_count++] = from_first;
+            }
+            copies[copies_count++] = size;
+            entries[size++] = from_second;
+        }
+        if (compare <= 0) {
+            has_first = positionNext(&first);
+        }
+        if (compare >= 0) {
+            has_second = positionNext(&second);
+        }
+    }
+
+    int copied = 0;
+    for (; copied < copies_count && duplicateEntry(destination, &entries[copies[copied]]); copied++);
+
+    MapResult result = MAP_SUCCESS;
+    if (copied < copies_count || !replaceTree(destination, entries, size)) {
+        for (int i = 0; i < copied; i++) {
+            freeEntry(destination, &entries[copies[i]]);
+        }
+        result = MAP_OUT_OF_MEMORY;
+    }
+    else {
+        for (int i = 0; i < replaced_count; i++) {
+            freeEntry(destination, &replaced[i]);
+        }
+    }
+
+    free(entries);
+    free(copies);
+    free(replaced);
+    return result;
+}
+
+Map mapDifference(Map map1, Map map2)
+{
+    if (map1 == NULL || map2 == NULL) {
+        return NULL;
+    }
+    return filterByKeys(map1, map2, false);
+}
+
+Map mapIntersectKeys(Map map1, Map map2)
+{
+    if (map1 == NULL || map2 == NULL) {
+        return NULL;
+    }
+    return filterByKeys(map1, map2, true);
+}
+
+MapResult mapEnableFilter(Map map, hashMapKeyElements hashKeyElement, int expectedSize, double falsePositiveRate)
+{
+    if (map == NULL || hashKeyElement == NULL || expectedSize <= 0 ||
+        !(falsePositiveRate > 0 && falsePositiveRate < 1)) {
+        return MAP_NULL_ARGUMENT;
+    }
+    BloomFilter filter = bloomFilterCreate(expectedSize > map->size ? expectedSize : map->size, falsePositiveRate);
+    if (filter == NULL) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    bloomFilterDestroy(map->filter);
+    map->filter = filter;
+    map->hashKeyElement = hashKeyElement;
+    Position position;
+    for (bool valid = positionFirst(map, &position); valid; valid = positionNext(&position)) {
+        bloomFilterAdd(filter, hashKeyElement(getKey(map, position.node, position.index)));
+    }
+
+    return MAP_SUCCESS;
+}
+
+MapResult mapGetFilterStatistics(Map map, BloomFilterStatistics* statistics)
+{
+    if (map == NULL || map->filter == NULL || statistics == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+    *statistics = bloomFilterGetStatistics(map->filter);
+    return MAP_SUCCESS;
+}
+
+// ============================ B-TREE ============================ //
+
+static Node* createNode(Map map, bool is_leaf)
+{
+    size_t header = (is_leaf ? LEAF_HEADER_SIZE : INTERNAL_HEADER_SIZE);
+    Node* node = (Node*)malloc(header + map->dataOffset + NODE_SLOTS * map->dataSize);
+    if (node == NULL) {
+        return NULL;
+    }
+    node->count = 0;
+    node->size = 0;
+    node->is_leaf = is_leaf;
+    node->parent = NULL;
+
+    return node;
+}
+
+static void destroyNode(Map map, Node* node)
+{
+    if (node == NULL) {
+        return;
+    }
+    freeEntries(map, node);
+    if (!node->is_leaf) {
+        for (int i = 0; i <= node->count; i++) {
+            destroyNode(map, node->children[i]);
+        }
+    }
+    free(node);
+}
+
+static void freeEntries(Map map, Node* node)
+{
+    for (int i = 0; i < node->count && !map->is_inline; i++) {
+        freeElements(map, node, i);
+    }
+}
+
+/**
+* Frees a subtree without freeing the elements in it.
+*/
+static void freeNodes(Node* node)
+{
+    if (!node->is_leaf) {
+        for (int i = 0; i <= node->count; i++) {
+            freeNodes(node->children[i]);
+        }
+    }
+    free(node);
+}
+
+/**
+* Copies a subtree node by node, so the copy has the exact same shape.
+* Returns NULL if an allocation failed (after freeing whatever was already copied).
+*/
+static Node* cloneNode(Map map, Node* source)
+{
+    Node* node = createNode(map, source->is_leaf);
+    if (node == NULL) {
+        return NULL;
+    }
+    node->size = source->size;
+
+    if (map->is_inline) {
+        moveEntries(map, node, 0, source, 0, source->count);
+        node->count = source->count;
+    }
+    for (; node->count < source->count; node->count++) {
+        MapKeyElement key = copyKey(map, getKey(map, source, node->count));
+        MapDataElement data = (key == NULL ? NULL : map->copyDataElement(getData(map, source, node->count)));
+        if (data == NULL) {
+            if (key != NULL) {
+                freeKey(map, key);
+            }
+            freeEntries(map, node);
+            free(node);
+            return NULL;
+        }
+        setEntry(map, node, node->count, key, data);
+    }
+
+    if (!node->is_leaf) {
+        for (int i = 0; i <= node->count; i++) {
+            node->children[i] = cloneNode(map, source->children[i]);
+            if (node->children[i] == NULL) {
+                while (i > 0) {
+                    destroyNode(map, node->children[--i]);
+                }
+                freeEntries(map, node);
+                free(node);
+                return NULL;
+            }
+            node->children[i]->parent = node;
+        }
+    }
+
+    return node;
+}
+
+/**
+* Builds a subtree of the given height out of sorted entries, in linear time.
+* The entries are spread evenly between the children, and the height is expected to be
+* the smallest one that fits all of the entries, so every node ends up at least half full.
+* Returns NULL if an allocation failed (the elements themselves are not freed).
+*/
+static Node* buildNode(Map map, Entry* entries, int size, int height)
+{
+    Node* node = createNode(map, height == 1);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    if (height == 1) {
+        for (int i = 0; i < size; i++) {
+            setEntry(map, node, i, entries[i].key, entries[i].data);
+        }
+        node->count = size;
+        node->size = size;
+        return node;
+    }
+
+    long long child_capacity = MAX_KEYS;
+    for (int i = 2; i < height; i++) {
+        child_capacity = child_capacity * (MAX_KEYS + 1) + MAX_KEYS;
+    }
+    int children = (int)((size + 1 + child_capacity) / (child_capacity + 1)); // ceil((size + 1) / (capacity + 1))
+    int child_size = (size - (children - 1)) / children;
+    int remainder = (size - (children - 1)) % children;
+
+    int next = 0;
+    for (int i = 0; i < children; i++) {
+        int count = child_size + (i < remainder ? 1 : 0);
+        node->children[i] = buildNode(map, &entries[next], count, height - 1);
+        if (node->children[i] == NULL) {
+            while (i > 0) {
+                freeNodes(node->children[--i]);
+            }
+            free(node);
+            return NULL;
+        }
+        node->children[i]->parent = node;
+        next += count;
+        if (i < children - 1) {
+            setEntry(map, node, i, entries[next].key, entries[next].data);
+            next++;
+        }
+    }
+    node->count = children - 1;
+    node->size = size;
+
+    return node;
+}
+
+/**
+* Returns the height of the shortest B-tree which can hold the given number of pairs.
+*/
+static int treeHeight(int size)
+{
+    int height = 1;
+    for (long long capacity = MAX_KEYS; capacity < size; capacity = capacity * (MAX_KEYS + 1) + MAX_KEYS) {
+        height++;
+    }
+    return height;
+}
+
+/**
+* Replaces the map's tree with a new tree built from the given sorted entries.
+* The old nodes are freed, but not the elements in them (which the entries may still use).
+* Returns false if an allocation failed, and then the map is left untouched.
+*/
+static bool replaceTree(Map map, Entry* entries, int size)
+{
+    Node* root = NULL;
+    if (size > 0) {
+        root = buildNode(map, entries, size, treeHeight(size));
+        if (root == NULL) {
+            return false;
+        }
+    }
+    if (map->root != NULL) {
+        freeNodes(map->root);
+    }
+    map->root = root;
+    map->size = size;
+    map->iterator.node = NULL;
+    map->version++;
+    refillFilter(map);
+
+    return true;
+}
+
+/**
+* Creates an empty map which stores its elements the same way as the given map.
+*/
+static Map createEmptyCopy(Map map)
+{
+    Map new_map;
+    if (map->pool != NULL) {
+        new_map = mapCreateInterned(map->pool, map->copyDataElement, map->freeDataElement);
+    }
+    else {
+        new_map = (map->is_inline ?
+                   mapCreateInline(map->keySize, map->dataSize, map->compareKeyElements) :
+                   mapCreate(map->copyDataElement, map->copyKeyElement, map->freeDataElement,
+                             map->freeKeyElement, map->compareKeyElements));
+    }
+    if (new_map != NULL && map->filter != NULL &&
+        mapEnableFilter(new_map, map->hashKeyElement, bloomFilterGetCapacity(map->filter),
+                        bloomFilterGetFalsePositiveRate(map->filter)) != MAP_SUCCESS) {
+        mapDestroy(new_map);
+        return NULL;
+    }
+    return new_map;
+}
+
+/**
+* Checks if the pairs of two maps can be merged in a single pass: both maps must be
+* ordered by the same compare function and store their elements the same way.
+*/
+static bool isMergeable(Map map1, Map map2)
+{
+    return map1->compareKeyElements == map2->compareKeyElements &&
+           map1->is_inline == map2->is_inline &&
+           map1->keySize == map2->keySize && map1->dataSize == map2->dataSize;
+}
+
+/**
+* Replaces the elements of an entry with copies of them. The entry of an inline map
+* is left pointing at the original bytes, which are copied when they are put in a node.
+* Returns false if a copy failed, and then the entry is left untouched.
+*/
+static bool duplicateEntry(Map map, Entry* entry)
+{
+    if (map->is_inline) {
+        return true;
+    }
+    MapKeyElement key = copyKey(map, entry->key);
+    if (key == NULL) {
+        return false;
+    }
+    MapDataElement data = map->copyDataElement(entry->data);
+    if (data == NULL) {
+        freeKey(map, key);
+        return false;
+    }
+    entry->key = key;
+    entry->data = data;
+
+    return true;
+}
+
+static void freeEntry(Map map, Entry* entry)
+{
+    if (!map->is_inline) {
+        map->freeDataElement(entry->data);
+        freeKey(map, entry->key);
+    }
+}
+
+/**
+* Merges maps which cannot be merged in a single pass, by putting source's pairs
+* in destination one by one. If an allocation fails, the merge stops in the middle.
+*/
+static MapResult mergeByPutting(Map destination, Map source, MapMergePolicy policy)
+{
+    Position position;
+    for (bool valid = positionFirst(source, &position); valid; valid = positionNext(&position)) {
+        MapKeyElement key = getKey(source, position.node, position.index);
+        if (policy == MAP_MERGE_KEEP_DESTINATION && mapContains(destination, key)) {
+            continue;
+        }
+        MapResult result = mapPut(destination, key, getData(source, position.node, position.index));
+        if (result != MAP_SUCCESS) {
+            return result;
+        }
+    }
+    return MAP_SUCCESS;
+}
+
+/**
+* Creates a map with copies of the pairs of the given map whose keys are in the other map
+* (if common is true) or are not in it (if common is false).
+* If both maps are ordered by the same compare function, they are walked in a single merge pass.
+*/
+static Map filterByKeys(Map map, Map keys, bool common)
+{
+    Map new_map = createEmptyCopy(map);
+    if (new_map == NULL || map->size == 0) {
+        return new_map;
+    }
+    Entry* entries = (Entry*)malloc(map->size * sizeof(Entry));
+    if (entries == NULL) {
+        mapDestroy(new_map);
+        return NULL;
+    }
+
+    bool merge = (map->compareKeyElements == keys->compareKeyElements);
+    int size = 0;
+    Position first, second;
+    bool has_second = merge && positionFirst(keys, &second);
+    for (bool has_first = positionFirst(map, &first); has_first; has_first = positionNext(&first)) {
+        MapKeyElement key = getKey(map, first.node, first.index);
+        bool found;
+        if (merge) {
+            int compare = 1;
+            while (has_second &&
+                   (compare = map->compareKeyElements(key, getKey(keys, second.node, second.index))) > 0) {
+                has_second = positionNext(&second);
+            }
+            found = (has_second && compare == 0);
+        }
+        else {
+            found = mapContains(keys, key);
+        }
+        if (found == common) {
+            entries[size].key = key;
+            entries[size].data = getData(map, first.node, first.index);
+            size++;
+        }
+    }
+
+    int copied = 0;
+    for (; copied < size && duplicateEntry(new_map, &entries[copied]); copied++);
+    if (copied < size || !replaceTree(new_map, entries, size)) {
+        for (int i = 0; i < copied; i++) {
+            freeEntry(new_map, &entries[i]);
+        }
+        mapDestroy(new_map);
+        new_map = NULL;
+    }
+
+    free(entries);
+    return new_map;
+}
+
+/**
+* A stable merge sort of entries by key, using a buffer of the same size.
+* Large arrays are split between up to 2^depth threads.
+*/
+static void sortEntries(Entry* entries, Entry* buffer, int size, compareMapKeyElements compare, int depth)
+{
+    if (size <= INSERTION_SORT_SIZE) {
+        for (int i = 1; i < size; i++) {
+            Entry entry = entries[i];
+            int j = i;
+            for (; j > 0 && compare(entries[j - 1].key, entry.key) > 0; j--) {
+                entries[j] = entries[j - 1];
+            }
+            entries[j] = entry;
+        }
+        return;
+    }
+
+    int middle = size / 2;
+    pthread_t thread;
+    SortTask task = { entries, buffer, middle, compare, depth - 1 };
+    bool parallel = depth > 0 && size >= PARALLEL_SORT_SIZE &&
+                    pthread_create(&thread, NULL, sortEntriesTask, &task) == 0;
+    if (!parallel) {
+        sortEntries(entries, buffer, middle, compare, 0);
+    }
+    sortEntries(&entries[middle], &buffer[middle], size - middle, compare, depth - 1);
+    if (parallel) {
+        pthread_join(thread, NULL);
+    }
+
+    if (compare(entries[middle - 1].key, entries[middle].key) <= 0) { // already in order
+        return;
+    }
+    int left = 0;
+    int right = middle;
+    int next = 0;
+    while (left < middle && right < size) {
+        buffer[next++] = (compare(entries[left].key, entries[right].key) <= 0 ? entries[left++] : entries[right++]);
+    }
+    while (left < middle) {
+        buffer[next++] = entries[left++];
+    }
+    memcpy(entries, buffer, next * sizeof(Entry)); // whatever is left on the right is already in place
+}
+
+static void* sortEntriesTask(void* task)
+{
+    SortTask* sort = (SortTask*)task;
+    sortEntries(sort->entries, sort->buffer, sort->size, sort->compare, sort->depth);
+    return NULL;
+}
+
+/**
+* Removes the duplicate keys from sorted entries, keeping the last of each
+* (the same one repeated puts would have kept). Returns the new size.
+*/
+static int removeDuplicates(Entry* entries, int size, compareMapKeyElements compare)
+{
+    int unique = 0;
+    for (int i = 0; i < size; i++) {
+        if (unique > 0 && compare(entries[unique - 1].key, entries[i].key) == 0) {
+            entries[unique - 1] = entries[i];
+        }
+        else {
+            entries[unique++] = entries[i];
+        }
+    }
+    return unique;
+}
+
+static bool isSorted(Entry* entries, int size, compareMapKeyElements compare)
+{
+    for (int i = 1; i < size; i++) {
+        if (compare(entries[i - 1].key, entries[i].key) > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int childIndex(Node* parent, Node* child)
+{
+    int index = 0;
+    while (parent->children[index] != child) {
+        index++;
+    }
+    return index;
+}
+
+/**
+* Binary search inside a single node.
+* Returns the index of the first key which is not smaller than keyElement,
+* and sets found to whether that key is equal to keyElement.
+*/
+static int findIndex(Map map, Node* node, MapKeyElement keyElement, bool* found)
+{
+    return findIndexBetween(map, node, 0, node->count, keyElement, found);
+}
+
+/**
+* The same as findIndex, where the keys before low are known to be smaller than keyElement,
+* and the key at high (if there is one) is known to be greater.
+*/
+static int findIndexBetween(Map map, Node* node, int low, int high, MapKeyElement keyElement, bool* found)
+{
+    while (low < high) {
+        int middle = (low + high) / 2;
+        int result = map->compareKeyElements(getKey(map, node, middle), keyElement);
+        if (result < 0) {
+            low = middle + 1;
+        }
+        else if (result > 0) {
+            high = middle;
+        }
+        else {
+            *found = true;
+            return middle;
+        }
+    }
+    *found = false;
+    return low;
+}
+
+/**
+* The same as findIndex, where the keys before start are known to be smaller than keyElement.
+* The keys at start, start+1, start+3, start+7... are compared until one is not smaller,
+* and only the last gap is binary searched, so a key which is close to start is found
+* in a few comparisons.
+*/
+static int gallopIndex(Map map, Node* node, int start, MapKeyElement keyElement, bool* found)
+{
+    int low = start;
+    int probe = start;
+    int step = 1;
+    while (probe < node->count) {
+        int result = map->compareKeyElements(getKey(map, node, probe), keyElement);
+        if (result == 0) {
+            *found = true;
+            return probe;
+        }
+        if (result > 0) {
+            break;
+        }
+        low = probe + 1;
+        probe = low + step;
+        step *= 2;
+    }
+    return findIndexBetween(map, node, low, (probe < node->count ? probe : node->count), keyElement, found);
+}
+
+/**
+* Binary search inside a single node.
+* Returns the index of the first key which is greater than keyElement.
+*/
+static int findUpperIndex(Map map, Node* node, MapKeyElement keyElement)
+{
+    int low = 0;
+    int high = node->count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (map->compareKeyElements(getKey(map, node, middle), keyElement) <= 0) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+* Searches the tree for keyElement.
+* If it was found, returns true and points position at it.
+* Otherwise, returns false and points position at the leaf slot where it should be inserted.
+*/
+static bool findPosition(Map map, MapKeyElement keyElement, Position* position)
+{
+    position->node = NULL;
+    position->index = 0;
+
+    Node* node = map->root;
+    while (node != NULL) {
+        bool found;
+        int index = findIndex(map, node, keyElement, &found);
+        position->node = node;
+        position->index = index;
+        if (found) {
+            return true;
+        }
+        node = node->is_leaf ? NULL : node->children[index];
+    }
+    return false;
+}
+
+/**
+* Searches for keyElement the same as findPosition, unless the map's filter rules it out,
+* and then returns false right away (without setting position).
+* The result of the lookup is counted in the filter's statistics.
+*/
+static bool findKey(Map map, MapKeyElement keyElement, Position* position)
+{
+    if (map->filter == NULL) {
+        return findPosition(map, keyElement, position);
+    }
+    bool may_contain = bloomFilterMayContain(map->filter, map->hashKeyElement(keyElement));
+    bool found = may_contain && findPosition(map, keyElement, position);
+    bloomFilterCountLookup(map->filter, may_contain, found);
+    return found;
+}
+
+/**
+* Adds the hash of a key which is about to be inserted to the map's filter.
+* Once the filter is full, it is first rebuilt from the keys in the map (which also drops
+* the hashes of removed keys), with room for twice as many.
+*/
+static void filterKey(Map map, MapKeyElement keyElement)
+{
+    int capacity = bloomFilterGetCapacity(map->filter);
+    if (bloomFilterGetCount(map->filter) >= capacity) {
+        if (2 * map->size > capacity) {
+            capacity = 2 * map->size;
+        }
+        if (bloomFilterReset(map->filter, capacity)) { // if this fails, the old hashes are kept
+            refillFilter(map);
+        }
+    }
+    bloomFilterAdd(map->filter, map->hashKeyElement(keyElement));
+}
+
+/**
+* Adds the hashes of all of the keys in the map to its filter, after the tree was replaced.
+* The filter is first reset, so it does not keep the hashes of the keys which are gone,
+* unless that failed and then the hashes are added on top of the old ones.
+*/
+static void refillFilter(Map map)
+{
+    if (map->filter == NULL) {
+        return;
+    }
+    int capacity = bloomFilterGetCapacity(map->filter);
+    bloomFilterReset(map->filter, (map->size > capacity ? 2 * map->size : capacity));
+    Position position;
+    for (bool valid = positionFirst(map, &position); valid; valid = positionNext(&position)) {
+        bloomFilterAdd(map->filter, map->hashKeyElement(getKey(map, position.node, position.index)));
+    }
+}
+
+/**
+* Sorts the entries of a batch by key, unless they already are in order.
+* Returns false if an allocation failed.
+*/
+static bool sortBatch(Map map, Entry* entries, int size)
+{
+    if (isSorted(entries, size, map->compareKeyElements)) {
+        return true;
+    }
+    Entry* buffer = (Entry*)malloc(size * sizeof(Entry));
+    if (buffer == NULL) {
+        return false;
+    }
+    sortEntries(entries, buffer, size, map->compareKeyElements, PARALLEL_SORT_DEPTH);
+    free(buffer);
+    return true;
+}
+
+/**
+* Searches for all of the keys of a batch the same as findKey would search for each of them:
+* the keys which the map's filter rules out are not searched at all, and the result of every
+* lookup is counted in the filter's statistics.
+* Sets positions[i] to where keyElements[i] is, or its node to NULL if it is not in the map.
+* Returns false if an allocation failed.
+*/
+static bool resolveBatch(Map map, MapKeyElement* keyElements, int size, Position* positions)
+{
+    if (map->filter == NULL) {
+        return searchBatch(map, keyElements, size, NULL, positions);
+    }
+    bool* may_contain = (bool*)calloc(size, sizeof(bool));
+    if (may_contain == NULL) {
+        return false;
+    }
+    for (int i = 0; i < size; i++) {
+        may_contain[i] = bloomFilterMayContain(map->filter, map->hashKeyElement(keyElements[i]));
+    }
+    bool searched = searchBatch(map, keyElements, size, may_contain, positions);
+    if (searched) {
+        for (int i = 0; i < size; i++) {
+            bloomFilterCountLookup(map->filter, may_contain[i], positions[i].node != NULL);
+        }
+    }
+    free(may_contain);
+    return searched;
+}
+
+/**
+* Searches for the keys of a batch at once (only those which mayContain allows, unless it is NULL),
+* one level of the tree at a time. The keys which go down to the same child form a group: the keys of every node are stably
+* partitioned by the child they go down to (a counting sort on the child's index), so the batch
+* does not have to be sorted first, and the groups of a level are in the order of their nodes.
+* The node of every group is prefetched a few groups before it is searched, so the cache misses
+* of the whole level overlap instead of coming one after the other.
+* Sets positions[i] to where keyElements[i] is, or its node to NULL if it is not in the map
+* (or was not searched). Returns false if an allocation failed.
+*/
+static bool searchBatch(Map map, MapKeyElement* keyElements, int size, const bool* mayContain, Position* positions)
+{
+    for (int i = 0; i < size; i++) {
+        positions[i].node = NULL;
+        positions[i].index = 0;
+    }
+    if (map->root == NULL) {
+        return true;
+    }
+    BatchGroup* groups = (BatchGroup*)malloc(2 * size * sizeof(BatchGroup));
+    int* order = (int*)malloc(3 * size * sizeof(int));
+    if (groups == NULL || order == NULL) {
+        free(groups);
+        free(order);
+        return false;
+    }
+    BatchGroup* next_groups = groups + size;
+    int* next_order = order + size;
+    int* child = order + 2 * size; // the child which order[i] goes down to, or -1 if its search ended
+
+    int candidates = 0;
+    for (int i = 0; i < size; i++) {
+        if (mayContain == NULL || mayContain[i]) {
+            order[candidates++] = i;
+        }
+    }
+    groups[0] = (BatchGroup){ map->root, 0, candidates };
+    int count = (candidates > 0);
+    while (count > 0) {
+        int next_count = 0;
+        int next_size = 0;
+        for (int g = 0; g < count; g++) {
+            if (g + BATCH_PREFETCH_DISTANCE < count) {
+                prefetchNode(map, groups[g + BATCH_PREFETCH_DISTANCE].node);
+            }
+            if (!map->is_inline && g + BATCH_PREFETCH_DISTANCE / 2 < count) {
+                prefetchKeys(map, groups[g + BATCH_PREFETCH_DISTANCE / 2].node); // which has arrived by now
+            }
+            Node* node = groups[g].node;
+            int children_count[NODE_SLOTS + 1] = { 0 };
+            for (int i = groups[g].first; i < groups[g].end; i++) {
+                bool found;
+                int index = findIndex(map, node, keyElements[order[i]], &found);
+                child[i] = -1;
+                if (found) {
+                    positions[order[i]].node = node;
+                    positions[order[i]].index = index;
+                }
+                else if (!node->is_leaf) {
+                    child[i] = index;
+                    children_count[index]++;
+                }
+            }
+            if (node->is_leaf) {
+                continue;
+            }
+
+            int starts[NODE_SLOTS + 1];
+            for (int index = 0; index <= node->count; index++) {
+                starts[index] = next_size;
+                if (children_count[index] > 0) {
+                    next_groups[next_count++] = (BatchGroup){ node->children[index], next_size, next_size + children_count[index] };
+                    next_size += children_count[index];
+                }
+            }
+            for (int i = groups[g].first; i < groups[g].end; i++) {
+                if (child[i] >= 0) {
+                    next_order[starts[child[i]]++] = order[i];
+                }
+            }
+        }
+        BatchGroup* swap_groups = groups;
+        groups = next_groups;
+        next_groups = swap_groups;
+        int* swap_order = order;
+        order = next_order;
+        next_order = swap_order;
+        count = next_count;
+    }
+
+    free(groups < next_groups ? groups : next_groups);
+    free(order < next_order ? order : next_order);
+    return true;
+}
+
+/**
+* Searches for keyElement the same as findPosition, starting from where the finger's last
+* search ended, and then moves the finger to where this search ended.
+* keyElement must not be smaller than the key of the last search.
+*/
+static bool fingerSearch(Map map, Finger* finger, MapKeyElement keyElement, Position* position)
+{
+    position->node = NULL;
+    position->index = 0;
+    if (map->root == NULL) {
+        return false;
+    }
+
+    int level = 0;
+    int index;
+    bool found;
+    if (finger->depth < 0) {
+        finger->path[0] = map->root;
+        finger->bound[0] = NULL;
+        index = findIndex(map, map->root, keyElement, &found);
+    }
+    else {
+        // climb until the key is below the subtree's bound (the levels which share a bound are climbed at once)
+        level = finger->depth;
+        while (level > 0 && finger->bound[level] != NULL &&
+               map->compareKeyElements(finger->bound[level], keyElement) <= 0) {
+            MapKeyElement passed = finger->bound[level];
+            while (level > 0 && finger->bound[level] == passed) {
+                level--;
+            }
+        }
+        index = gallopIndex(map, finger->path[level], finger->index[level], keyElement, &found);
+    }
+
+    Node* node = finger->path[level];
+    finger->index[level] = index;
+    while (!found && !node->is_leaf) {
+        Node* child = node->children[index];
+        prefetchNode(map, child);
+        finger->bound[level + 1] = (index < node->count ? getKey(map, node, index) : finger->bound[level]);
+        finger->path[++level] = child;
+        node = child;
+        index = findIndex(map, node, keyElement, &found);
+        finger->index[level] = index;
+    }
+
+    finger->depth = level;
+    position->node = node;
+    position->index = index;
+    return found;
+}
+
+/**
+* Points the finger at position, as if a search had just ended there.
+*/
+static void fingerAt(Map map, Finger* finger, Position position)
+{
+    int depth = 0;
+    for (Node* node = position.node; node->parent != NULL; node = node->parent) {
+        depth++;
+    }
+
+    finger->depth = depth;
+    finger->path[depth] = position.node;
+    finger->index[depth] = position.index;
+    for (int level = depth; level > 0; level--) {
+        Node* child = finger->path[level];
+        finger->path[level - 1] = child->parent;
+        finger->index[level - 1] = childIndex(child->parent, child);
+    }
+    finger->bound[0] = NULL;
+    for (int level = 0; level < depth; level++) {
+        Node* node = finger->path[level];
+        int index = finger->index[level];
+        finger->bound[level + 1] = (index < node->count ? getKey(map, node, index) : finger->bound[level]);
+    }
+}
+
+/**
+* Asks for all of the cache lines that a binary search in the node may read, so they are
+* loaded at once, instead of one after the other as the search reaches them.
+* Whether the node is a leaf is not known before it is loaded, so the longer header is assumed.
+* Nodes with large inline keys are only prefetched up to MAX_PREFETCH_LINES lines.
+*/
+static void prefetchNode(Map map, Node* node)
+{
+    size_t end = INTERNAL_HEADER_SIZE + MAX_KEYS * map->keySize;
+    if (end > MAX_PREFETCH_LINES * CACHE_LINE_SIZE) {
+        end = MAX_PREFETCH_LINES * CACHE_LINE_SIZE;
+    }
+    for (size_t offset = 0; offset < end; offset += CACHE_LINE_SIZE) {
+        PREFETCH((unsigned char*)node + offset);
+    }
+}
+
+/**
+* Asks for the key elements which a node of a map with copied keys points at, so the comparisons
+* of a search in the node do not wait for them one after the other. The node itself should be
+* loaded already.
+*/
+static void prefetchKeys(Map map, Node* node)
+{
+    for (int i = 0; i < node->count; i++) {
+        PREFETCH(getKey(map, node, i));
+    }
+}
+
+/**
+* Points position at the first pair whose key is not smaller than keyElement,
+* or greater than keyElement if upper is set.
+* Returns false (and invalidates position) if there is no such pair.
+*/
+static bool findBound(Map map, MapKeyElement keyElement, bool upper, Position* position)
+{
+    position->node = NULL;
+    position->index = 0;
+
+    Node* node = map->root;
+    while (node != NULL) {
+        bool found = false;
+        int index = upper ? findUpperIndex(map, node, keyElement) : findIndex(map, node, keyElement, &found);
+        if (index < node->count) { // the best candidate so far, deeper ones are closer to the key
+            position->node = node;
+            position->index = index;
+        }
+        if (found) {
+            return true;
+        }
+        node = node->is_leaf ? NULL : node->children[index];
+    }
+    return position->node != NULL;
+}
+
+static bool positionFirst(Map map, Position* position)
+{
+    Node* node = map->root;
+    if (node == NULL) {
+        position->node = NULL;
+        position->index = 0;
+        return false;
+    }
+    while (!node->is_leaf) {
+        node = node->children[0];
+    }
+    position->node = node;
+    position->index = 0;
+    return true;
+}
+
+static bool positionLast(Map map, Position* position)
+{
+    Node* node = map->root;
+    if (node == NULL) {
+        position->node = NULL;
+        position->index = 0;
+        return false;
+    }
+    while (!node->is_leaf) {
+        node = node->children[node->count];
+    }
+    position->node = node;
+    position->index = node->count - 1;
+    return true;
+}
+
+static bool positionNext(Position* position)
+{
+    Node* node = position->node;
+    if (node == NULL) {
+        return false;
+    }
+
+    if (!node->is_leaf) { // the successor is the leftmost key in the right subtree
+        node = node->children[position->index + 1];
+        while (!node->is_leaf) {
+            node = node->children[0];
+        }
+        position->node = node;
+        position->index = 0;
+        return true;
+    }
+
+    if (position->index + 1 < node->count) {
+        position->index++;
+        return true;
+    }
+
+    while (node->parent != NULL) { // climb until we come up from a left subtree
+        Node* parent = node->parent;
+        int index = childIndex(parent, node);
+        if (index < parent->count) {
+            position->node = parent;
+            position->index = index;
+            return true;
+        }
+        node = parent;
+    }
+
+    position->node = NULL;
+    return false;
+}
+
+static bool positionPrevious(Position* position)
+{
+    Node* node = position->node;
+    if (node == NULL) {
+        return false;
+    }
+
+    if (!node->is_leaf) { // the predecessor is the rightmost key in the left subtree
+        node = node->children[position->index];
+        while (!node->is_leaf) {
+            node = node->children[node->count];
+        }
+        position->node = node;
+        position->index = node->count - 1;
+        return true;
+    }
+
+    if (position->index > 0) {
+        position->index--;
+        return true;
+    }
+
+    while (node->parent != NULL) { // climb until we come up from a right subtree
+        Node* parent = node->parent;
+        int index = childIndex(parent, node);
+        if (index > 0) {
+            position->node = parent;
+            position->index = index - 1;
+            return true;
+        }
+        node = parent;
+    }
+
+    position->node = NULL;
+    return false;
+}
+
+/**
+* Checks whether keyElement belongs right next to the pair a valid hint points at.
+* If it does, returns true and sets position and found the same way findPosition does,
+* after at most two comparisons. Otherwise, returns false.
+*/
+static bool hintPosition(Map map, MapCursor* hint, MapKeyElement keyElement, Position* position, bool* found)
+{
+    Position at;
+    if (hint->map != map || !cursorPosition(hint, &at)) {
+        return false;
+    }
+
+    int result = map->compareKeyElements(keyElement, getKey(map, at.node, at.index));
+    if (result == 0) {
+        *position = at;
+        *found = true;
+        return true;
+    }
+
+    Position neighbour = at;
+    if (result > 0) {
+        if (positionNext(&neighbour)) {
+            result = map->compareKeyElements(keyElement, getKey(map, neighbour.node, neighbour.index));
+            if (result == 0) {
+                *position = neighbour;
+                *found = true;
+                return true;
+            }
+            if (result > 0) {
+                return false;
+            }
+        }
+        if (at.node->is_leaf) { // the empty slot right after the hint
+            at.index++;
+        }
+        else {
+            at.node = at.node->children[at.index + 1];
+            while (!at.node->is_leaf) {
+                at.node = at.node->children[0];
+            }
+            at.index = 0;
+        }
+    }
+    else {
+        if (positionPrevious(&neighbour)) {
+            result = map->compareKeyElements(keyElement, getKey(map, neighbour.node, neighbour.index));
+            if (result == 0) {
+                *position = neighbour;
+                *found = true;
+                return true;
+            }
+            if (result < 0) {
+                return false;
+            }
+        }
+        if (!at.node->is_leaf) { // the empty slot right before the hint
+            at.node = at.node->children[at.index];
+            while (!at.node->is_leaf) {
+                at.node = at.node->children[at.node->count];
+            }
+            at.index = at.node->count;
+        }
+    }
+
+    *position = at;
+    *found = false;
+    return true;
+}
+
+static void setCursor(Map map, MapCursor* cursor, Position position)
+{
+    cursor->map = map;
+    cursor->node = position.node;
+    cursor->index = position.index;
+    cursor->version = map->version;
+}
+
+/**
+* Checks that a cursor still points at a pair (and was not invalidated by changes to its map),
+* and if so, sets position to that pair.
+*/
+static bool cursorPosition(MapCursor* cursor, Position* position)
+{
+    if (cursor == NULL || cursor->map == NULL || cursor->node == NULL ||
+        cursor->version != cursor->map->version) {
+        return false;
+    }
+    position->node = (Node*)cursor->node;
+    position->index = cursor->index;
+    return true;
+}
+
+static void* keySlot(Map map, Node* node, int index)
+{
+    unsigned char* slots = (unsigned char*)node + (node->is_leaf ? LEAF_HEADER_SIZE : INTERNAL_HEADER_SIZE);
+    return slots + index * map->keySize;
+}
+
+static void* dataSlot(Map map, Node* node, int index)
+{
+    unsigned char* slots = (unsigned char*)node + (node->is_leaf ? LEAF_HEADER_SIZE : INTERNAL_HEADER_SIZE);
+    return slots + map->dataOffset + index * map->dataSize;
+}
+
+static MapKeyElement getKey(Map map, Node* node, int index)
+{
+    void* slot = keySlot(map, node, index);
+    return map->is_inline ? slot : *(MapKeyElement*)slot;
+}
+
+static MapDataElement getData(Map map, Node* node, int index)
+{
+    void* slot = dataSlot(map, node, index);
+    return map->is_inline ? slot : *(MapDataElement*)slot;
+}
+
+/**
+* Stores a pair in a slot: the pointers themselves (which the node then owns),
+* or in an inline map, the bytes they point at.
+*/
+static void setEntry(Map map, Node* node, int index, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    if (map->is_inline) {
+        memcpy(keySlot(map, node, index), keyElement, map->keySize);
+        memcpy(dataSlot(map, node, index), dataElement, map->dataSize);
+    }
+    else {
+        *(MapKeyElement*)keySlot(map, node, index) = keyElement;
+        *(MapDataElement*)dataSlot(map, node, index) = dataElement;
+    }
+}
+
+static void copyEntry(Map map, Node* destination, int to, Node* source, int from)
+{
+    memcpy(keySlot(map, destination, to), keySlot(map, source, from), map->keySize);
+    memcpy(dataSlot(map, destination, to), dataSlot(map, source, from), map->dataSize);
+}
+
+static void moveEntries(Map map, Node* destination, int to, Node* source, int from, int count)
+{
+    memmove(keySlot(map, destination, to), keySlot(map, source, from), count * map->keySize);
+    memmove(dataSlot(map, destination, to), dataSlot(map, source, from), count * map->dataSize);
+}
+
+static void freeElements(Map map, Node* node, int index)
+{
+    if (!map->is_inline) {
+        map->freeDataElement(getData(map, node, index));
+        freeKey(map, getKey(map, node, index));
+    }
+}
+
+static void insertGap(Map map, Node* node, int index)
+{
+    moveEntries(map, node, index + 1, node, index, node->count - index);
+    node->count++;
+}
+
+static void removeEntry(Map map, Node* node, int index)
+{
+    moveEntries(map, node, index, node, index + 1, node->count - index - 1);
+    node->count--;
+}
+
+/**
+* Inserts an already copied key-data pair at a leaf slot, splitting full nodes on the way up,
+* and moves position to where the pair ended up after the splits.
+* All of the nodes the splits need are allocated in advance, so on allocation failure
+* the tree is left untouched and false is returned.
+*/
+static bool insertElement(Map map, Position* position, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    if (map->filter != NULL) { // if the insertion fails, the hash stays, which only costs false positives
+        filterKey(map, keyElement);
+    }
+    if (position->node == NULL) { // map was empty, adding its root
+        Node* root = createNode(map, true);
+        if (root == NULL) {
+            return false;
+        }
+        insertGap(map, root, 0);
+        setEntry(map, root, 0, keyElement, dataElement);
+        root->size = 1;
+        map->root = root;
+        map->size++;
+        map->version++;
+        position->node = root;
+        position->index = 0;
+        return true;
+    }
+
+    Node* spare[MAX_TREE_HEIGHT + 1];
+    int needed = 0;
+    for (Node* node = position->node; node != NULL && node->count == MAX_KEYS; node = node->parent) {
+        spare[needed] = createNode(map, node->is_leaf);
+        if (spare[needed] == NULL) {
+            while (needed > 0) {
+                free(spare[--needed]);
+            }
+            return false;
+        }
+        needed++;
+        if (node->parent == NULL) { // the root is split as well, so the tree grows a new root
+            spare[needed] = createNode(map, false);
+            if (spare[needed] == NULL) {
+                while (needed > 0) {
+                    free(spare[--needed]);
+                }
+                return false;
+            }
+            needed++;
+        }
+    }
+
+    Node* node = position->node;
+    insertGap(map, node, position->index);
+    setEntry(map, node, position->index, keyElement, dataElement);
+    for (Node* ancestor = node; ancestor != NULL; ancestor = ancestor->parent) {
+        ancestor->size++;
+    }
+    int next = 0;
+    while (node->count > MAX_KEYS) {
+        Node* right = spare[next++];
+        if (node->parent == NULL) {
+            Node* root = spare[next++];
+            root->children[0] = node;
+            root->size = node->size;
+            node->parent = root;
+            map->root = root;
+        }
+        int median = node->count / 2;
+        splitNode(map, node, right);
+        if (position->node == node && position->index == median) {
+            position->node = node->parent;
+            position->index = childIndex(node->parent, node);
+        }
+        else if (position->node == node && position->index > median) {
+            position->node = right;
+            position->index -= median + 1;
+        }
+        node = node->parent;
+    }
+
+    map->size++;
+    map->version++;
+    return true;
+}
+
+/**
+* Moves the upper half of an overflowing node into right,
+* and the median pair up into the parent (with right as the child after it).
+*/
+static void splitNode(Map map, Node* node, Node* right)
+{
+    Node* parent = node->parent;
+    int median = node->count / 2;
+
+    right->count = node->count - median - 1;
+    right->size = right->count;
+    moveEntries(map, right, 0, node, median + 1, right->count);
+    if (!node->is_leaf) {
+        memcpy(right->children, &node->children[median + 1], (right->count + 1) * sizeof(Node*));
+        for (int i = 0; i <= right->count; i++) {
+            right->children[i]->parent = right;
+            right->size += right->children[i]->size;
+        }
+    }
+    node->count = median;
+    node->size -= right->size + 1;
+    right->parent = parent;
+
+    int index = childIndex(parent, node);
+    memmove(&parent->children[index + 2], &parent->children[index + 1], (parent->count - index) * sizeof(Node*));
+    parent->children[index + 1] = right;
+    insertGap(map, parent, index);
+    copyEntry(map, parent, index, node, median);
+}
+
+/**
+* Unlinks the pair at position from the tree (without freeing its elements),
+* and restores the B-tree invariants.
+* Returns whether any node besides the one the pair was unlinked from was changed.
+*/
+static bool removeElement(Map map, Position position)
+{
+    Node* node = position.node;
+    if (node->is_leaf) {
+        removeEntry(map, node, position.index);
+    }
+    else { // replace it with its predecessor, which always sits at the end of a leaf
+        Node* leaf = node->children[position.index];
+        while (!leaf->is_leaf) {
+            leaf = leaf->children[leaf->count];
+        }
+        copyEntry(map, node, position.index, leaf, leaf->count - 1);
+        leaf->count--;
+        node = leaf;
+    }
+    for (Node* ancestor = node; ancestor != NULL; ancestor = ancestor->parent) {
+        ancestor->size--;
+    }
+
+    map->size--;
+    return rebalance(map, node);
+}
+
+/**
+* Frees and removes the pair at position, and moves position to the pair that followed it.
+* The successor is usually found without comparisons, and only when the removal
+* restructured the tree is it searched for again.
+*/
+static void removeAndAdvance(Map map, Position* position)
+{
+    Position next = *position;
+    bool has_next = positionNext(&next);
+    MapKeyElement next_key = has_next ? getKey(map, next.node, next.index) : NULL;
+    if (has_next && map->is_inline) { // the key itself is about to move around
+        memcpy(map->keyBuffer, next_key, map->keySize);
+        next_key = map->keyBuffer;
+    }
+
+    freeElements(map, position->node, position->index);
+    bool restructured = removeElement(map, *position);
+
+    if (!has_next) {
+        position->node = NULL;
+    }
+    else if (restructured) {
+        findPosition(map, next_key, position);
+    }
+    else if (next.node == position->node) { // it was shifted into the removed slot
+        position->index = next.index - 1;
+    }
+    else {
+        *position = next;
+    }
+}
+
+/**
+* Fixes a node which may have too few pairs, by borrowing from or merging with its siblings.
+* Returns whether any node was changed.
+*/
+static bool rebalance(Map map, Node* node)
+{
+    bool changed = false;
+    while (node->parent != NULL && node->count < MIN_KEYS) {
+        Node* parent = node->parent;
+        int index = childIndex(parent, node);
+        if (index > 0 && parent->children[index - 1]->count > MIN_KEYS) {
+            rotateRight(map, parent, index - 1);
+            return true;
+        }
+        if (index < parent->count && parent->children[index + 1]->count > MIN_KEYS) {
+            rotateLeft(map, parent, index);
+            return true;
+        }
+        mergeChildren(map, parent, index > 0 ? index - 1 : index);
+        node = parent;
+        changed = true;
+    }
+
+    if (node->parent == NULL && node->count == 0) { // the root ran out of keys
+        map->root = node->is_leaf ? NULL : node->children[0];
+        if (map->root != NULL) {
+            map->root->parent = NULL;
+        }
+        free(node);
+        changed = true;
+    }
+    return changed;
+}
+
+/**
+* Moves the separator at index down into its right child,
+* and the last pair of its left child up in its place.
+*/
+static void rotateRight(Map map, Node* parent, int index)
+{
+    Node* left = parent->children[index];
+    Node* right = parent->children[index + 1];
+
+    int moved = 1;
+    if (!right->is_leaf) {
+        memmove(&right->children[1], &right->children[0], (right->count + 1) * sizeof(Node*));
+        right->children[0] = left->children[left->count];
+        right->children[0]->parent = right;
+        moved += right->children[0]->size;
+    }
+    insertGap(map, right, 0);
+    copyEntry(map, right, 0, parent, index);
+    right->size += moved;
+    left->size -= moved;
+
+    copyEntry(map, parent, index, left, left->count - 1);
+    left->count--;
+}
+
+/**
+* Moves the separator at index down into its left child,
+* and the first pair of its right child up in its place.
+*/
+static void rotateLeft(Map map, Node* parent, int index)
+{
+    Node* left = parent->children[index];
+    Node* right = parent->children[index + 1];
+
+    int moved = 1;
+    insertGap(map, left, left->count);
+    copyEntry(map, left, left->count - 1, parent, index);
+    if (!left->is_leaf) {
+        left->children[left->count] = right->children[0];
+        left->children[left->count]->parent = left;
+        moved += left->children[left->count]->size;
+        memmove(&right->children[0], &right->children[1], right->count * sizeof(Node*));
+    }
+    left->size += moved;
+    right->size -= moved;
+
+    copyEntry(map, parent, index, right, 0);
+    removeEntry(map, right, 0);
+}
+
+/**
+* Merges the children at index and index + 1 (together with their separator) into one node.
+*/
+static void mergeChildren(Map map, Node* parent, int index)
+{
+    Node* left = parent->children[index];
+    Node* right = parent->children[index + 1];
+
+    insertGap(map, left, left->count);
+    copyEntry(map, left, left->count - 1, parent, index);
+    moveEntries(map, left, left->count, right, 0, right->count);
+    if (!left->is_leaf) {
+        memcpy(&left->children[left->count], right->children, (right->count + 1) * sizeof(Node*));
+        for (int i = 0; i <= right->count; i++) {
+            right->children[i]->parent = left;
+        }
+    }
+    left->count += right->count;
+    left->size += right->size + 1;
+
+    removeEntry(map, parent, index);
+    memmove(&parent->children[index + 1], &parent->children[index + 2], (parent->count - index) * sizeof(Node*));
+    free(right);
+}
+
+/**
+* Returns the copy of a key which the map keeps: the pool's string in an interned map,
+* or a new copy otherwise. Returns NULL if an allocation failed.
+*/
+static MapKeyElement copyKey(Map map, MapKeyElement keyElement)
+{
+    if (map->pool != NULL) {
+        return (MapKeyElement)internPoolIntern(map->pool, keyElement);
+    }
+    return map->copyKeyElement(keyElement);
+}
+
+static void freeKey(Map map, MapKeyElement keyElement)
+{
+    if (map->pool == NULL) { // the pool's strings are freed with the pool
+        map->freeKeyElement(keyElement);
+    }
+}
+
+/**
+* Interned keys are equal only if they are the same string, so comparing a key with itself
+* costs nothing, and strcmp is left for the keys which are different.
+*/
+static int compareInternedKeys(MapKeyElement keyElement1, MapKeyElement keyElement2)
+{
+    return (keyElement1 == keyElement2 ? 0 : strcmp((const char*)keyElement1, (const char*)keyElement2));
 }
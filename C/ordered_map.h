@@ -2,6 +2,12 @@
 #define ORDERED_MAP_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+
+// declared again here, so the map does not pull in intern_pool.h and bloom_filter.h
+// (include them to create a pool or to read the fields of the filter statistics)
+typedef struct intern_pool_t * InternPool;
+typedef struct bloom_filter_statistics_t BloomFilterStatistics;
 
 /**
 * A Generic Ordered-Map Container (ADT)
@@ -11,23 +17,70 @@
 * The keys are ordered using a compare function given by the user.
 * The map also has an internal iterator.
 *
+* The pairs are stored in a B-tree of wide nodes, so searching, inserting and removing
+* a key all take O(log n) comparisons, and iterating over the map visits the keys in order.
+*
+* A map created with mapCreateInline stores fixed-size keys and data by value inside the
+* B-tree's nodes, instead of pointers to copies of them. Such a map needs no copy and free
+* functions, and the pairs cost no allocations of their own.
+*
+* A map created with mapCreateInterned has string keys which are kept once in an InternPool,
+* which may be shared by many maps and sets, instead of a copy of the key for every put.
+*
+* A map of any kind can keep a Bloom filter of its keys (see mapEnableFilter), and then most
+* lookups of keys which are not in the map are answered without searching the B-tree.
+*
 * The ADT provides the following methods:
 *   mapCreate
+*   mapCreateInline
+*   mapCreateInterned
+*   mapCreateFromArrays
 *   mapDestroy
 *   mapCopy
 *   mapGetSize
-*   mapContains   - NOTE: Resets the internal iterator.
+*   mapGetCompareFunction
+*   mapContains   - NOTE: Iterator status unchanged.
 *   mapPut		    - NOTE: Resets the internal iterator.
+*   mapPutHint    - NOTE: Resets the internal iterator.
+*   mapPutTake    - NOTE: Resets the internal iterator.
+*   mapPutMany    - NOTE: Resets the internal iterator.
+*   mapFind       - NOTE: Iterator status unchanged.
 *   mapGet  	    - NOTE: Iterator status unchanged.
+*   mapGetMany    - NOTE: Iterator status unchanged.
 *   mapRemove		  - NOTE: Resets the internal iterator.
+*   mapExtract    - NOTE: Resets the internal iterator.
 *   mapGetFirst
 *   mapGetNext
 *   mapClear
+*   mapCursorFirst
+*   mapCursorLast
+*   mapCursorNext
+*   mapCursorPrevious
+*   mapCursorGetKey
+*   mapCursorGetData
+*   mapForEach
+*   mapLowerBound
+*   mapUpperBound
+*   mapRangeForEach
+*   mapRemoveRange  - NOTE: Resets the internal iterator.
+*   mapGetByRank
+*   mapRank
+*   mapMerge        - NOTE: Resets the internal iterator.
+*   mapDifference
+*   mapIntersectKeys
+*   mapEnableFilter
+*   mapGetFilterStatistics
 *
 *   MAP_FOREACH	- A macro for iterating over the map's elements.
 *
 *   NOTE: the "put" and "copy" methods create copies of the elements,
 *         while all of the "get" methods return the elements in the map (and not another copies).
+*         mapPutTake and mapExtract move elements into and out of the map without copying them.
+*
+*   NOTE: the cursor methods and mapForEach do not touch the internal iterator,
+*         so any number of them may scan the same map at once, as long as it is not modified.
+*         Lookups in a filtered map count their results in the filter's statistics,
+*         which are atomic, so they may also run at once with each other and with the scans.
 */
 
 // ============================ TYPEDEFS ============================ //
@@ -38,12 +91,35 @@ typedef enum MapResult_t {
     MAP_OUT_OF_MEMORY,
     MAP_NULL_ARGUMENT,
     MAP_ITEM_ALREADY_EXISTS,
-    MAP_ITEM_DOES_NOT_EXIST
+    MAP_ITEM_DOES_NOT_EXIST,
+    MAP_FILE_ERROR // a file could not be opened, read or written (see mapped_map.h)
 } MapResult;
 
+/**
+* What mapMerge does with a key which is in both maps.
+*/
+typedef enum MapMergePolicy_t {
+    MAP_MERGE_KEEP_DESTINATION, // keep the destination's pair
+    MAP_MERGE_TAKE_SOURCE       // replace it with a copy of the source's pair
+} MapMergePolicy;
+
 typedef void * MapDataElement;
 typedef void * MapKeyElement;
 
+/**
+* A cursor pointing at a key-data pair in the map.
+* Cursors are returned by lookups (such as mapFind) and can be given back to mapPutHint as a hint.
+* The fields are private, and should not be accessed directly.
+* NOTE: Adding or removing pairs invalidates every existing cursor of the map,
+*       and an invalidated cursor is detected and ignored when it is given as a hint.
+*/
+typedef struct map_cursor_t {
+    Map map;
+    void* node;
+    int index;
+    unsigned long version;
+} MapCursor;
+
 typedef MapDataElement(*copyMapDataElements)(MapDataElement);
 typedef MapKeyElement(*copyMapKeyElements)(MapKeyElement);
 
@@ -51,6 +127,13 @@ typedef void(*freeMapDataElements)(MapDataElement);
 typedef void(*freeMapKeyElements)(MapKeyElement);
 
 
+/**
+* The function type that visits the pairs in mapForEach.
+*   - Returns true to continue to the next pair.
+*   - Returns false to stop the iteration.
+*/
+typedef bool(*visitMapElements)(MapKeyElement, MapDataElement, void* context);
+
 /**
 * The function type that compare keys and keep the map ordered.
 *   - Returns a positive number is the first key element is greater.
@@ -59,6 +142,18 @@ typedef void(*freeMapKeyElements)(MapKeyElement);
 */
 typedef int(*compareMapKeyElements)(MapKeyElement, MapKeyElement);
 
+/**
+* The function type that hashes keys, for the containers which are built on top of the map
+* and for the map's Bloom filter. Equal keys (according to the compare function) must have equal hashes.
+*/
+typedef size_t(*hashMapKeyElements)(MapKeyElement);
+
+/**
+* The function type that returns the number of bytes of a flat element (one whose bytes are all
+* of its content, with no pointers), for the snapshots of a map which copy its elements by bytes.
+*/
+typedef size_t(*sizeMapElements)(void*);
+
 
 // ============================ FUNCTIONS ============================ //
 /**
@@ -86,8 +181,72 @@ Map mapCreate(copyMapDataElements   copyDataElement,
 */
 void mapDestroy(Map map);
 
+/**
+* mapCreateInline: Allocates and returns a new empty map which stores its keys and data by value.
+* Every key is keySize bytes long and every data element is dataSize bytes long. Putting a pair
+* copies that many bytes from the given pointers into the map, and the compare function is given
+* pointers to the stored keys.
+* NOTE: The elements returned by the "get" and cursor methods point into the map's nodes,
+*       so they are only valid until the next pair is added to or removed from the map.
+*
+* @param keySize            - The size of a key element in bytes.
+* @param dataSize           - The size of a data element in bytes.
+* @param compareKeyElements - A Function pointer for comparing key elements.
+* @return
+* 	NULL - if one of the sizes is 0, the compare function is NULL or if allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateInline(size_t keySize, size_t dataSize, compareMapKeyElements compareKeyElements);
+
+/**
+* mapCreateInterned: Allocates and returns a new empty map whose keys are NUL-terminated strings,
+* ordered the same way as strcmp orders them. Instead of a copy of every put key, the map keeps
+* the pool's copy of it, which is not freed when the pair is removed, and two keys of the map
+* are compared without strcmp when they are the same string.
+* NOTE: mapPutTake takes only the data element in such a map, and mapExtract gives the pool's
+*       string as the key, which must not be freed.
+*
+* @param pool - The pool to intern the keys in. It must outlive the map.
+* @param copyDataElement - A Function pointer for copying data elements.
+* @param freeDataElement - A Function pointer for removing data elements.
+* @return
+* 	NULL - if one of the parameters is NULL or if allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateInterned(InternPool pool, copyMapDataElements copyDataElement, freeMapDataElements freeDataElement);
+
+/**
+* mapCreateFromArrays: Allocates and returns a new map holding COPIES of the given key-data pairs.
+* The pairs are sorted (by several threads, if there are many of them), and the map
+* is then built directly from the sorted pairs, which takes O(n log n) time, or O(n) if they
+* were already sorted. If a key appears more than once, the last of its pairs is kept,
+* the same as if the pairs were put one after the other.
+*
+* @param keyElements - An array of the key elements.
+* @param dataElements - An array of the data elements, dataElements[i] is paired with keyElements[i].
+* @param size - The number of pairs in the arrays.
+* @param copyDataElement    - A Function pointer for copying data elements.
+* @param copyKeyElement     - A Function pointer for copying key elements.
+* @param freeDataElement    - A Function pointer for removing data elements.
+* @param freeKeyElement     - A Function pointer for removing key elements.
+* @param compareKeyElements - A Function pointer for comparing key elements.
+* @param sorted - Whether the keys are already in ascending order. This is verified, and
+*                 the pairs are sorted anyway if it turns out to be wrong.
+* @return
+* 	NULL - if one of the parameters (or elements) is NULL or if allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateFromArrays(MapKeyElement* keyElements, MapDataElement* dataElements, int size,
+                        copyMapDataElements   copyDataElement,
+                        copyMapKeyElements    copyKeyElement,
+                        freeMapDataElements   freeDataElement,
+                        freeMapKeyElements    freeKeyElement,
+                        compareMapKeyElements compareKeyElements,
+                        bool sorted);
+
 /**
 * mapCopy: Creates a copy of target map.
+* The copy is made node by node in linear time, without searching for any key.
 * NOTE: Iterator values for both maps is undefined after this operation.
 *
 * @param map - Target map.
@@ -107,6 +266,16 @@ Map mapCopy(Map map);
 */
 int mapGetSize(Map map);
 
+/**
+* mapGetCompareFunction: Returns the function which compares the keys of a map.
+*
+* @param map - The map whose compare function is requested.
+* @return
+* 	NULL if a NULL pointer was sent.
+* 	Otherwise, the compare function given when the map was created.
+*/
+compareMapKeyElements mapGetCompareFunction(Map map);
+
 /**
 * mapContains: Checks if a key element exists in the map.
 *
@@ -132,6 +301,78 @@ bool mapContains(Map map, MapKeyElement element);
 */
 MapResult mapPut(Map map, MapKeyElement keyElement, MapDataElement dataElement);
 
+/**
+*	mapPutHint: Puts in the map a COPY of the given key-data pair, starting the search from a hint.
+* If the key belongs right next to the pair the hint points at, the pair is put there
+* using a constant number of comparisons. Otherwise, this is the same as mapPut.
+* On success the hint is moved to the put pair, so sequential or clustered puts can reuse it.
+* NOTE: Iterator's value is undefined after this operation.
+*
+* @param map - The map for which to reassign the data element.
+* @param hint - A cursor returned by a previous lookup. An invalidated cursor is ignored.
+* @param keyElement - The key element which need to be reassigned.
+* @param dataElement - The new data element to associate with the given key.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as one of the parameters.
+* 	MAP_OUT_OF_MEMORY if an allocation failed (Meaning the function for copying an element failed).
+* 	MAP_SUCCESS if the paired elements had been inserted successfully.
+*/
+MapResult mapPutHint(Map map, MapCursor* hint, MapKeyElement keyElement, MapDataElement dataElement);
+
+/**
+*	mapPutTake: Puts in the map the given key-data pair itself (NOT a copy), and takes ownership of it.
+* The map frees the elements with its free functions once they are removed, so the caller must not
+* use or free them after a successful call. If the map already has an equal key, the given
+* data element replaces the old one, and the given key element is freed.
+* In an inline map, this is the same as mapPut. In an interned map, only the data element is taken,
+* and the key is interned like in mapPut (so it still belongs to the caller).
+* NOTE: Iterator's value is undefined after this operation.
+*
+* @param map - The map for which to reassign the data element.
+* @param keyElement - The key element which need to be reassigned.
+* @param dataElement - The new data element to associate with the given key.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as one of the parameters.
+* 	MAP_OUT_OF_MEMORY if an allocation failed (the elements still belong to the caller then).
+* 	MAP_SUCCESS if the paired elements had been inserted successfully.
+*/
+MapResult mapPutTake(Map map, MapKeyElement keyElement, MapDataElement dataElement);
+
+/**
+*	mapPutMany: Puts in the map COPIES of a batch of key-data pairs.
+* All of the keys are first searched together, the same as in mapGetMany, and the data of the
+* keys which are in the map is replaced in place. Then the new keys are sorted (unless they
+* already are) and inserted, every search starting from where the previous one ended.
+* If a key appears more than once, the last of its pairs is kept, the same as with repeated mapPut.
+* In a filtered map, the keys which the filter rules out are known to be new, so they are left out
+* of the batch search, and the search counts its results in the filter's statistics.
+* NOTE: Iterator's value is undefined after this operation.
+*
+* @param map - The map to put the pairs in.
+* @param keyElements - An array of the key elements.
+* @param dataElements - An array of the data elements, dataElements[i] is paired with keyElements[i].
+* @param size - The number of pairs in the arrays.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as one of the parameters (or elements), or size is negative.
+* 	MAP_OUT_OF_MEMORY if an allocation failed. Some of the pairs may have been put by then.
+* 	MAP_SUCCESS if all of the pairs had been inserted successfully.
+*/
+MapResult mapPutMany(Map map, MapKeyElement* keyElements, MapDataElement* dataElements, int size);
+
+/**
+*	mapFind: Points a cursor at the pair with the given key.
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to search in.
+* @param keyElement - The key element to look for.
+* @param cursor - The cursor to point at the found pair.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as one of the parameters.
+*   MAP_ITEM_DOES_NOT_EXIST if the map does not contain the requested key.
+* 	MAP_SUCCESS if the key was found.
+*/
+MapResult mapFind(Map map, MapKeyElement keyElement, MapCursor* cursor);
+
 /**
 *	mapGet: Returns the data associated with a specific key in the map.
 *	NOTE: Iterator status unchanged
@@ -144,6 +385,26 @@ MapResult mapPut(Map map, MapKeyElement keyElement, MapDataElement dataElement);
 */
 MapDataElement mapGet(Map map, MapKeyElement keyElement);
 
+/**
+*	mapGetMany: Looks up a batch of keys, the same as calling mapGet on each of them.
+* The keys are searched together, one level of the tree at a time: the keys which go down to
+* the same node share its search, and the nodes of the next level are prefetched while the
+* current one is searched, so the cache misses of different keys overlap. The compare function
+* is still called about as many times as in separate lookups.
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to get the data elements from.
+* @param keyElements - An array of the key elements to look up.
+* @param size - The number of keys in the array.
+* @param dataElements - An array of size elements, where dataElements[i] is set to the data
+*                       element of keyElements[i] (not a copy!), or to NULL if it is not in the map.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as one of the parameters (or keys), or size is negative.
+* 	MAP_OUT_OF_MEMORY if an allocation failed.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult mapGetMany(Map map, MapKeyElement* keyElements, int size, MapDataElement* dataElements);
+
 /**
 * mapRemove: Removes a pair of key and data elements from the map.
 * NOTE: Iterator's value is undefined after this operation.
@@ -157,6 +418,24 @@ MapDataElement mapGet(Map map, MapKeyElement keyElement);
 */
 MapResult mapRemove(Map map, MapKeyElement keyElement);
 
+/**
+* mapExtract: Removes a pair of key and data elements from the map without freeing them,
+* and hands them over to the caller (who should free them later).
+* In an inline map, the elements' bytes are copied into the buffers *keyOut and *dataOut point at.
+* In an interned map, *keyOut is set to the pool's string, which belongs to the pool.
+* NOTE: Iterator's value is undefined after this operation.
+*
+* @param map - The map to remove the elements from.
+* @param keyElement - The key element to find and remove from the map.
+* @param keyOut - Set to the removed key element. If NULL, the key element is freed instead.
+* @param dataOut - Set to the removed data element. If NULL, the data element is freed instead.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or keyElement (or as a buffer of an inline map).
+*   MAP_ITEM_DOES_NOT_EXIST if an equal key item does not already exists in the map.
+* 	MAP_SUCCESS if the paired elements had been removed successfully.
+*/
+MapResult mapExtract(Map map, MapKeyElement keyElement, MapKeyElement* keyOut, MapDataElement* dataOut);
+
 /**
 *	mapGetFirst: Sets the internal iterator (also called current key element) to the first key element in the map.
 *	Use this to start iterating over the map.
@@ -164,7 +443,7 @@ MapResult mapRemove(Map map, MapKeyElement keyElement);
 * @param map - The map for which to set the iterator and return the first key element.
 * @return
 * 	NULL if a NULL pointer was sent or the map is empty.
-* 	Otherwise, return the first key element of the map.
+* 	Otherwise, return the first key element of the map (not a copy!).
 */
 MapKeyElement mapGetFirst(Map map);
 
@@ -174,10 +453,254 @@ MapKeyElement mapGetFirst(Map map);
 * @param map - The map for which to advance the iterator
 * @return
 * 	NULL if reached the end of the map, or the iterator is at an invalid state or a NULL sent as argument
-* 	Otherwise, return the next key element on the map.
+* 	Otherwise, return the next key element on the map (not a copy!).
 */
 MapKeyElement mapGetNext(Map map);
 
+/**
+*	mapCursorFirst: Points a cursor at the first pair in the map.
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to iterate over.
+* @param cursor - The cursor to point at the first pair.
+* @return
+* 	false if a NULL pointer was sent or the map is empty (the cursor is invalid then).
+* 	true otherwise.
+*/
+bool mapCursorFirst(Map map, MapCursor* cursor);
+
+/**
+*	mapCursorLast: Points a cursor at the last pair in the map.
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to iterate over.
+* @param cursor - The cursor to point at the last pair.
+* @return
+* 	false if a NULL pointer was sent or the map is empty (the cursor is invalid then).
+* 	true otherwise.
+*/
+bool mapCursorLast(Map map, MapCursor* cursor);
+
+/**
+*	mapCursorNext: Advances a cursor to the next pair in the map.
+*
+* @param cursor - The cursor to advance.
+* @return
+* 	false if the cursor was invalid, NULL, or reached the end of the map (the cursor is invalid then).
+* 	true otherwise.
+*/
+bool mapCursorNext(MapCursor* cursor);
+
+/**
+*	mapCursorPrevious: Moves a cursor back to the previous pair in the map.
+*
+* @param cursor - The cursor to move.
+* @return
+* 	false if the cursor was invalid, NULL, or passed the beginning of the map (the cursor is invalid then).
+* 	true otherwise.
+*/
+bool mapCursorPrevious(MapCursor* cursor);
+
+/**
+*	mapCursorGetKey: Returns the key element a cursor points at.
+*
+* @param cursor - The cursor to read.
+* @return
+* 	NULL if the cursor is NULL or invalid.
+* 	Otherwise, return the key element in the map (not a copy!).
+*/
+MapKeyElement mapCursorGetKey(MapCursor* cursor);
+
+/**
+*	mapCursorGetData: Returns the data element a cursor points at.
+*
+* @param cursor - The cursor to read.
+* @return
+* 	NULL if the cursor is NULL or invalid.
+* 	Otherwise, return the data element in the map (not a copy!).
+*/
+MapDataElement mapCursorGetData(MapCursor* cursor);
+
+/**
+*	mapForEach: Calls a function on every pair in the map, in order, until it returns false.
+* The elements are passed as they are in the map (and not copies), and must not be modified
+* in a way which changes their order. The function must not add or remove pairs.
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to iterate over.
+* @param visit - The function to call on each pair.
+* @param context - A parameter passed as is to every call of visit.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or visit.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult mapForEach(Map map, visitMapElements visit, void* context);
+
+/**
+*	mapLowerBound: Points a cursor at the first pair whose key is not smaller than the given key.
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to search in.
+* @param keyElement - The key element to compare with.
+* @param cursor - The cursor to point at the found pair.
+* @return
+* 	false if a NULL pointer was sent or all of the keys are smaller (the cursor is invalid then).
+* 	true otherwise.
+*/
+bool mapLowerBound(Map map, MapKeyElement keyElement, MapCursor* cursor);
+
+/**
+*	mapUpperBound: Points a cursor at the first pair whose key is greater than the given key.
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to search in.
+* @param keyElement - The key element to compare with.
+* @param cursor - The cursor to point at the found pair.
+* @return
+* 	false if a NULL pointer was sent or none of the keys are greater (the cursor is invalid then).
+* 	true otherwise.
+*/
+bool mapUpperBound(Map map, MapKeyElement keyElement, MapCursor* cursor);
+
+/**
+*	mapRangeForEach: Calls a function on every pair whose key is in [low, high), in order,
+* until it returns false. Takes O(log n) comparisons to find the range, plus one per visited pair.
+* The same rules as in mapForEach apply to the function.
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to iterate over.
+* @param low - The smallest key to visit, or NULL to start from the first pair.
+* @param high - The key to stop before, or NULL to continue to the last pair.
+* @param visit - The function to call on each pair.
+* @param context - A parameter passed as is to every call of visit.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or visit.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult mapRangeForEach(Map map, MapKeyElement low, MapKeyElement high,
+                          visitMapElements visit, void* context);
+
+/**
+*	mapRemoveRange: Removes every pair whose key is in [low, high).
+* Takes O(log n) comparisons to find the range. Moving on to the next pair in the range
+* needs no search unless the removal rebalanced the tree, so most removals cost a single comparison.
+*	NOTE: Iterator's value is undefined after this operation.
+*
+* @param map - The map to remove the pairs from.
+* @param low - The smallest key to remove, or NULL to start from the first pair.
+* @param high - The key to stop before, or NULL to continue to the last pair.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult mapRemoveRange(Map map, MapKeyElement low, MapKeyElement high);
+
+/**
+*	mapGetByRank: Returns the key element at a given position in the order of the map
+* (the k-th smallest key), in O(log n) time.
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to search in.
+* @param rank - The zero based position of the requested key (0 is the smallest one).
+* @return
+* 	NULL if a NULL pointer was sent or rank is not between 0 and the map's size - 1.
+* 	Otherwise, return the key element in the map (not a copy!).
+*/
+MapKeyElement mapGetByRank(Map map, int rank);
+
+/**
+*	mapRank: Returns the number of keys in the map which are smaller than the given key,
+* which is also its rank if it is in the map. Takes O(log n) comparisons.
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to search in.
+* @param keyElement - The key element to rank, it does not have to be in the map.
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise, return the number of smaller keys in the map.
+*/
+int mapRank(Map map, MapKeyElement keyElement);
+
+/**
+*	mapMerge: Puts copies of all of the pairs of the source map in the destination map.
+* If both maps use the same compare function (and the same kind of storage), they are merged in
+* a single pass over both of them, and the destination's tree is rebuilt from the result,
+* which takes O(n + m) time. Otherwise, the pairs are put one by one.
+* NOTE: Iterator's value is undefined after this operation.
+*
+* @param destination - The map to put the pairs in.
+* @param source - The map whose pairs are copied. It is not modified.
+* @param policy - What to do with a key which is in both maps.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as one of the maps.
+* 	MAP_OUT_OF_MEMORY if an allocation failed. After a single pass merge the destination
+*                     is then left untouched, otherwise only some of the pairs were put.
+* 	MAP_SUCCESS if the maps had been merged successfully.
+*/
+MapResult mapMerge(Map destination, Map source, MapMergePolicy policy);
+
+/**
+*	mapDifference: Creates a new map with copies of the pairs of map1 whose keys are not in map2.
+* If both maps use the same compare function, this takes a single O(n + m) pass over them.
+*	NOTE: Iterator status unchanged
+*
+* @param map1 - The map whose pairs are copied.
+* @param map2 - The map whose keys are left out. Its data elements are ignored.
+* @return
+* 	NULL if a NULL was sent as one of the maps or a memory allocation failed.
+* 	Otherwise, a new Map of the same kind as map1.
+*/
+Map mapDifference(Map map1, Map map2);
+
+/**
+*	mapIntersectKeys: Creates a new map with copies of the pairs of map1 whose keys are also in map2.
+* If both maps use the same compare function, this takes a single O(n + m) pass over them.
+*	NOTE: Iterator status unchanged
+*
+* @param map1 - The map whose pairs are copied.
+* @param map2 - The map whose keys are kept. Its data elements are ignored.
+* @return
+* 	NULL if a NULL was sent as one of the maps or a memory allocation failed.
+* 	Otherwise, a new Map of the same kind as map1.
+*/
+Map mapIntersectKeys(Map map1, Map map2);
+
+/**
+*	mapEnableFilter: Makes a map keep a Bloom filter of the hashes of its keys, so that
+* mapContains, mapGet, mapFind, mapRemove and mapExtract of a key which is not in the map
+* usually return right away, without searching the B-tree. mapGetMany and mapPutMany leave
+* such keys out of their search the same way.
+* The filter is sized for expectedSize keys, and once more keys were put in the map it is
+* rebuilt for twice as many. Copies of the map (and the maps made from it) keep a filter as well.
+* The lookups count their results in the filter (see mapGetFilterStatistics); the counters are
+* relaxed atomics, so lookups from many threads at once stay safe, but each one writes to them.
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map to filter. If it already has a filter, the filter is replaced.
+* @param hashKeyElement - A Function pointer for hashing key elements.
+* @param expectedSize - The number of keys the filter is sized for.
+* @param falsePositiveRate - The rate of lookups of missing keys which still search the B-tree, between 0 and 1.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL was sent as map or hashKeyElement,
+* 		or if expectedSize is not positive or the rate is not between 0 and 1.
+* 	MAP_OUT_OF_MEMORY - if a memory allocation failed, and then the map is left as it was.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult mapEnableFilter(Map map, hashMapKeyElements hashKeyElement, int expectedSize, double falsePositiveRate);
+
+/**
+*	mapGetFilterStatistics: Returns how many lookups in a map were answered by its filter (negatives),
+* and how many passed the filter and found their key (hits) or not (false positives).
+*	NOTE: Iterator status unchanged
+*
+* @param map - The map whose statistics are requested.
+* @param statistics - Where the statistics are stored.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL was sent, or if the map has no filter.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult mapGetFilterStatistics(Map map, BloomFilterStatistics* statistics);
+
 
 /**
 * mapClear: Removes all key and data elements from target map.
@@ -7,7 +7,8 @@ typedef struct node_t {
     struct node_t* next;
 } Node;
 
-static Node* createNode(Queue queue, Element element);
+static QueueResult linkElement(Queue queue, Element data);
+static Element unlinkFront(Queue queue);
 
 struct queue_t {
     Node* front;
@@ -58,7 +59,6 @@ Queue queueCopy(Queue queue)
     }
     new_queue->size = 0;
     Node* ptr = queue->front;
-    Node* new_ptr = NULL;
     while (ptr != NULL) {
         if (queueEnqueue(new_queue, ptr->data) != QUEUE_SUCCESS)
         {
@@ -80,16 +80,36 @@ QueueResult queueEnqueue(Queue queue, Element element)
         return QUEUE_NULL_ARG;
     }
 
-    Node* node = (Node*)malloc(sizeof(*node));
-    if (node == NULL) {
+    Element data = queue->copyElement(element);
+    if (data == NULL) {
         return QUEUE_OUT_OF_MEMORY;
     }
-    
-    node->data = queue->copyElement(element);
-    if(node->data == NULL) {
-        free(node);
+
+    QueueResult result = linkElement(queue, data);
+    if (result != QUEUE_SUCCESS) {
+        queue->freeElement(data);
+    }
+
+    return result;
+}
+
+QueueResult queueEnqueueTake(Queue queue, Element element)
+{
+    if (queue == NULL || element == NULL) {
+        return QUEUE_NULL_ARG;
+    }
+
+    return linkElement(queue, element);
+}
+
+static QueueResult linkElement(Queue queue, Element data)
+{
+    Node* node = (Node*)malloc(sizeof(*node));
+    if (node == NULL) {
         return QUEUE_OUT_OF_MEMORY;
     }
+
+    node->data = data;
     node->next = NULL;
 
     if (++queue->size == 1)
@@ -113,15 +133,37 @@ QueueResult queueDequeue(Queue queue)
         return QUEUE_IS_EMPTY;
     }
   
+    queue->freeElement(unlinkFront(queue));
+
+    return QUEUE_SUCCESS;
+}
+
+QueueResult queueDequeueTake(Queue queue, Element* element)
+{
+    if (queue == NULL || element == NULL) {
+        return QUEUE_NULL_ARG;
+    }
+
+    if (queueIsEmpty(queue)) {
+        return QUEUE_IS_EMPTY;
+    }
+
+    *element = unlinkFront(queue);
+
+    return QUEUE_SUCCESS;
+}
+
+static Element unlinkFront(Queue queue)
+{
     Node* to_remove = queue->front;
     queue->front = queue->front->next;
 
-    queue->freeElement(to_remove->data);
+    Element data = to_remove->data;
     free(to_remove);
     if (--queue->size == 0)
         queue->rear = NULL;
 
-    return QUEUE_SUCCESS;
+    return data;
 }
 
 QueueResult queueFront(Queue queue, Element* element)
@@ -19,7 +19,9 @@ Queue queueCreate(ElemCopyFunction, ElemFreeFunction);
 Queue queueCopy(Queue queue);
 void queueDestroy(Queue queue);
 QueueResult queueEnqueue(Queue queue, Element element);
+QueueResult queueEnqueueTake(Queue queue, Element element); // takes ownership of element, no copy
 QueueResult queueDequeue(Queue queue);
+QueueResult queueDequeueTake(Queue queue, Element* element); // hands the front element to the caller
 QueueResult queueFront(Queue queue, Element* element);
 int queueGetSize(Queue queue);
 bool queueIsEmpty(Queue queue);
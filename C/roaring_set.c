@@ -0,0 +1,1181 @@
+#include "roaring_set.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CHUNK_SIZE 65536
+#define BITMAP_WORDS (CHUNK_SIZE / 64)
+#define ARRAY_MAX 4096 // more values take more room in an array than in a bitmap
+#define RUN_MAX 2048 // more runs take more room than a bitmap
+#define INITIAL_CAPACITY 4
+
+#define FORMAT_MAGIC "RSET"
+#define FORMAT_VERSION 1
+#define HEADER_BYTES 12 // magic, version, number of containers
+#define CONTAINER_HEADER_BYTES 8 // key, type, number of values or runs
+
+typedef enum {
+    ARRAY_CONTAINER,
+    BITMAP_CONTAINER,
+    RUN_CONTAINER
+} ContainerType;
+
+typedef struct run_t {
+    uint16_t start;
+    uint16_t length; // the run is start..start + length
+} Run;
+
+typedef struct container_t {
+    uint16_t key; // the high 16 bits of the values
+    uint16_t type;
+    int cardinality;
+    int count; // the values of an array container, or the runs of a run container
+    int capacity; // in values or runs
+    union {
+        uint16_t* values;
+        uint64_t* words;
+        Run* runs;
+    } data;
+} Container;
+
+static RoaringSet allocateRoaringSet(int capacity);
+static int        findContainer(RoaringSet set, uint16_t key, bool* found);
+static Container* insertContainer(RoaringSet set, int index, uint16_t key);
+static void       removeContainer(RoaringSet set, int index);
+static bool       copyContainer(Container* copy, const Container* container);
+static RoaringSetResult containerAdd(Container* container, uint16_t low);
+static RoaringSetResult containerRemove(Container* container, uint16_t low);
+static bool       containerContains(const Container* container, uint16_t low);
+static bool       reserve(Container* container, int count);
+static int        findValue(const uint16_t* values, int count, uint16_t low, bool* found);
+static int        findRun(const Run* runs, int count, uint16_t low);
+static bool       arrayToBitmap(Container* container);
+static bool       containerFromWords(Container* container, uint16_t key, const uint64_t* words, int cardinality);
+static bool       convertFromWords(Container* container);
+static bool       convertToRuns(Container* container, int runs);
+static void       fillWords(const Container* container, uint64_t* words);
+static void       addToWords(const Container* container, uint64_t* words);
+static int        nextBit(const uint64_t* words, int from, bool set);
+static int        countRuns(const uint64_t* words);
+static int        countBits(uint64_t word);
+static int        lowestBit(uint64_t word);
+static bool       uniteContainers(Container* result, const Container* container1, const Container* container2);
+static bool       intersectContainers(Container* result, const Container* container1, const Container* container2);
+static size_t     containerBytes(const Container* container, int count);
+static unsigned char* writeNumber(unsigned char* bytes, uint64_t number, int size);
+static uint64_t   readNumber(const unsigned char* bytes, int size);
+static bool       readContainer(Container* container, const unsigned char* bytes, size_t size, size_t* read);
+
+struct roaring_set_t {
+    Container* containers; // in ascending order of their keys, none of them empty
+    int count;
+    int capacity;
+    uint64_t size;
+};
+
+RoaringSet roaringSetCreate(void)
+{
+    return allocateRoaringSet(INITIAL_CAPACITY);
+}
+
+RoaringSet roaringSetCopy(RoaringSet set)
+{
+    if (set == NULL) {
+        return NULL;
+    }
+    RoaringSet new_set = allocateRoaringSet(set->count);
+    if (new_set == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < set->count; i++) {
+        if (!copyContainer(&new_set->containers[i], &set->containers[i])) {
+            roaringSetDestroy(new_set);
+            return NULL;
+        }
+        new_set->count++;
+    }
+    new_set->size = set->size;
+
+    return new_set;
+}
+
+void roaringSetDestroy(RoaringSet set)
+{
+    if (set == NULL) {
+        return;
+    }
+    roaringSetClear(set);
+    free(set->containers);
+    free(set);
+}
+
+RoaringSetResult roaringSetAdd(RoaringSet set, uint32_t value)
+{
+    if (set == NULL) {
+        return ROARING_SET_NULL_ARG;
+    }
+
+    bool found;
+    int index = findContainer(set, (uint16_t)(value >> 16), &found);
+    Container* container = (found ? &set->containers[index] : insertContainer(set, index, (uint16_t)(value >> 16)));
+    if (container == NULL) {
+        return ROARING_SET_OUT_OF_MEMORY;
+    }
+    RoaringSetResult result = containerAdd(container, (uint16_t)value);
+    if (result == ROARING_SET_SUCCESS) {
+        set->size++;
+    }
+    else if (!found) {
+        removeContainer(set, index);
+    }
+
+    return result;
+}
+
+RoaringSetResult roaringSetRemove(RoaringSet set, uint32_t value)
+{
+    if (set == NULL) {
+        return ROARING_SET_NULL_ARG;
+    }
+
+    bool found;
+    int index = findContainer(set, (uint16_t)(value >> 16), &found);
+    if (!found) {
+        return ROARING_SET_ITEM_DOES_NOT_EXIST;
+    }
+    RoaringSetResult result = containerRemove(&set->containers[index], (uint16_t)value);
+    if (result == ROARING_SET_SUCCESS) {
+        set->size--;
+        if (set->containers[index].cardinality == 0) {
+            removeContainer(set, index);
+        }
+    }
+
+    return result;
+}
+
+RoaringSetResult roaringSetClear(RoaringSet set)
+{
+    if (set == NULL) {
+        return ROARING_SET_NULL_ARG;
+    }
+    for (int i = 0; i < set->count; i++) {
+        free(set->containers[i].data.values);
+    }
+    set->count = 0;
+    set->size = 0;
+
+    return ROARING_SET_SUCCESS;
+}
+
+bool roaringSetContains(RoaringSet set, uint32_t value)
+{
+    if (set == NULL) {
+        return false;
+    }
+    bool found;
+    int index = findContainer(set, (uint16_t)(value >> 16), &found);
+    return found && containerContains(&set->containers[index], (uint16_t)value);
+}
+
+uint64_t roaringSetGetSize(RoaringSet set)
+{
+    if (set == NULL) {
+        return 0;
+    }
+    return set->size;
+}
+
+bool roaringSetIsEmpty(RoaringSet set)
+{
+    return set && !set->size;
+}
+
+RoaringSet roaringSetUnion(RoaringSet set1, RoaringSet set2)
+{
+    if (set1 == NULL || set2 == NULL) {
+        return NULL;
+    }
+    RoaringSet set = allocateRoaringSet(set1->count + set2->count);
+    if (set == NULL) {
+        return NULL;
+    }
+
+    int i = 0;
+    int j = 0;
+    while (i < set1->count || j < set2->count) {
+        Container* container = &set->containers[set->count];
+        bool done;
+        if (j == set2->count || (i < set1->count && set1->containers[i].key < set2->containers[j].key)) {
+            done = copyContainer(container, &set1->containers[i++]);
+        }
+        else if (i == set1->count || set2->containers[j].key < set1->containers[i].key) {
+            done = copyContainer(container, &set2->containers[j++]);
+        }
+        else {
+            done = uniteContainers(container, &set1->containers[i++], &set2->containers[j++]);
+        }
+        if (!done) {
+            roaringSetDestroy(set);
+            return NULL;
+        }
+        set->size += (uint64_t)container->cardinality;
+        set->count++;
+    }
+
+    return set;
+}
+
+RoaringSet roaringSetIntersection(RoaringSet set1, RoaringSet set2)
+{
+    if (set1 == NULL || set2 == NULL) {
+        return NULL;
+    }
+    RoaringSet set = allocateRoaringSet(set1->count < set2->count ? set1->count : set2->count);
+    if (set == NULL) {
+        return NULL;
+    }
+
+    int i = 0;
+    int j = 0;
+    while (i < set1->count && j < set2->count) {
+        if (set1->containers[i].key < set2->containers[j].key) {
+            i++;
+            continue;
+        }
+        if (set2->containers[j].key < set1->containers[i].key) {
+            j++;
+            continue;
+        }
+        Container* container = &set->containers[set->count];
+        if (!intersectContainers(container, &set1->containers[i++], &set2->containers[j++])) {
+            roaringSetDestroy(set);
+            return NULL;
+        }
+        if (container->cardinality == 0) {
+            free(container->data.values);
+            continue;
+        }
+        set->size += (uint64_t)container->cardinality;
+        set->count++;
+    }
+
+    return set;
+}
+
+RoaringSetResult roaringSetForEach(RoaringSet set, RoaringVisitFunction visit, void* context)
+{
+    if (set == NULL || visit == NULL) {
+        return ROARING_SET_NULL_ARG;
+    }
+
+    for (int i = 0; i < set->count; i++) {
+        const Container* container = &set->containers[i];
+        uint32_t high = (uint32_t)container->key << 16;
+        if (container->type == ARRAY_CONTAINER) {
+            for (int k = 0; k < container->count; k++) {
+                if (!visit(high | container->data.values[k], context)) {
+                    return ROARING_SET_SUCCESS;
+                }
+            }
+        }
+        else if (container->type == BITMAP_CONTAINER) {
+            for (int k = 0; k < BITMAP_WORDS; k++) {
+                for (uint64_t word = container->data.words[k]; word != 0; word &= word - 1) {
+                    if (!visit(high | (uint32_t)(k * 64 + lowestBit(word)), context)) {
+                        return ROARING_SET_SUCCESS;
+                    }
+                }
+            }
+        }
+        else {
+            for (int k = 0; k < container->count; k++) {
+                uint32_t end = container->data.runs[k].start + container->data.runs[k].length;
+                for (uint32_t low = container->data.runs[k].start; low <= end; low++) {
+                    if (!visit(high | low, context)) {
+                        return ROARING_SET_SUCCESS;
+                    }
+                }
+            }
+        }
+    }
+
+    return ROARING_SET_SUCCESS;
+}
+
+RoaringSetResult roaringSetOptimize(RoaringSet set)
+{
+    if (set == NULL) {
+        return ROARING_SET_NULL_ARG;
+    }
+
+    uint64_t words[BITMAP_WORDS];
+    for (int i = 0; i < set->count; i++) {
+        Container* container = &set->containers[i];
+        fillWords(container, words);
+        int runs = countRuns(words);
+        size_t other_bytes = (container->cardinality <= ARRAY_MAX ?
+                              container->cardinality * sizeof(uint16_t) : BITMAP_WORDS * sizeof(uint64_t));
+        bool converted = true;
+        if (runs * sizeof(Run) < other_bytes) {
+            if (container->type != RUN_CONTAINER) {
+                converted = convertToRuns(container, runs);
+            }
+        }
+        else if (container->type == RUN_CONTAINER) {
+            converted = convertFromWords(container);
+        }
+        if (!converted) {
+            return ROARING_SET_OUT_OF_MEMORY;
+        }
+        if (container->type != BITMAP_CONTAINER && container->capacity > container->count) {
+            void* data = realloc(container->data.values, containerBytes(container, container->count));
+            if (data != NULL) {
+                container->data.values = (uint16_t*)data;
+                container->capacity = container->count;
+            }
+        }
+    }
+
+    return ROARING_SET_SUCCESS;
+}
+
+size_t roaringSetGetMemory(RoaringSet set)
+{
+    if (set == NULL) {
+        return 0;
+    }
+    size_t memory = sizeof(*set) + (size_t)set->capacity * sizeof(Container);
+    for (int i = 0; i < set->count; i++) {
+        memory += containerBytes(&set->containers[i], set->containers[i].capacity);
+    }
+    return memory;
+}
+
+size_t roaringSetSerializedSize(RoaringSet set)
+{
+    if (set == NULL) {
+        return 0;
+    }
+    size_t size = HEADER_BYTES;
+    for (int i = 0; i < set->count; i++) {
+        const Container* container = &set->containers[i];
+        size += CONTAINER_HEADER_BYTES + containerBytes(container, container->count);
+    }
+    return size;
+}
+
+RoaringSetResult roaringSetSerialize(RoaringSet set, void* buffer, size_t size)
+{
+    if (set == NULL || buffer == NULL) {
+        return ROARING_SET_NULL_ARG;
+    }
+    if (size < roaringSetSerializedSize(set)) {
+        return ROARING_SET_BUFFER_TOO_SMALL;
+    }
+
+    unsigned char* bytes = (unsigned char*)buffer;
+    memcpy(bytes, FORMAT_MAGIC, 4);
+    bytes = writeNumber(bytes + 4, FORMAT_VERSION, 4);
+    bytes = writeNumber(bytes, (uint64_t)set->count, 4);
+    for (int i = 0; i < set->count; i++) {
+        const Container* container = &set->containers[i];
+        bytes = writeNumber(bytes, container->key, 2);
+        bytes = writeNumber(bytes, container->type, 2);
+        if (container->type == ARRAY_CONTAINER) {
+            bytes = writeNumber(bytes, (uint64_t)container->count, 4);
+            for (int k = 0; k < container->count; k++) {
+                bytes = writeNumber(bytes, container->data.values[k], 2);
+            }
+        }
+        else if (container->type == BITMAP_CONTAINER) {
+            bytes = writeNumber(bytes, (uint64_t)container->cardinality, 4);
+            for (int k = 0; k < BITMAP_WORDS; k++) {
+                bytes = writeNumber(bytes, container->data.words[k], 8);
+            }
+        }
+        else {
+            bytes = writeNumber(bytes, (uint64_t)container->count, 4);
+            for (int k = 0; k < container->count; k++) {
+                bytes = writeNumber(bytes, container->data.runs[k].start, 2);
+                bytes = writeNumber(bytes, container->data.runs[k].length, 2);
+            }
+        }
+    }
+
+    return ROARING_SET_SUCCESS;
+}
+
+RoaringSet roaringSetDeserialize(const void* buffer, size_t size)
+{
+    if (buffer == NULL || size < HEADER_BYTES) {
+        return NULL;
+    }
+    const unsigned char* bytes = (const unsigned char*)buffer;
+    uint64_t count = readNumber(bytes + 8, 4);
+    if (memcmp(bytes, FORMAT_MAGIC, 4) != 0 || readNumber(bytes + 4, 4) != FORMAT_VERSION ||
+        count > CHUNK_SIZE || count * CONTAINER_HEADER_BYTES > size - HEADER_BYTES) {
+        return NULL;
+    }
+
+    RoaringSet set = allocateRoaringSet((int)count);
+    if (set == NULL) {
+        return NULL;
+    }
+    size_t offset = HEADER_BYTES;
+    for (uint64_t i = 0; i < count; i++) {
+        Container* container = &set->containers[set->count];
+        size_t read;
+        if (!readContainer(container, bytes + offset, size - offset, &read)) {
+            roaringSetDestroy(set);
+            return NULL;
+        }
+        set->count++;
+        if (set->count > 1 && container->key <= set->containers[set->count - 2].key) {
+            roaringSetDestroy(set);
+            return NULL;
+        }
+        set->size += (uint64_t)container->cardinality;
+        offset += read;
+    }
+    if (offset != size) {
+        roaringSetDestroy(set);
+        return NULL;
+    }
+
+    return set;
+}
+
+// ============================ CONTAINERS ============================ //
+
+static RoaringSet allocateRoaringSet(int capacity)
+{
+    RoaringSet set = (RoaringSet)malloc(sizeof(*set));
+    if (set == NULL) {
+        return NULL;
+    }
+    set->capacity = (capacity > 0 ? capacity : 1);
+    set->containers = (Container*)malloc((size_t)set->capacity * sizeof(Container));
+    if (set->containers == NULL) {
+        free(set);
+        return NULL;
+    }
+    set->count = 0;
+    set->size = 0;
+
+    return set;
+}
+
+/* Returns the index of the container of the key, or the index where it should be inserted. */
+static int findContainer(RoaringSet set, uint16_t key, bool* found)
+{
+    int low = 0;
+    int high = set->count;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (set->containers[middle].key < key) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    *found = (low < set->count && set->containers[low].key == key);
+    return low;
+}
+
+/* Inserts an empty array container at the index, or returns NULL if the allocation failed. */
+static Container* insertContainer(RoaringSet set, int index, uint16_t key)
+{
+    if (set->count == set->capacity) {
+        Container* containers = (Container*)realloc(set->containers, 2 * (size_t)set->capacity * sizeof(Container));
+        if (containers == NULL) {
+            return NULL;
+        }
+        set->containers = containers;
+        set->capacity *= 2;
+    }
+    uint16_t* values = (uint16_t*)malloc(INITIAL_CAPACITY * sizeof(uint16_t));
+    if (values == NULL) {
+        return NULL;
+    }
+
+    memmove(&set->containers[index + 1], &set->containers[index], (size_t)(set->count - index) * sizeof(Container));
+    set->count++;
+    Container* container = &set->containers[index];
+    container->key = key;
+    container->type = ARRAY_CONTAINER;
+    container->cardinality = 0;
+    container->count = 0;
+    container->capacity = INITIAL_CAPACITY;
+    container->data.values = values;
+
+    return container;
+}
+
+static void removeContainer(RoaringSet set, int index)
+{
+    free(set->containers[index].data.values);
+    memmove(&set->containers[index], &set->containers[index + 1], (size_t)(set->count - index - 1) * sizeof(Container));
+    set->count--;
+}
+
+/* Copies a container, with no more capacity than it uses. */
+static bool copyContainer(Container* copy, const Container* container)
+{
+    *copy = *container;
+    if (container->type != BITMAP_CONTAINER) {
+        copy->capacity = container->count;
+    }
+    size_t bytes = containerBytes(copy, copy->capacity);
+    copy->data.values = (uint16_t*)malloc(bytes);
+    if (copy->data.values == NULL) {
+        return false;
+    }
+    memcpy(copy->data.values, container->data.values, bytes);
+    return true;
+}
+
+static RoaringSetResult containerAdd(Container* container, uint16_t low)
+{
+    if (container->type == BITMAP_CONTAINER) {
+        uint64_t bit = (uint64_t)1 << (low % 64);
+        if (container->data.words[low / 64] & bit) {
+            return ROARING_SET_ITEM_ALREADY_EXISTS;
+        }
+        container->data.words[low / 64] |= bit;
+        container->cardinality++;
+        return ROARING_SET_SUCCESS;
+    }
+
+    if (container->type == ARRAY_CONTAINER) {
+        bool found;
+        int index = findValue(container->data.values, container->count, low, &found);
+        if (found) {
+            return ROARING_SET_ITEM_ALREADY_EXISTS;
+        }
+        if (container->count == ARRAY_MAX) {
+            if (!arrayToBitmap(container)) {
+                return ROARING_SET_OUT_OF_MEMORY;
+            }
+            return containerAdd(container, low);
+        }
+        if (!reserve(container, container->count + 1)) {
+            return ROARING_SET_OUT_OF_MEMORY;
+        }
+        uint16_t* values = container->data.values;
+        memmove(&values[index + 1], &values[index], (size_t)(container->count - index) * sizeof(uint16_t));
+        values[index] = low;
+        container->count++;
+        container->cardinality++;
+        return ROARING_SET_SUCCESS;
+    }
+
+    Run* runs = container->data.runs;
+    int index = findRun(runs, container->count, low);
+    if (index >= 0 && low <= runs[index].start + runs[index].length) {
+        return ROARING_SET_ITEM_ALREADY_EXISTS;
+    }
+    bool extends_previous = (index >= 0 && low == runs[index].start + runs[index].length + 1);
+    bool extends_next = (index + 1 < container->count && low + 1 == runs[index + 1].start);
+    if (extends_previous && extends_next) { // the value joins two runs
+        runs[index].length = (uint16_t)(runs[index + 1].start + runs[index + 1].length - runs[index].start);
+        memmove(&runs[index + 1], &runs[index + 2], (size_t)(container->count - index - 2) * sizeof(Run));
+        container->count--;
+    }
+    else if (extends_previous) {
+        runs[index].length++;
+    }
+    else if (extends_next) {
+        runs[index + 1].start--;
+        runs[index + 1].length++;
+    }
+    else {
+        if (!reserve(container, container->count + 1)) {
+            return ROARING_SET_OUT_OF_MEMORY;
+        }
+        runs = container->data.runs;
+        memmove(&runs[index + 2], &runs[index + 1], (size_t)(container->count - index - 1) * sizeof(Run));
+        runs[index + 1].start = low;
+        runs[index + 1].length = 0;
+        container->count++;
+    }
+    container->cardinality++;
+    if (container->count > RUN_MAX) {
+        convertFromWords(container); // if this fails, the runs are kept
+    }
+    return ROARING_SET_SUCCESS;
+}
+
+static RoaringSetResult containerRemove(Container* container, uint16_t low)
+{
+    if (container->type == BITMAP_CONTAINER) {
+        uint64_t bit = (uint64_t)1 << (low % 64);
+        if (!(container->data.words[low / 64] & bit)) {
+            return ROARING_SET_ITEM_DOES_NOT_EXIST;
+        }
+        container->data.words[low / 64] &= ~bit;
+        container->cardinality--;
+        if (container->cardinality <= ARRAY_MAX) {
+            convertFromWords(container); // if this fails, the bitmap is kept
+        }
+        return ROARING_SET_SUCCESS;
+    }
+
+    if (container->type == ARRAY_CONTAINER) {
+        bool found;
+        int index = findValue(container->data.values, container->count, low, &found);
+        if (!found) {
+            return ROARING_SET_ITEM_DOES_NOT_EXIST;
+        }
+        uint16_t* values = container->data.values;
+        memmove(&values[index], &values[index + 1], (size_t)(container->count - index - 1) * sizeof(uint16_t));
+        container->count--;
+        container->cardinality--;
+        return ROARING_SET_SUCCESS;
+    }
+
+    Run* runs = container->data.runs;
+    int index = findRun(runs, container->count, low);
+    if (index < 0 || low > runs[index].start + runs[index].length) {
+        return ROARING_SET_ITEM_DOES_NOT_EXIST;
+    }
+    int start = runs[index].start;
+    int end = start + runs[index].length;
+    if (start == end) {
+        memmove(&runs[index], &runs[index + 1], (size_t)(container->count - index - 1) * sizeof(Run));
+        container->count--;
+    }
+    else if (low == start) {
+        runs[index].start++;
+        runs[index].length--;
+    }
+    else if (low == end) {
+        runs[index].length--;
+    }
+    else { // the value splits the run in two
+        if (!reserve(container, container->count + 1)) {
+            return ROARING_SET_OUT_OF_MEMORY;
+        }
+        runs = container->data.runs;
+        memmove(&runs[index + 2], &runs[index + 1], (size_t)(container->count - index - 1) * sizeof(Run));
+        runs[index + 1].start = (uint16_t)(low + 1);
+        runs[index + 1].length = (uint16_t)(end - low - 1);
+        runs[index].length = (uint16_t)(low - start - 1);
+        container->count++;
+    }
+    container->cardinality--;
+    if (container->count > RUN_MAX) {
+        convertFromWords(container); // if this fails, the runs are kept
+    }
+    return ROARING_SET_SUCCESS;
+}
+
+static bool containerContains(const Container* container, uint16_t low)
+{
+    if (container->type == BITMAP_CONTAINER) {
+        return (container->data.words[low / 64] >> (low % 64)) & 1;
+    }
+    if (container->type == ARRAY_CONTAINER) {
+        bool found;
+        findValue(container->data.values, container->count, low, &found);
+        return found;
+    }
+    int index = findRun(container->data.runs, container->count, low);
+    return index >= 0 && low <= container->data.runs[index].start + container->data.runs[index].length;
+}
+
+/* Makes room for count values or runs in an array or run container. */
+static bool reserve(Container* container, int count)
+{
+    if (count <= container->capacity) {
+        return true;
+    }
+    int capacity = 2 * container->capacity;
+    if (capacity < count) {
+        capacity = count;
+    }
+    void* data = realloc(container->data.values, containerBytes(container, capacity));
+    if (data == NULL) {
+        return false;
+    }
+    container->data.values = (uint16_t*)data;
+    container->capacity = capacity;
+    return true;
+}
+
+/* Returns the index of the value, or the index where it should be inserted. */
+static int findValue(const uint16_t* values, int count, uint16_t low, bool* found)
+{
+    int first = 0;
+    int last = count;
+    while (first < last) {
+        int middle = first + (last - first) / 2;
+        if (values[middle] < low) {
+            first = middle + 1;
+        }
+        else {
+            last = middle;
+        }
+    }
+    *found = (first < count && values[first] == low);
+    return first;
+}
+
+/* Returns the index of the last run which starts at or before the value, or -1 if there is none. */
+static int findRun(const Run* runs, int count, uint16_t low)
+{
+    int first = 0;
+    int last = count;
+    while (first < last) {
+        int middle = first + (last - first) / 2;
+        if (runs[middle].start <= low) {
+            first = middle + 1;
+        }
+        else {
+            last = middle;
+        }
+    }
+    return first - 1;
+}
+
+static bool arrayToBitmap(Container* container)
+{
+    uint64_t* words = (uint64_t*)calloc(BITMAP_WORDS, sizeof(uint64_t));
+    if (words == NULL) {
+        return false;
+    }
+    addToWords(container, words);
+    free(container->data.values);
+    container->type = BITMAP_CONTAINER;
+    container->count = 0;
+    container->capacity = 0;
+    container->data.words = words;
+    return true;
+}
+
+/* Initializes an array container (or a bitmap container, if there are more than ARRAY_MAX values)
+ * with the values of the words. An empty container gets no allocation. */
+static bool containerFromWords(Container* container, uint16_t key, const uint64_t* words, int cardinality)
+{
+    container->key = key;
+    container->cardinality = cardinality;
+    if (cardinality > ARRAY_MAX) {
+        container->type = BITMAP_CONTAINER;
+        container->count = 0;
+        container->capacity = 0;
+        container->data.words = (uint64_t*)malloc(BITMAP_WORDS * sizeof(uint64_t));
+        if (container->data.words == NULL) {
+            return false;
+        }
+        memcpy(container->data.words, words, BITMAP_WORDS * sizeof(uint64_t));
+        return true;
+    }
+
+    container->type = ARRAY_CONTAINER;
+    container->count = cardinality;
+    container->capacity = cardinality;
+    container->data.values = NULL;
+    if (cardinality == 0) {
+        return true;
+    }
+    container->data.values = (uint16_t*)malloc((size_t)cardinality * sizeof(uint16_t));
+    if (container->data.values == NULL) {
+        return false;
+    }
+    int count = 0;
+    for (int k = 0; k < BITMAP_WORDS; k++) {
+        for (uint64_t word = words[k]; word != 0; word &= word - 1) {
+            container->data.values[count++] = (uint16_t)(k * 64 + lowestBit(word));
+        }
+    }
+    return true;
+}
+
+/* Replaces a bitmap or run container with an array or bitmap container of the same values. */
+static bool convertFromWords(Container* container)
+{
+    uint64_t words[BITMAP_WORDS];
+    fillWords(container, words);
+    Container converted;
+    if (!containerFromWords(&converted, container->key, words, container->cardinality)) {
+        return false;
+    }
+    free(container->data.values);
+    *container = converted;
+    return true;
+}
+
+/* Replaces a container with a run container of the same values, which are in the given number of runs. */
+static bool convertToRuns(Container* container, int runs)
+{
+    Run* data = (Run*)malloc((size_t)runs * sizeof(Run));
+    if (data == NULL) {
+        return false;
+    }
+    uint64_t words[BITMAP_WORDS];
+    fillWords(container, words);
+    int count = 0;
+    for (int start = nextBit(words, 0, true); start < CHUNK_SIZE; start = nextBit(words, start, true)) {
+        int end = nextBit(words, start, false);
+        data[count].start = (uint16_t)start;
+        data[count].length = (uint16_t)(end - 1 - start);
+        count++;
+        start = end;
+    }
+
+    free(container->data.values);
+    container->type = RUN_CONTAINER;
+    container->count = count;
+    container->capacity = runs;
+    container->data.runs = data;
+    return true;
+}
+
+static void fillWords(const Container* container, uint64_t* words)
+{
+    if (container->type == BITMAP_CONTAINER) {
+        memcpy(words, container->data.words, BITMAP_WORDS * sizeof(uint64_t));
+        return;
+    }
+    memset(words, 0, BITMAP_WORDS * sizeof(uint64_t));
+    addToWords(container, words);
+}
+
+/* Sets the bits of the container's values in the words. */
+static void addToWords(const Container* container, uint64_t* words)
+{
+    if (container->type == BITMAP_CONTAINER) {
+        for (int k = 0; k < BITMAP_WORDS; k++) {
+            words[k] |= container->data.words[k];
+        }
+    }
+    else if (container->type == ARRAY_CONTAINER) {
+        for (int k = 0; k < container->count; k++) {
+            words[container->data.values[k] / 64] |= (uint64_t)1 << (container->data.values[k] % 64);
+        }
+    }
+    else {
+        for (int k = 0; k < container->count; k++) {
+            int start = container->data.runs[k].start;
+            int end = start + container->data.runs[k].length; // inclusive
+            for (int word = start / 64; word <= end / 64; word++) {
+                int first = (word == start / 64 ? start % 64 : 0);
+                int last = (word == end / 64 ? end % 64 : 63);
+                words[word] |= (~(uint64_t)0 >> (63 - last + first)) << first;
+            }
+        }
+    }
+}
+
+/* Returns the first bit at or after from which is set (or clear), or CHUNK_SIZE if there is none. */
+static int nextBit(const uint64_t* words, int from, bool set)
+{
+    if (from >= CHUNK_SIZE) {
+        return CHUNK_SIZE;
+    }
+    int k = from / 64;
+    uint64_t word = (set ? words[k] : ~words[k]) & (~(uint64_t)0 << (from % 64));
+    while (word == 0) {
+        if (++k == BITMAP_WORDS) {
+            return CHUNK_SIZE;
+        }
+        word = (set ? words[k] : ~words[k]);
+    }
+    return k * 64 + lowestBit(word);
+}
+
+/* Counts the runs of set bits, by counting the set bits whose previous bit is clear. */
+static int countRuns(const uint64_t* words)
+{
+    int runs = 0;
+    uint64_t previous = 0; // the last bit of the previous word
+    for (int k = 0; k < BITMAP_WORDS; k++) {
+        uint64_t starts = words[k] & ~((words[k] << 1) | previous);
+        runs += countBits(starts);
+        previous = words[k] >> 63;
+    }
+    return runs;
+}
+
+static int countBits(uint64_t word)
+{
+#if defined(__GNUC__) && defined(__POPCNT__)
+    return __builtin_popcountll(word);
+#else
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/* The index of the lowest set bit of a word which is not 0. */
+static int lowestBit(uint64_t word)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(word);
+#else
+    int index = 0;
+    for (; !(word & 1); word >>= 1) {
+        index++;
+    }
+    return index;
+#endif
+}
+
+/* Initializes result with the union of two containers of the same key.
+ * Two small arrays are merged, and two run containers merge their runs; any other pair is
+ * combined as bitmaps, a word at a time. */
+static bool uniteContainers(Container* result, const Container* container1, const Container* container2)
+{
+    if (container1->type == ARRAY_CONTAINER && container2->type == ARRAY_CONTAINER &&
+        container1->cardinality + container2->cardinality <= ARRAY_MAX) {
+        const uint16_t* values1 = container1->data.values;
+        const uint16_t* values2 = container2->data.values;
+        uint16_t* values = (uint16_t*)malloc((size_t)(container1->count + container2->count) * sizeof(uint16_t));
+        if (values == NULL) {
+            return false;
+        }
+        int i = 0;
+        int j = 0;
+        int count = 0;
+        while (i < container1->count && j < container2->count) { // without branches, which would be mispredicted
+            uint16_t value1 = values1[i];
+            uint16_t value2 = values2[j];
+            values[count++] = (value1 < value2 ? value1 : value2);
+            i += (value1 <= value2);
+            j += (value2 <= value1);
+        }
+        memcpy(&values[count], &values1[i], (size_t)(container1->count - i) * sizeof(uint16_t));
+        count += container1->count - i;
+        memcpy(&values[count], &values2[j], (size_t)(container2->count - j) * sizeof(uint16_t));
+        count += container2->count - j;
+        result->key = container1->key;
+        result->type = ARRAY_CONTAINER;
+        result->cardinality = count;
+        result->count = count;
+        result->capacity = container1->count + container2->count;
+        result->data.values = values;
+        return true;
+    }
+
+    if (container1->type == RUN_CONTAINER && container2->type == RUN_CONTAINER) {
+        const Run* runs1 = container1->data.runs;
+        const Run* runs2 = container2->data.runs;
+        Run* runs = (Run*)malloc((size_t)(container1->count + container2->count) * sizeof(Run));
+        if (runs == NULL) {
+            return false;
+        }
+        int i = 0;
+        int j = 0;
+        int count = 0;
+        int cardinality = 0;
+        int last_end = -2;
+        while (i < container1->count || j < container2->count) {
+            const Run* run = (j == container2->count || (i < container1->count && runs1[i].start < runs2[j].start) ?
+                              &runs1[i++] : &runs2[j++]);
+            int end = run->start + run->length;
+            if (run->start <= last_end + 1) { // overlaps or touches the last run
+                if (end > last_end) {
+                    cardinality += end - last_end;
+                    runs[count - 1].length = (uint16_t)(end - runs[count - 1].start);
+                    last_end = end;
+                }
+                continue;
+            }
+            runs[count++] = *run;
+            cardinality += run->length + 1;
+            last_end = end;
+        }
+        result->key = container1->key;
+        result->type = RUN_CONTAINER;
+        result->cardinality = cardinality;
+        result->count = count;
+        result->capacity = container1->count + container2->count;
+        result->data.runs = runs;
+        if (count > RUN_MAX && !convertFromWords(result)) {
+            free(result->data.runs);
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t words[BITMAP_WORDS];
+    fillWords(container1, words);
+    addToWords(container2, words);
+    int cardinality = 0;
+    for (int k = 0; k < BITMAP_WORDS; k++) {
+        cardinality += countBits(words[k]);
+    }
+    return containerFromWords(result, container1->key, words, cardinality);
+}
+
+/* Initializes result with the intersection of two containers of the same key, which may be empty.
+ * Two arrays are merged, the values of an array are looked up in any other container,
+ * and any other pair is combined as bitmaps, a word at a time. */
+static bool intersectContainers(Container* result, const Container* container1, const Container* container2)
+{
+    if (container1->type != ARRAY_CONTAINER && container2->type == ARRAY_CONTAINER) {
+        const Container* swap = container1;
+        container1 = container2;
+        container2 = swap;
+    }
+
+    if (container1->type == ARRAY_CONTAINER) {
+        uint16_t* values = (uint16_t*)malloc((size_t)container1->count * sizeof(uint16_t));
+        if (values == NULL) {
+            return false;
+        }
+        int count = 0;
+        if (container2->type == ARRAY_CONTAINER) {
+            const uint16_t* values1 = container1->data.values;
+            const uint16_t* values2 = container2->data.values;
+            int i = 0;
+            int j = 0;
+            while (i < container1->count && j < container2->count) { // without branches, as in uniteContainers
+                uint16_t value1 = values1[i];
+                uint16_t value2 = values2[j];
+                values[count] = value1;
+                count += (value1 == value2);
+                i += (value1 <= value2);
+                j += (value2 <= value1);
+            }
+        }
+        else {
+            for (int k = 0; k < container1->count; k++) {
+                if (containerContains(container2, container1->data.values[k])) {
+                    values[count++] = container1->data.values[k];
+                }
+            }
+        }
+        result->key = container1->key;
+        result->type = ARRAY_CONTAINER;
+        result->cardinality = count;
+        result->count = count;
+        result->capacity = container1->count;
+        result->data.values = values;
+        return true;
+    }
+
+    uint64_t words[BITMAP_WORDS];
+    uint64_t other_words[BITMAP_WORDS];
+    fillWords(container1, words);
+    const uint64_t* other = container2->data.words;
+    if (container2->type != BITMAP_CONTAINER) {
+        fillWords(container2, other_words);
+        other = other_words;
+    }
+    int cardinality = 0;
+    for (int k = 0; k < BITMAP_WORDS; k++) {
+        words[k] &= other[k];
+        cardinality += countBits(words[k]);
+    }
+    return containerFromWords(result, container1->key, words, cardinality);
+}
+
+/* The bytes of the contents of a container, with room for count values or runs. */
+static size_t containerBytes(const Container* container, int count)
+{
+    if (container->type == BITMAP_CONTAINER) {
+        return BITMAP_WORDS * sizeof(uint64_t);
+    }
+    if (container->type == ARRAY_CONTAINER) {
+        return (size_t)count * sizeof(uint16_t);
+    }
+    return (size_t)count * sizeof(Run);
+}
+
+// ============================ SERIALIZATION ============================ //
+
+/* Writes a number of the given size in bytes, least significant byte first. */
+static unsigned char* writeNumber(unsigned char* bytes, uint64_t number, int size)
+{
+    for (int i = 0; i < size; i++) {
+        bytes[i] = (unsigned char)(number >> (8 * i));
+    }
+    return bytes + size;
+}
+
+static uint64_t readNumber(const unsigned char* bytes, int size)
+{
+    uint64_t number = 0;
+    for (int i = size - 1; i >= 0; i--) {
+        number = (number << 8) | bytes[i];
+    }
+    return number;
+}
+
+/* Reads a serialized container, and checks that it is one the set could have made:
+ * its values are sorted and distinct, and its type is the one its size calls for. */
+static bool readContainer(Container* container, const unsigned char* bytes, size_t size, size_t* read)
+{
+    if (size < CONTAINER_HEADER_BYTES) {
+        return false;
+    }
+    container->key = (uint16_t)readNumber(bytes, 2);
+    container->type = (uint16_t)readNumber(bytes + 2, 2);
+    uint64_t count = readNumber(bytes + 4, 4);
+    bytes += CONTAINER_HEADER_BYTES;
+    size -= CONTAINER_HEADER_BYTES;
+
+    if (container->type == BITMAP_CONTAINER) {
+        if (size < BITMAP_WORDS * sizeof(uint64_t) || count <= ARRAY_MAX || count > CHUNK_SIZE) {
+            return false;
+        }
+        container->count = 0;
+        container->capacity = 0;
+        container->cardinality = (int)count;
+    }
+    else if (container->type == ARRAY_CONTAINER || container->type == RUN_CONTAINER) {
+        uint64_t max = (container->type == ARRAY_CONTAINER ? ARRAY_MAX : RUN_MAX);
+        if (count == 0 || count > max || size < containerBytes(container, (int)count)) {
+            return false;
+        }
+        container->count = (int)count;
+        container->capacity = (int)count;
+    }
+    else {
+        return false;
+    }
+    *read = CONTAINER_HEADER_BYTES + containerBytes(container, container->count);
+    container->data.values = (uint16_t*)malloc(containerBytes(container, container->capacity));
+    if (container->data.values == NULL) {
+        return false;
+    }
+
+    bool valid = true;
+    if (container->type == BITMAP_CONTAINER) {
+        int cardinality = 0;
+        for (int k = 0; k < BITMAP_WORDS; k++) {
+            container->data.words[k] = readNumber(bytes + 8 * k, 8);
+            cardinality += countBits(container->data.words[k]);
+        }
+        valid = (cardinality == container->cardinality);
+    }
+    else if (container->type == ARRAY_CONTAINER) {
+        for (int k = 0; k < container->count && valid; k++) {
+            container->data.values[k] = (uint16_t)readNumber(bytes + 2 * k, 2);
+            valid = (k == 0 || container->data.values[k] > container->data.values[k - 1]);
+        }
+        container->cardinality = container->count;
+    }
+    else {
+        int last_end = -2;
+        container->cardinality = 0;
+        for (int k = 0; k < container->count && valid; k++) {
+            Run* run = &container->data.runs[k];
+            run->start = (uint16_t)readNumber(bytes + 4 * k, 2);
+            run->length = (uint16_t)readNumber(bytes + 4 * k + 2, 2);
+            valid = (run->start > last_end + 1 && run->start + run->length < CHUNK_SIZE);
+            last_end = run->start + run->length;
+            container->cardinality += run->length + 1;
+        }
+    }
+    if (!valid) {
+        free(container->data.values);
+    }
+    return valid;
+}
@@ -0,0 +1,50 @@
+#ifndef ROARING_SET_H_
+#define ROARING_SET_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A compressed set of 32-bit integers (a "Roaring bitmap"). The values are split by their
+ * high 16 bits into chunks of 65536, and every chunk which has values is kept in the smallest
+ * of three containers: a sorted array of the low 16 bits (up to 4096 values), a bitmap of
+ * 65536 bits, or a sorted array of runs of consecutive values (see roaringSetOptimize).
+ * So a value takes at most 2 bytes, and a dense chunk 1 bit per possible value.
+ * Union and intersection work a container at a time, on bitmaps a word at a time. */
+
+typedef bool (*RoaringVisitFunction)(uint32_t value, void* context); // return false to stop the visit
+
+typedef struct roaring_set_t* RoaringSet;
+
+typedef enum {
+    ROARING_SET_SUCCESS,
+    ROARING_SET_OUT_OF_MEMORY,
+    ROARING_SET_NULL_ARG,
+    ROARING_SET_ITEM_ALREADY_EXISTS,
+    ROARING_SET_ITEM_DOES_NOT_EXIST,
+    ROARING_SET_BUFFER_TOO_SMALL
+} RoaringSetResult;
+
+RoaringSet roaringSetCreate(void);
+RoaringSet roaringSetCopy(RoaringSet set);
+void roaringSetDestroy(RoaringSet set);
+RoaringSetResult roaringSetAdd(RoaringSet set, uint32_t value);
+RoaringSetResult roaringSetRemove(RoaringSet set, uint32_t value);
+RoaringSetResult roaringSetClear(RoaringSet set);
+bool roaringSetContains(RoaringSet set, uint32_t value);
+uint64_t roaringSetGetSize(RoaringSet set); // O(1), the size is kept up to date
+bool roaringSetIsEmpty(RoaringSet set);
+RoaringSet roaringSetUnion(RoaringSet set1, RoaringSet set2);
+RoaringSet roaringSetIntersection(RoaringSet set1, RoaringSet set2);
+RoaringSetResult roaringSetForEach(RoaringSet set, RoaringVisitFunction visit, void* context); // in ascending order
+RoaringSetResult roaringSetOptimize(RoaringSet set); // keeps runs where they are smaller, and frees unused capacity
+size_t roaringSetGetMemory(RoaringSet set); // the bytes allocated by the set
+
+/* The serialized form is the same on every machine (little endian, fixed-size fields):
+ * "RSET", a version and the number of containers, and then every container's key, type,
+ * number of values (or runs) and contents. */
+size_t roaringSetSerializedSize(RoaringSet set); // returns 0 if set is NULL
+RoaringSetResult roaringSetSerialize(RoaringSet set, void* buffer, size_t size);
+RoaringSet roaringSetDeserialize(const void* buffer, size_t size); // returns NULL if the bytes are not a valid set
+
+#endif /* ROARING_SET_H_ */
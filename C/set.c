@@ -1,23 +1,85 @@
 #include "set.h"
+#include "intern_pool.h"
+#include "bloom_filter.h"
+#include "thread_pool.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+
+/* A hashed set indexes its nodes in an open addressing table with linear probing.
+ * When the table gets more than 3/4 full (counting the slots of removed nodes), a table
+ * twice the size of the live nodes is allocated, and the nodes are moved to it REHASH_STEP
+ * slots at a time, by every add and remove, so no single call moves the whole table.
+ * Until they are all moved, a lookup searches the new table and then the old one. */
+#define INITIAL_CAPACITY 16 // a power of 2, so a hash is reduced to an index by a mask
+#define REHASH_STEP 64
+
+#define PARALLEL_TASKS_PER_THREAD 8 // more tasks than threads, so the threads which finish early take more of them
+#define MIN_PARALLEL_TASK_SIZE 64   // fewer elements are not worth a task of their own
 
 typedef struct Node {
     Element data;
     struct Node* next;
+    struct Node* prev;
+    size_t hash; // only used by hashed sets
 } Node;
 
+/* A chunk of consecutive nodes, whose elements are checked by one thread of setFilterParallel. */
+typedef struct filter_task_t {
+    Node* first;
+    int count;
+    ElemConditionFunction condition;
+    void* param;
+    bool* passed; // the results of condition, one for each of the task's elements
+} FilterTask;
+
+static Node removed_node; // marks a slot whose node was removed or moved, so probing goes on past it
+#define REMOVED (&removed_node)
+
+static Set   allocateSet       (ElemCopyFunction copyElement, ElemFreeFunction freeElement,
+                                ElemEqualFunction equalElements);
 static Node* createNodeElement (Set set, Element data);
+static Node* wrapNodeElement   (Set set, Element data);
+static Node* findNode          (Set set, Element element, Node** last);
+static Node* cursorNode        (SetCursor* cursor);
+static Node* lookupNode        (Set set, Element element);
+static SetResult appendElement (Set set, Element element, Node** tail);
+static void  deleteNode        (Set set, Node* node);
 static void  removeNodeElement (Set set, Node* node);
+static bool  haveSameFunctions (Set set1, Set set2);
+static void  filterElement     (Set set, Element data);
+static Set   createEmptyCopy   (Set set);
+static Element copyForCaller   (Set set, Element element);
+static bool  equalInterned     (Element a, Element b);
+static void  linkNode          (Set set, Node* node, Node* after);
+static Node** findSlot         (Set set, Element element, size_t hash);
+static bool  reserveSlot       (Set set);
+static void  insertSlot        (Set set, Node** table, size_t capacity, Node* node);
+static bool  startRehash       (Set set);
+static void  rehashStep        (Set set);
+static SetResult addHashed     (Set set, Element element, bool take);
+static void  filterTask        (void* task);
 
 struct set_t {
     Node* head;
     Node* iterator;
     int size;
+    unsigned long version; // changes whenever elements are added or removed, to detect invalidated cursors
     ElemCopyFunction copyElement;
     ElemFreeFunction freeElement;
-    ElemEqualFunction equalElements;
+    ElemEqualFunction equalElements; // NULL if the set is ordered
+    ElemCompareFunction compareElements; // NULL unless the set is ordered, then the list is kept sorted by it
+    InternPool pool; // if not NULL, the elements are strings of this pool, and are never copied or freed
+    ElemHashFunction hashElement; // NULL unless the set is hashed
+    BloomFilter filter; // NULL unless the set is filtered, then it has the hashes of all of the elements
+    ElemHashFunction filterHash;
+    Node** table;
+    size_t capacity;
+    size_t used; // the slots of the table which are not NULL
+    Node** old_table; // the table the nodes are being moved from, or NULL
+    size_t old_capacity;
+    size_t moved; // the slots of the old table which were already moved
 };
 
 Set setCreate(ElemCopyFunction copyElement,
@@ -27,16 +89,83 @@ Set setCreate(ElemCopyFunction copyElement,
     if(copyElement == NULL || freeElement == NULL || equalElements == NULL ) {
         return NULL; 
     }
-    Set set = (Set)malloc(sizeof(*set));
-    if(set == NULL) {
+    return allocateSet(copyElement, freeElement, equalElements);
+}
+
+Set setCreateHashed(ElemCopyFunction copyElement,
+                    ElemFreeFunction freeElement,
+                    ElemEqualFunction equalElements,
+                    ElemHashFunction hashElement)
+{
+    if (hashElement == NULL) {
         return NULL;
     }
-    set->size = 0;
-    set->head = NULL; 
-    set->iterator = NULL;
-    set->copyElement = copyElement;
-    set->freeElement = freeElement;
-    set->equalElements = equalElements;
+    Set set = setCreate(copyElement, freeElement, equalElements);
+    if (set == NULL) {
+        return NULL;
+    }
+    set->table = (Node**)calloc(INITIAL_CAPACITY, sizeof(Node*));
+    if (set->table == NULL) {
+        free(set);
+        return NULL;
+    }
+    set->hashElement = hashElement;
+    set->capacity = INITIAL_CAPACITY;
+    set->used = 0;
+
+    return set;
+}
+
+Set setCreateInterned(InternPool pool)
+{
+    if (pool == NULL) {
+        return NULL;
+    }
+    Set set = allocateSet(NULL, NULL, equalInterned);
+    if (set == NULL) {
+        return NULL;
+    }
+    set->pool = pool;
+
+    return set;
+}
+
+Set setCreateOrdered(ElemCopyFunction copyElement,
+                     ElemFreeFunction freeElement,
+                     ElemCompareFunction compareElements)
+{
+    if (copyElement == NULL || freeElement == NULL || compareElements == NULL) {
+        return NULL;
+    }
+    Set set = allocateSet(copyElement, freeElement, NULL);
+    if (set == NULL) {
+        return NULL;
+    }
+    set->compareElements = compareElements;
+
+    return set;
+}
+
+Set setCreateFiltered(ElemCopyFunction copyElement,
+                      ElemFreeFunction freeElement,
+                      ElemEqualFunction equalElements,
+                      ElemHashFunction filterHash,
+                      int expected_size,
+                      double false_positive_rate)
+{
+    if (filterHash == NULL) {
+        return NULL;
+    }
+    Set set = setCreate(copyElement, freeElement, equalElements);
+    if (set == NULL) {
+        return NULL;
+    }
+    set->filter = bloomFilterCreate(expected_size, false_positive_rate);
+    if (set->filter == NULL) {
+        free(set);
+        return NULL;
+    }
+    set->filterHash = filterHash;
 
     return set;
 }
@@ -46,23 +175,19 @@ Set setCopy(Set set)
     if(set == NULL) {
         return NULL;
     }
-    Set new_set = setCreate(set->copyElement, set->freeElement, set->equalElements);
+    Set new_set = createEmptyCopy(set);
     if (new_set == NULL) {
         return NULL;
     }
-    new_set->size = 0;
+    Node* tail = NULL;
     Node* ptr = set->head;
-    while (ptr != NULL) {
-        if (setAdd(new_set, ptr->data) != SET_SUCCESS) {
+    while (ptr != NULL) { // the elements are known to be distinct, so they are appended without a search
+        if (appendElement(new_set, ptr->data, &tail) != SET_SUCCESS) {
             setDestroy(new_set);
             return NULL;
         }
         ptr = ptr->next;
     }
-    new_set->iterator = NULL;
-    new_set->copyElement = set->copyElement;
-    new_set->freeElement = set->freeElement;
-    new_set->equalElements = set->equalElements;
 
     return new_set;
 }
@@ -73,6 +198,8 @@ void setDestroy(Set set)
         return;
     }
     setClear(set);
+    free(set->table);
+    bloomFilterDestroy(set->filter);
     free(set);
 }
 
@@ -87,6 +214,15 @@ SetResult setClear(Set set)
         set->head = set->head->next;
         removeNodeElement(set, ptr);
     }
+    if (set->hashElement != NULL) {
+        memset(set->table, 0, set->capacity * sizeof(Node*));
+        set->used = 0;
+        free(set->old_table);
+        set->old_table = NULL;
+    }
+    if (set->filter != NULL) { // if this fails, the filter keeps the old hashes, which only cost false positives
+        bloomFilterReset(set->filter, bloomFilterGetCapacity(set->filter));
+    }
 
     return SET_SUCCESS;
 }
@@ -96,26 +232,48 @@ SetResult setAdd(Set set, Element element)
     if (set == NULL || element == NULL) {
         return SET_NULL_ARG;
     }
+    if (set->hashElement != NULL) {
+        return addHashed(set, element, false);
+    }
 
-    if (setIsEmpty(set))
-    {
-        set->head = createNodeElement(set, element);
-        return (set->head == NULL ? SET_OUT_OF_MEMORY : SET_SUCCESS);
+    Node* last;
+    if (findNode(set, element, &last) != NULL) {
+        return SET_ITEM_ALREADY_EXISTS;
     }
 
-    Node* ptr = set->head;
-    Node* next = ptr->next;
+    Node* node = createNodeElement(set, element);
+    if (node == NULL) {
+        return SET_OUT_OF_MEMORY;
+    }
+    linkNode(set, node, last);
 
-    while (next != NULL)
-    {
-        if (set->equalElements(ptr->data, element))
-            return SET_ITEM_ALREADY_EXISTS;
-        ptr = next;
-        next = ptr->next;
+    return SET_SUCCESS;
+}
+
+SetResult setAddTake(Set set, Element element)
+{
+    if (set == NULL || element == NULL) {
+        return SET_NULL_ARG;
+    }
+
+    if (set->pool != NULL) { // the set keeps the pool's copy, so the caller's string is not taken
+        return setAdd(set, element);
+    }
+    if (set->hashElement != NULL) {
+        return addHashed(set, element, true);
+    }
+
+    Node* last;
+    if (findNode(set, element, &last) != NULL) {
+        set->freeElement(element);
+        return SET_ITEM_ALREADY_EXISTS;
     }
 
-    ptr->next = createNodeElement(set, element);
-    return (ptr->next == NULL ? SET_OUT_OF_MEMORY : SET_SUCCESS);
+    Node* node = wrapNodeElement(set, element);
+    if (node == NULL) {
+        return SET_OUT_OF_MEMORY;
+    }
+    linkNode(set, node, last);
 
     return SET_SUCCESS;
 }
@@ -125,28 +283,14 @@ SetResult setRemove(Set set, Element element)
     if(set == NULL || element == NULL) {
         return SET_NULL_ARG;
     }
-    if (set->head == NULL) {
-        return SET_ITEM_DOES_NOT_EXIST;
-    }
 
-    Node* ptr = set->head;
-    if(set->equalElements(ptr->data , element)) {
-        set->head = set->head->next;
-        removeNodeElement(set , ptr);
-        return SET_SUCCESS;
+    Node* node = lookupNode(set, element);
+    if (node == NULL) {
+        return SET_ITEM_DOES_NOT_EXIST;
     }
+    deleteNode(set, node);
 
-    while(ptr->next != NULL) {
-        if(set->equalElements(ptr->next->data , element)) {
-            Node* next = ptr->next;
-            ptr->next = next->next;
-            removeNodeElement(set, next);
-            return SET_SUCCESS;
-        }
-        ptr = ptr->next;
-    }
-    
-    return SET_ITEM_DOES_NOT_EXIST;   
+    return SET_SUCCESS;
 }
 
 Element setFind(Set set, Element element)
@@ -154,14 +298,17 @@ Element setFind(Set set, Element element)
     if(set == NULL || element == NULL) {
         return NULL;
     }
-    Node* ptr = set->head; 
-    while(ptr != NULL) {
-        if((set->equalElements(ptr->data ,element))) {
-            return set->copyElement(ptr->data);
-        }
-        ptr = ptr->next;
+    Node* node = lookupNode(set, element);
+    return (node == NULL ? NULL : copyForCaller(set, node->data));
+}
+
+Element setFindRef(Set set, Element element)
+{
+    if(set == NULL || element == NULL) {
+        return NULL;
     }
-    return NULL;
+    Node* node = lookupNode(set, element);
+    return (node == NULL ? NULL : node->data);
 }
 
 bool setContains(Set set, Element element)
@@ -169,16 +316,7 @@ bool setContains(Set set, Element element)
     if(set == NULL || element == NULL) {
         return false;
     }
-
-    Node* ptr = set->head;
-    while(ptr != NULL) {
-        if(set->equalElements(ptr->data , element)) {
-            return true;
-        }
-        ptr = ptr->next;
-    }
-
-    return false;
+    return lookupNode(set, element) != NULL;
 }
 
 bool setIsEmpty(Set set)
@@ -206,24 +344,17 @@ Set setUnion(Set set1, Set set2)
     if (set2 == NULL) {
         return setCopy(set1);
     }
-    if (set1->copyElement != set2->copyElement ||
-        set1->freeElement != set2->freeElement ||
-        set1->equalElements != set2->equalElements) {
-            return NULL;
-        }
-
-    Set set = setCreate(set1->copyElement, set1->freeElement, set1->equalElements);
-
-    Node* ptr = set1->head;
-    while (ptr != NULL) {
-        setAdd(set, ptr->data);
-        ptr = ptr->next;
+    if (!haveSameFunctions(set1, set2)) {
+        return NULL;
     }
 
-    ptr = set2->head;
-    while (ptr != NULL) {
-        setAdd(set, ptr->data);
-        ptr = ptr->next;
+    Set set = setCopy(set1);
+    if (set == NULL) {
+        return NULL;
+    }
+    if (setUniteWith(set, set2) != SET_SUCCESS) {
+        setDestroy(set);
+        return NULL;
     }
 
     return set;
@@ -235,34 +366,125 @@ Set setIntersection(Set set1, Set set2)
         return NULL;
     }
     if (set1 == NULL) {
-        return setCreate(set2->copyElement, set2->freeElement, set2->equalElements);
+        return createEmptyCopy(set2);
     }
     if (set2 == NULL) {
-        return setCreate(set1->copyElement, set1->freeElement, set1->equalElements);
+        return createEmptyCopy(set1);
     }
-    if (set1->copyElement != set2->copyElement ||
-        set1->freeElement != set2->freeElement ||
-        set1->equalElements != set2->equalElements) {
-            return NULL;
+    if (!haveSameFunctions(set1, set2)) {
+        return NULL;
+    }
+
+    Set set = createEmptyCopy(set1);
+    if (set == NULL) {
+        return NULL;
+    }
+    Node* tail = NULL;
+    SetResult result = SET_SUCCESS;
+    if (set1->compareElements != NULL) { // merge the two sorted lists
+        Node* ptr1 = set1->head;
+        Node* ptr2 = set2->head;
+        while (ptr1 != NULL && ptr2 != NULL && result == SET_SUCCESS) {
+            int order = set1->compareElements(ptr1->data, ptr2->data);
+            if (order == 0) {
+                result = appendElement(set, ptr1->data, &tail);
+            }
+            if (order <= 0) {
+                ptr1 = ptr1->next;
+            }
+            if (order >= 0) {
+                ptr2 = ptr2->next;
+            }
         }
+    }
+    else { // look up the elements of the smaller set in the larger one
+        Set smaller = (set1->size <= set2->size ? set1 : set2);
+        Set larger = (smaller == set1 ? set2 : set1);
+        for (Node* ptr = smaller->head; ptr != NULL && result == SET_SUCCESS; ptr = ptr->next) {
+            if (lookupNode(larger, ptr->data) != NULL) {
+                result = appendElement(set, ptr->data, &tail);
+            }
+        }
+    }
+    if (result != SET_SUCCESS) {
+        setDestroy(set);
+        return NULL;
+    }
 
-    Set set = setCreate(set1->copyElement, set1->freeElement, set1->equalElements);
+    return set;
+}
 
-    Node* ptr = set1->head;
-    while (ptr != NULL) {
-        if (setContains(set2, ptr->data))
-            setAdd(set, ptr->data);
-        ptr = ptr->next;
+SetResult setUniteWith(Set set, Set other)
+{
+    if (set == NULL || other == NULL) {
+        return SET_NULL_ARG;
+    }
+    if (!haveSameFunctions(set, other)) {
+        return SET_INCOMPATIBLE_SETS;
+    }
+    if (set == other) {
+        return SET_SUCCESS;
+    }
+
+    if (set->compareElements != NULL) { // merge other into the sorted list, linking each new node after the last smaller one
+        Node* last = NULL;
+        Node* ptr = set->head;
+        for (Node* ptr_other = other->head; ptr_other != NULL; ptr_other = ptr_other->next) {
+            int order = -1;
+            while (ptr != NULL && (order = set->compareElements(ptr->data, ptr_other->data)) < 0) {
+                last = ptr;
+                ptr = ptr->next;
+            }
+            if (ptr != NULL && order == 0) {
+                continue;
+            }
+            if (appendElement(set, ptr_other->data, &last) != SET_SUCCESS) {
+                return SET_OUT_OF_MEMORY;
+            }
+        }
+        return SET_SUCCESS;
+    }
+
+    for (Node* ptr = other->head; ptr != NULL; ptr = ptr->next) {
+        if (setAdd(set, ptr->data) == SET_OUT_OF_MEMORY) {
+            return SET_OUT_OF_MEMORY;
+        }
     }
 
-    ptr = set2->head;
+    return SET_SUCCESS;
+}
+
+SetResult setIntersectWith(Set set, Set other)
+{
+    if (set == NULL || other == NULL) {
+        return SET_NULL_ARG;
+    }
+    if (!haveSameFunctions(set, other)) {
+        return SET_INCOMPATIBLE_SETS;
+    }
+
+    Node* ptr_other = other->head;
+    Node* ptr = set->head;
     while (ptr != NULL) {
-        if (setContains(set1, ptr->data))
-            setAdd(set, ptr->data);
-        ptr = ptr->next;
+        Node* next = ptr->next;
+        bool found;
+        if (set->compareElements != NULL) { // both lists are sorted, so other is only walked once
+            int order = 1;
+            while (ptr_other != NULL && (order = set->compareElements(ptr_other->data, ptr->data)) < 0) {
+                ptr_other = ptr_other->next;
+            }
+            found = (ptr_other != NULL && order == 0);
+        }
+        else {
+            found = (lookupNode(other, ptr->data) != NULL);
+        }
+        if (!found) {
+            deleteNode(set, ptr);
+        }
+        ptr = next;
     }
 
-    return set;
+    return SET_SUCCESS;
 }
 
 Set setFilter(Set set, ElemConditionFunction condition, void* param)
@@ -271,18 +493,82 @@ Set setFilter(Set set, ElemConditionFunction condition, void* param)
         return NULL;
     }
 
-    Set new_set = setCreate(set->copyElement, set->freeElement, set->equalElements);
+    Set new_set = createEmptyCopy(set);
+    if (new_set == NULL) {
+        return NULL;
+    }
 
+    Node* tail = NULL;
     Node* ptr = set->head;
     while (ptr != NULL) {
-        if (condition(ptr->data, param))
-            setAdd(new_set, ptr->data);
+        if (condition(ptr->data, param) && appendElement(new_set, ptr->data, &tail) != SET_SUCCESS) {
+            setDestroy(new_set);
+            return NULL;
+        }
         ptr = ptr->next;
     }
 
     return new_set;
 }
 
+Set setFilterParallel(Set set, ElemConditionFunction condition, void* param, ThreadPool pool)
+{
+    if (set == NULL || condition == NULL || pool == NULL) {
+        return NULL;
+    }
+
+    if (set->size == 0) {
+        return createEmptyCopy(set);
+    }
+
+    int task_count = threadPoolGetThreadCount(pool) * PARALLEL_TASKS_PER_THREAD;
+    if (task_count > (set->size + MIN_PARALLEL_TASK_SIZE - 1) / MIN_PARALLEL_TASK_SIZE) {
+        task_count = (set->size + MIN_PARALLEL_TASK_SIZE - 1) / MIN_PARALLEL_TASK_SIZE;
+    }
+    Set new_set = createEmptyCopy(set);
+    FilterTask* tasks = (FilterTask*)malloc(task_count * sizeof(FilterTask));
+    bool* passed = (bool*)malloc(set->size * sizeof(bool));
+    if (new_set == NULL || tasks == NULL || passed == NULL) {
+        setDestroy(new_set);
+        free(tasks);
+        free(passed);
+        return NULL;
+    }
+    Node* ptr = set->head;
+    for (int i = 0, offset = 0; i < task_count; offset += tasks[i].count, i++) {
+        tasks[i].first = ptr;
+        tasks[i].count = set->size / task_count + (i < set->size % task_count);
+        tasks[i].condition = condition;
+        tasks[i].param = param;
+        tasks[i].passed = passed + offset;
+        for (int j = 0; j < tasks[i].count; j++, ptr = ptr->next);
+    }
+    threadPoolRun(pool, filterTask, tasks, sizeof(FilterTask), task_count);
+    free(tasks);
+
+    Node* tail = NULL;
+    int index = 0;
+    for (ptr = set->head; ptr != NULL; ptr = ptr->next, index++) {
+        if (passed[index] && appendElement(new_set, ptr->data, &tail) != SET_SUCCESS) {
+            setDestroy(new_set);
+            free(passed);
+            return NULL;
+        }
+    }
+    free(passed);
+
+    return new_set;
+}
+
+SetResult setGetFilterStatistics(Set set, BloomFilterStatistics* statistics)
+{
+    if (set == NULL || set->filter == NULL || statistics == NULL) {
+        return SET_NULL_ARG;
+    }
+    *statistics = bloomFilterGetStatistics(set->filter);
+    return SET_SUCCESS;
+}
+
 Element setGetFirst(Set set)
 {
     if (set == NULL || set->head == NULL) {
@@ -290,7 +576,7 @@ Element setGetFirst(Set set)
     }
 
     set->iterator = set->head;
-    return set->copyElement(set->iterator->data);
+    return copyForCaller(set, set->iterator->data);
 }
 
 Element setGetNext(Set set)
@@ -300,30 +586,399 @@ Element setGetNext(Set set)
     }
 
     set->iterator = set->iterator->next;
-    return set->copyElement(set->iterator->data);
+    return copyForCaller(set, set->iterator->data);
+}
+
+Element setCursorFirst(Set set, SetCursor* cursor)
+{
+    if (set == NULL || cursor == NULL) {
+        return NULL;
+    }
+    cursor->set = set;
+    cursor->node = set->head;
+    cursor->version = set->version;
+    return (set->head == NULL ? NULL : set->head->data);
+}
+
+Element setCursorNext(SetCursor* cursor)
+{
+    Node* node = cursorNode(cursor);
+    if (node == NULL) {
+        return NULL;
+    }
+    cursor->node = node->next;
+    return (node->next == NULL ? NULL : node->next->data);
+}
+
+Element setCursorGet(SetCursor* cursor)
+{
+    Node* node = cursorNode(cursor);
+    return (node == NULL ? NULL : node->data);
+}
+
+SetResult setForEach(Set set, ElemVisitFunction visit, void* context)
+{
+    if (set == NULL || visit == NULL) {
+        return SET_NULL_ARG;
+    }
+    for (Node* ptr = set->head; ptr != NULL && visit(ptr->data, context); ptr = ptr->next);
+
+    return SET_SUCCESS;
+}
+
+static Set allocateSet(ElemCopyFunction copyElement, ElemFreeFunction freeElement, ElemEqualFunction equalElements)
+{
+    Set set = (Set)malloc(sizeof(*set));
+    if(set == NULL) {
+        return NULL;
+    }
+    set->size = 0;
+    set->version = 0;
+    set->head = NULL;
+    set->iterator = NULL;
+    set->copyElement = copyElement;
+    set->freeElement = freeElement;
+    set->equalElements = equalElements;
+    set->compareElements = NULL;
+    set->pool = NULL;
+    set->hashElement = NULL;
+    set->table = NULL;
+    set->old_table = NULL;
+    set->filter = NULL;
+    set->filterHash = NULL;
+
+    return set;
 }
 
 static Node* createNodeElement(Set set, Element element)
 {
-    Node* new_node = (Node*)malloc(sizeof(*new_node));
-    if (new_node == NULL) {
+    Element data = (set->pool != NULL ? (Element)internPoolIntern(set->pool, element) : set->copyElement(element));
+    if (data == NULL) {
         return NULL;
     }
 
-    new_node->data = set->copyElement(element);
-    if(new_node->data == NULL) {
-        free(new_node);
+    Node* new_node = wrapNodeElement(set, data);
+    if (new_node == NULL && set->pool == NULL) {
+        set->freeElement(data);
+    }
+
+    return new_node;
+}
+
+static Node* wrapNodeElement(Set set, Element data)
+{
+    Node* new_node = (Node*)malloc(sizeof(*new_node));
+    if (new_node == NULL) {
         return NULL;
     }
 
+    new_node->data = data;
+    new_node->next = NULL;
+    new_node->prev = NULL;
     set->size++;
+    set->version++;
+    if (set->filter != NULL) {
+        filterElement(set, data);
+    }
 
     return new_node;
 }
 
+/* Returns the node of the element equal to the given one, or NULL if there is none, and then
+ * sets *last to the node a new element should be linked after: the last node of the set, or in an
+ * ordered set the last node before the element (NULL if it should be first).
+ * In a filtered set, an element the filter rules out is not searched for, and is linked first. */
+static Node* findNode(Set set, Element element, Node** last)
+{
+    *last = NULL;
+    bool may_contain = (set->filter == NULL || bloomFilterMayContain(set->filter, set->filterHash(element)));
+    Node* node = NULL;
+    for (Node* ptr = (may_contain ? set->head : NULL); ptr != NULL; ptr = ptr->next) {
+        if (set->compareElements != NULL) {
+            int order = set->compareElements(ptr->data, element);
+            if (order >= 0) {
+                node = (order == 0 ? ptr : NULL);
+                break;
+            }
+        }
+        else if (set->equalElements(ptr->data, element)) {
+            node = ptr;
+            break;
+        }
+        *last = ptr;
+    }
+    if (set->filter != NULL) {
+        bloomFilterCountLookup(set->filter, may_contain, node != NULL);
+    }
+
+    return node;
+}
+
+/* Returns the node a cursor is at, or NULL if it is past the end or its set was changed since. */
+static Node* cursorNode(SetCursor* cursor)
+{
+    if (cursor == NULL || cursor->set == NULL || cursor->version != cursor->set->version) {
+        return NULL;
+    }
+    return (Node*)cursor->node;
+}
+
+/* Returns the node of the element equal to the given one, or NULL if there is none. */
+static Node* lookupNode(Set set, Element element)
+{
+    if (set->hashElement != NULL) {
+        Node** slot = findSlot(set, element, set->hashElement(element));
+        return (slot == NULL ? NULL : *slot);
+    }
+    Node* last;
+    return findNode(set, element, &last);
+}
+
+/* Adds a copy of an element which is known not to be in the set, right after *tail
+ * (first if it is NULL), and sets *tail to its node. A hashed set links it first instead. */
+static SetResult appendElement(Set set, Element element, Node** tail)
+{
+    if (set->hashElement != NULL) {
+        return addHashed(set, element, false);
+    }
+    Node* node = createNodeElement(set, element);
+    if (node == NULL) {
+        return SET_OUT_OF_MEMORY;
+    }
+    linkNode(set, node, *tail);
+    *tail = node;
+
+    return SET_SUCCESS;
+}
+
+/* Unlinks a node of the set (and clears its slot, in a hashed set) and frees it. */
+static void deleteNode(Set set, Node* node)
+{
+    if (set->hashElement != NULL) {
+        *findSlot(set, node->data, node->hash) = REMOVED;
+    }
+    if (node->prev == NULL) {
+        set->head = node->next;
+    }
+    else {
+        node->prev->next = node->next;
+    }
+    if (node->next != NULL) {
+        node->next->prev = node->prev;
+    }
+    if (set->iterator == node) {
+        set->iterator = NULL;
+    }
+    removeNodeElement(set, node);
+    rehashStep(set);
+}
+
 static void removeNodeElement(Set set, Node* node)
 {
-    set->freeElement(node->data);
+    if (set->pool == NULL) { // the pool's strings are freed with the pool
+        set->freeElement(node->data);
+    }
     set->size--;
+    set->version++;
     free(node);
 }
+
+/* Creates an empty set which stores its elements the same way as the given set. */
+static Set createEmptyCopy(Set set)
+{
+    if (set->pool != NULL) {
+        return setCreateInterned(set->pool);
+    }
+    if (set->hashElement != NULL) {
+        return setCreateHashed(set->copyElement, set->freeElement, set->equalElements, set->hashElement);
+    }
+    if (set->compareElements != NULL) {
+        return setCreateOrdered(set->copyElement, set->freeElement, set->compareElements);
+    }
+    if (set->filter != NULL) {
+        return setCreateFiltered(set->copyElement, set->freeElement, set->equalElements, set->filterHash,
+                                 bloomFilterGetCapacity(set->filter), bloomFilterGetFalsePositiveRate(set->filter));
+    }
+    return setCreate(set->copyElement, set->freeElement, set->equalElements);
+}
+
+/* The elements which are handed to the caller are copies, except for the pool's strings,
+ * which the caller may keep (and must not free) as long as the pool lives. */
+static Element copyForCaller(Set set, Element element)
+{
+    return (set->pool != NULL ? element : set->copyElement(element));
+}
+
+/* Two sets can only be combined if they store, compare and index their elements the same way. */
+static bool haveSameFunctions(Set set1, Set set2)
+{
+    return set1->copyElement == set2->copyElement &&
+           set1->freeElement == set2->freeElement &&
+           set1->equalElements == set2->equalElements &&
+           set1->compareElements == set2->compareElements &&
+           set1->hashElement == set2->hashElement &&
+           set1->pool == set2->pool;
+}
+
+static bool equalInterned(Element a, Element b)
+{
+    return a == b || strcmp((const char*)a, (const char*)b) == 0;
+}
+
+/* Links a node right after the given one, or first in the set if after is NULL. */
+static void linkNode(Set set, Node* node, Node* after)
+{
+    node->prev = after;
+    node->next = (after == NULL ? set->head : after->next);
+    if (node->next != NULL) {
+        node->next->prev = node;
+    }
+    if (after == NULL) {
+        set->head = node;
+    }
+    else {
+        after->next = node;
+    }
+}
+
+/* Adds the hash of a new element to the filter. Once the filter is full, it is rebuilt from
+ * the elements already in the set (which also drops the hashes of the removed ones),
+ * with room for twice as many. */
+static void filterElement(Set set, Element data)
+{
+    if (bloomFilterGetCount(set->filter) >= bloomFilterGetCapacity(set->filter)) {
+        int capacity = 2 * set->size;
+        if (capacity < bloomFilterGetCapacity(set->filter)) {
+            capacity = bloomFilterGetCapacity(set->filter);
+        }
+        if (bloomFilterReset(set->filter, capacity)) { // if this fails, the old hashes are kept
+            for (Node* ptr = set->head; ptr != NULL; ptr = ptr->next) {
+                bloomFilterAdd(set->filter, set->filterHash(ptr->data));
+            }
+        }
+    }
+    bloomFilterAdd(set->filter, set->filterHash(data));
+}
+
+static SetResult addHashed(Set set, Element element, bool take)
+{
+    size_t hash = set->hashElement(element);
+    if (findSlot(set, element, hash) != NULL) {
+        if (take) {
+            set->freeElement(element);
+        }
+        return SET_ITEM_ALREADY_EXISTS;
+    }
+    if (!reserveSlot(set)) {
+        return SET_OUT_OF_MEMORY;
+    }
+
+    Node* node = (take ? wrapNodeElement(set, element) : createNodeElement(set, element));
+    if (node == NULL) {
+        return SET_OUT_OF_MEMORY;
+    }
+    node->hash = hash;
+    insertSlot(set, set->table, set->capacity, node);
+    linkNode(set, node, NULL); // the order of a hashed set does not matter, and the head is always at hand
+    rehashStep(set);
+
+    return SET_SUCCESS;
+}
+
+/* Returns the slot of the node equal to the element, in the table or in the old table,
+ * or NULL if there is no such node. */
+static Node** findSlot(Set set, Element element, size_t hash)
+{
+    Node** tables[2] = { set->table, set->old_table };
+    size_t capacities[2] = { set->capacity, set->old_capacity };
+    for (int i = 0; i < 2 && tables[i] != NULL; i++) {
+        size_t mask = capacities[i] - 1;
+        for (size_t index = hash & mask; tables[i][index] != NULL; index = (index + 1) & mask) {
+            Node* node = tables[i][index];
+            if (node != REMOVED && node->hash == hash && set->equalElements(node->data, element)) {
+                return &tables[i][index];
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Makes sure the table has room for one more node, so probing always ends at an empty slot.
+ * Returns false if the table had to grow and that failed. */
+static bool reserveSlot(Set set)
+{
+    if (4 * (set->used + 1) <= 3 * set->capacity) {
+        return true;
+    }
+    while (set->old_table != NULL) { // finish moving the nodes before the table is replaced again
+        rehashStep(set);
+    }
+    return startRehash(set);
+}
+
+static void insertSlot(Set set, Node** table, size_t capacity, Node* node)
+{
+    size_t mask = capacity - 1;
+    size_t index = node->hash & mask;
+    while (table[index] != NULL && table[index] != REMOVED) {
+        index = (index + 1) & mask;
+    }
+    if (table[index] == NULL && table == set->table) {
+        set->used++;
+    }
+    table[index] = node;
+}
+
+/* Replaces the table with a new one, which is at most half full even after the nodes that can
+ * be added before all of the old table's slots are moved (one add moves REHASH_STEP slots).
+ * The nodes stay in the old table, and are moved by the following calls to rehashStep. */
+static bool startRehash(Set set)
+{
+    size_t nodes = (size_t)set->size + 1 + set->capacity / REHASH_STEP;
+    size_t capacity = INITIAL_CAPACITY;
+    while (capacity < 2 * nodes) {
+        capacity *= 2;
+    }
+    Node** table = (Node**)calloc(capacity, sizeof(Node*));
+    if (table == NULL) {
+        return false;
+    }
+    set->old_table = set->table;
+    set->old_capacity = set->capacity;
+    set->moved = 0;
+    set->table = table;
+    set->capacity = capacity;
+    set->used = 0;
+    return true;
+}
+
+/* Moves the nodes of the next REHASH_STEP slots of the old table to the new one.
+ * A moved node's old slot is marked as removed, not emptied, so the nodes which come
+ * after it in the old table can still be found. */
+static void rehashStep(Set set)
+{
+    if (set->old_table == NULL) {
+        return;
+    }
+    size_t end = set->moved + REHASH_STEP;
+    for (; set->moved < end && set->moved < set->old_capacity; set->moved++) {
+        Node* node = set->old_table[set->moved];
+        if (node != NULL && node != REMOVED) {
+            insertSlot(set, set->table, set->capacity, node);
+            set->old_table[set->moved] = REMOVED;
+        }
+    }
+    if (set->moved == set->old_capacity) {
+        free(set->old_table);
+        set->old_table = NULL;
+    }
+}
+
+static void filterTask(void* task)
+{
+    FilterTask* filter_task = (FilterTask*)task;
+    Node* ptr = filter_task->first;
+    for (int i = 0; i < filter_task->count; ptr = ptr->next, i++) {
+        filter_task->passed[i] = filter_task->condition(ptr->data, filter_task->param);
+    }
+}
@@ -2,40 +2,90 @@
 #define SET_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+
+// declared again here, so the set does not pull in intern_pool.h, bloom_filter.h and thread_pool.h
+// (include them to create the pools or to read the fields of the filter statistics)
+typedef struct intern_pool_t * InternPool;
+typedef struct bloom_filter_statistics_t BloomFilterStatistics;
+typedef struct thread_pool_t * ThreadPool;
 
 typedef void* Element;
 typedef Element (*ElemCopyFunction)(Element);
 typedef void (*ElemFreeFunction)(Element);
 typedef bool (*ElemEqualFunction)(Element a, Element b);  // return a == b
 typedef bool (*ElemConditionFunction)(Element, void* param);
+typedef size_t (*ElemHashFunction)(Element);  // equal elements must have equal hashes
+typedef int (*ElemCompareFunction)(Element a, Element b);  // return <0, 0 or >0 if a is before, equal to or after b
+typedef bool (*ElemVisitFunction)(Element, void* context); // return false to stop the visit
 
 typedef struct set_t* Set;
 
+// A position in a set, so any number of scans can run at once. The fields are private.
+// Adding or removing elements invalidates the set's cursors, and then they return NULL.
+typedef struct set_cursor_t {
+    Set set;
+    void* node;
+    unsigned long version;
+} SetCursor;
+
 typedef enum {
     SET_SUCCESS,
     SET_OUT_OF_MEMORY,
-    SET_NULL_ARG
+    SET_NULL_ARG,
+    SET_ITEM_ALREADY_EXISTS,
+    SET_ITEM_DOES_NOT_EXIST,
+    SET_INCOMPATIBLE_SETS
 } SetResult;
 
 Set setCreate(ElemCopyFunction, ElemFreeFunction, ElemEqualFunction);
+Set setCreateInterned(InternPool pool); // a set of strings, kept once in the pool (which must outlive the set)
+Set setCreateHashed(ElemCopyFunction, ElemFreeFunction, ElemEqualFunction, ElemHashFunction); // O(1) expected add, remove and contains
+Set setCreateOrdered(ElemCopyFunction, ElemFreeFunction, ElemCompareFunction); // kept sorted, so two sets are merged in linear time
+Set setCreateFiltered(ElemCopyFunction, ElemFreeFunction, ElemEqualFunction, ElemHashFunction,
+                      int expected_size, double false_positive_rate); // a Bloom filter answers most lookups of absent elements
 Set setCopy(Set set);
 void setDestroy(Set set);
 SetResult setAdd(Set set, Element element);
+// setAddTake takes ownership of element without a copy (and frees it if the set already has an equal one),
+// except in an interned set, which interns the string like setAdd does, so there it still belongs to the caller.
+SetResult setAddTake(Set set, Element element);
 SetResult setRemove(Set set, Element element);
-Element setContains(Set set, Element element);
+SetResult setClear(Set set);
+bool setContains(Set set, Element element);
 Element setFind(Set set, Element element);
+Element setFindRef(Set set, Element element); // the element in the set itself (not a copy), valid until it is removed
 int setGetSize(Set set);
 bool setIsEmpty(Set set);
-Set setUnion(Set set1, Set set2);
+Set setUnion(Set set1, Set set2); // both take O(n + m) (expected) for hashed and ordered sets
 Set setIntersection(Set set1, Set set2);
+SetResult setUniteWith(Set set, Set other); // adds other's elements to set, without a third set
+SetResult setIntersectWith(Set set, Set other); // removes from set the elements which are not in other
 Set setFilter(Set set, ElemConditionFunction condition, void* param);
+Set setFilterParallel(Set set, ElemConditionFunction condition, void* param, ThreadPool pool); // condition must be thread-safe
+SetResult setGetFilterStatistics(Set set, BloomFilterStatistics* statistics); // SET_NULL_ARG if the set is not filtered
 Element setGetFirst(Set set); // returns NULL if set is empty
 Element setGetNext(Set set); // returns NULL if no more elements
 
-// Macro to enable simple iteration
+// The cursor functions and setForEach return the elements in the set (not copies) and do not touch
+// the internal iterator, so a set which is not being modified can be scanned by many readers at once
+// (along with setFindRef and setContains; in a filtered set they also count the lookup in its statistics,
+// which is safe to do at once).
+Element setCursorFirst(Set set, SetCursor* cursor); // returns NULL if set is empty
+Element setCursorNext(SetCursor* cursor); // returns NULL if no more elements
+Element setCursorGet(SetCursor* cursor); // the element the cursor is at
+SetResult setForEach(Set set, ElemVisitFunction visit, void* context);
+
+// Macro to enable simple iteration (every element is a copy, which the caller must free)
 #define SET_FOREACH(Type, element, set) \
     for (Type element = setGetFirst(set); \
         element != NULL; \
         element = setGetNext(set))
 
+// Macro to iterate over the elements themselves, with a SetCursor declared by the caller
+#define SET_FOREACH_REF(Type, element, cursor, set) \
+    for (Type element = setCursorFirst(set, &(cursor)); \
+        element != NULL; \
+        element = setCursorNext(&(cursor)))
+
 #endif /* SET_H_ */ 
@@ -8,6 +8,8 @@ typedef struct node_t {
 } Node;
 
 static Node* createNode(Stack stack, Element element);
+static Node* wrapElement(Stack stack, Element data);
+static Element unlinkHead(Stack stack);
 
 struct stack_t {
     Node* head;
@@ -84,17 +86,27 @@ Stack stackCopy(Stack stack)
 
 static Node* createNode(Stack stack, Element element)
 {
-    Node* new_node = (Node*)malloc(sizeof(*new_node));
-    if (new_node == NULL) {
+    Element data = stack->copyElement(element);
+    if (data == NULL) {
         return NULL;
     }
-    
-    new_node->data = stack->copyElement(element);
-    if(new_node->data == NULL) {
-        free(new_node);
+
+    Node* new_node = wrapElement(stack, data);
+    if (new_node == NULL) {
+        stack->freeElement(data);
+    }
+
+    return new_node;
+}
+
+static Node* wrapElement(Stack stack, Element data)
+{
+    Node* new_node = (Node*)malloc(sizeof(*new_node));
+    if (new_node == NULL) {
         return NULL;
     }
 
+    new_node->data = data;
     new_node->next = NULL;
     stack->size++;
 
@@ -118,6 +130,23 @@ StackResult stackPush(Stack stack, Element element)
     return STACK_SUCCESS;
 }
 
+StackResult stackPushTake(Stack stack, Element element)
+{
+    if (stack == NULL || element == NULL) {
+        return STACK_NULL_ARG;
+    }
+
+    Node* node = wrapElement(stack, element);
+    if (node == NULL) {
+        return STACK_OUT_OF_MEMORY;
+    }
+
+    node->next = stack->head;
+    stack->head = node;
+
+    return STACK_SUCCESS;
+}
+
 StackResult stackPop(Stack stack)
 {
     if (stack == NULL) {
@@ -128,14 +157,36 @@ StackResult stackPop(Stack stack)
         return STACK_IS_EMPTY;
     }
   
+    stack->freeElement(unlinkHead(stack));
+
+    return STACK_SUCCESS;
+}
+
+StackResult stackPopTake(Stack stack, Element* element)
+{
+    if (stack == NULL || element == NULL) {
+        return STACK_NULL_ARG;
+    }
+
+    if (stackIsEmpty(stack)) {
+        return STACK_IS_EMPTY;
+    }
+
+    *element = unlinkHead(stack);
+
+    return STACK_SUCCESS;
+}
+
+static Element unlinkHead(Stack stack)
+{
     Node* to_remove = stack->head;
     stack->head = stack->head->next;
 
-    stack->freeElement(to_remove->data);
+    Element data = to_remove->data;
     free(to_remove);
     stack->size--;
 
-    return STACK_SUCCESS;
+    return data;
 }
 
 StackResult stackTop(Stack stack, Element* element)
@@ -20,7 +20,9 @@ Stack stackCreate(ElemCopyFunction, ElemFreeFunction);
 Stack stackCopy(Stack stack);
 void stackDestroy(Stack stack);
 StackResult stackPush(Stack stack, Element element);
+StackResult stackPushTake(Stack stack, Element element); // takes ownership of element, no copy
 StackResult stackPop(Stack stack);
+StackResult stackPopTake(Stack stack, Element* element); // hands the top element to the caller
 StackResult stackTop(Stack stack, Element* element);
 int stackGetSize(Stack stack);
 bool stackIsEmpty(Stack stack);
@@ -0,0 +1,825 @@
+#include "string_map.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#define NULL_MAP_SIZE -1
+
+/**
+* The map is an adaptive radix tree. A key is followed from the root byte by byte,
+* including its terminating NUL, so no key is a prefix of another key, and every key ends in a leaf.
+*
+* Every node has a prefix: the bytes which all of the keys below it share at that point.
+* The prefix is stored right after the node's struct, in the same allocation.
+* An inner node matches its prefix and then picks a child by the next byte of the key.
+* A leaf's prefix is the rest of its key (up to and including the NUL), so the bytes
+* of a key are spread along its path, and bytes which keys share are stored once.
+*
+* Inner nodes come in four sizes, and grow or shrink to the next size when needed:
+*   NODE4 and NODE16 keep the bytes of their children sorted, next to the children.
+*   NODE48 maps every byte to one of its 48 children (0 means no child).
+*   NODE256 has a child for every byte.
+*/
+#define NODE48_SHRINK_COUNT 12  // a NODE48 with this many children becomes a NODE16
+#define NODE256_SHRINK_COUNT 37 // not 48, so adding and removing a single child does not resize over and over
+
+typedef enum {
+    NODE4,
+    NODE16,
+    NODE48,
+    NODE256,
+    LEAF
+} NodeType;
+
+typedef struct node_t {
+    unsigned char type;
+    short count; // the number of children
+    int prefix_length;
+} Node;
+
+typedef struct node4_t {
+    Node header;
+    unsigned char keys[4];
+    Node* children[4];
+} Node4;
+
+typedef struct node16_t {
+    Node header;
+    unsigned char keys[16];
+    Node* children[16];
+} Node16;
+
+typedef struct node48_t {
+    Node header;
+    unsigned char index[256];
+    Node* children[48];
+} Node48;
+
+typedef struct node256_t {
+    Node header;
+    Node* children[256];
+} Node256;
+
+typedef struct leaf_t {
+    Node header;
+    MapDataElement data;
+} Leaf;
+
+static const size_t NODE_SIZES[] = { sizeof(Node4), sizeof(Node16), sizeof(Node48), sizeof(Node256), sizeof(Leaf) };
+static const int NODE_CAPACITIES[] = { 4, 16, 48, 256, 0 };
+
+typedef struct visit_state_t {
+    char* buffer; // the key of the visited node, up to the node
+    size_t capacity;
+    visitStringMapElements visit;
+    void* context;
+    bool stopped;
+    bool failed;
+} VisitState;
+
+static Node* createNode(NodeType type, const unsigned char* prefix, int prefix_length);
+static Leaf* createLeaf(StringMap map, const unsigned char* suffix, int suffix_length, MapDataElement dataElement);
+static void destroyNode(StringMap map, Node* node);
+static Node* cloneNode(StringMap map, Node* source);
+static unsigned char* prefixOf(Node* node);
+static int matchPrefix(Node* node, const unsigned char* bytes, size_t length);
+static Leaf* findLeaf(StringMap map, const char* key);
+static Node** findChild(Node* node, unsigned char byte);
+static Node* nextChild(Node* node, int* cursor, unsigned char* byte);
+static Node** childSlots(Node* node, int* slots);
+static void insertChild(Node* node, unsigned char byte, Node* child);
+static void deleteChild(Node* node, unsigned char byte);
+static bool addChild(Node** reference, unsigned char byte, Node* child);
+static void removeChild(Node** reference, unsigned char byte);
+static Node* resizeNode(Node* node, NodeType type);
+static Node* collapseNode(Node* node);
+static MapResult splitNode(StringMap map, Node** reference, int matched,
+                           const unsigned char* bytes, size_t length, MapDataElement dataElement);
+static bool reserveBuffer(VisitState* state, size_t size);
+static bool visitNode(Node* node, size_t length, VisitState* state);
+
+struct string_map_t {
+    Node* root;
+    int size;
+    copyMapDataElements copyDataElement;
+    freeMapDataElements freeDataElement;
+};
+
+StringMap stringMapCreate(copyMapDataElements copyDataElement, freeMapDataElements freeDataElement)
+{
+    if (copyDataElement == NULL || freeDataElement == NULL) {
+        return NULL;
+    }
+    StringMap map = (StringMap)malloc(sizeof(*map));
+    if (map == NULL) {
+        return NULL;
+    }
+    map->root = NULL;
+    map->size = 0;
+    map->copyDataElement = copyDataElement;
+    map->freeDataElement = freeDataElement;
+
+    return map;
+}
+
+void stringMapDestroy(StringMap map)
+{
+    if (map == NULL) {
+        return;
+    }
+    stringMapClear(map);
+    free(map);
+}
+
+StringMap stringMapCopy(StringMap map)
+{
+    if (map == NULL) {
+        return NULL;
+    }
+    StringMap new_map = stringMapCreate(map->copyDataElement, map->freeDataElement);
+    if (new_map == NULL) {
+        return NULL;
+    }
+    if (map->root != NULL) {
+        new_map->root = cloneNode(map, map->root);
+        if (new_map->root == NULL) {
+            stringMapDestroy(new_map);
+            return NULL;
+        }
+    }
+    new_map->size = map->size;
+
+    return new_map;
+}
+
+int stringMapGetSize(StringMap map)
+{
+    if (map == NULL) {
+        return NULL_MAP_SIZE;
+    }
+    return map->size;
+}
+
+bool stringMapContains(StringMap map, const char* key)
+{
+    if (map == NULL || key == NULL) {
+        return false;
+    }
+    return findLeaf(map, key) != NULL;
+}
+
+MapResult stringMapPut(StringMap map, const char* key, MapDataElement dataElement)
+{
+    if (map == NULL || key == NULL || dataElement == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    const unsigned char* bytes = (const unsigned char*)key;
+    size_t length = strlen(key) + 1; // the terminating NUL is a part of the key
+    size_t depth = 0;
+    Node** reference = &map->root;
+    while (*reference != NULL) {
+        Node* node = *reference;
+        int matched = matchPrefix(node, bytes + depth, length - depth);
+        if (matched < node->prefix_length) {
+            return splitNode(map, reference, matched, bytes + depth, length - depth, dataElement);
+        }
+        if (node->type == LEAF) {
+            // the whole prefix of the leaf, including its NUL, matched: this is the same key
+            MapDataElement data = map->copyDataElement(dataElement);
+            if (data == NULL) {
+                return MAP_OUT_OF_MEMORY;
+            }
+            map->freeDataElement(((Leaf*)node)->data);
+            ((Leaf*)node)->data = data;
+            return MAP_SUCCESS;
+        }
+
+        depth += matched;
+        Node** child = findChild(node, bytes[depth]);
+        if (child == NULL) {
+            Leaf* leaf = createLeaf(map, bytes + depth + 1, (int)(length - depth - 1), dataElement);
+            if (leaf == NULL) {
+                return MAP_OUT_OF_MEMORY;
+            }
+            if (!addChild(reference, bytes[depth], (Node*)leaf)) {
+                destroyNode(map, (Node*)leaf);
+                return MAP_OUT_OF_MEMORY;
+            }
+            map->size++;
+            return MAP_SUCCESS;
+        }
+        reference = child;
+        depth++;
+    }
+
+    Leaf* leaf = createLeaf(map, bytes + depth, (int)(length - depth), dataElement);
+    if (leaf == NULL) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    *reference = (Node*)leaf;
+    map->size++;
+
+    return MAP_SUCCESS;
+}
+
+MapDataElement stringMapGet(StringMap map, const char* key)
+{
+    if (map == NULL || key == NULL) {
+        return NULL;
+    }
+    Leaf* leaf = findLeaf(map, key);
+    return (leaf == NULL ? NULL : leaf->data);
+}
+
+MapResult stringMapRemove(StringMap map, const char* key)
+{
+    if (map == NULL || key == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    const unsigned char* bytes = (const unsigned char*)key;
+    size_t length = strlen(key) + 1;
+    size_t depth = 0;
+    Node** reference = &map->root;
+    Node** parent = NULL;
+    unsigned char byte = 0; // the byte which leads from the parent to the node
+    while (*reference != NULL) {
+        Node* node = *reference;
+        int matched = matchPrefix(node, bytes + depth, length - depth);
+        if (matched < node->prefix_length) {
+            return MAP_ITEM_DOES_NOT_EXIST;
+        }
+        if (node->type == LEAF) {
+            break;
+        }
+        depth += matched;
+        parent = reference;
+        byte = bytes[depth];
+        reference = findChild(node, byte);
+        if (reference == NULL) {
+            return MAP_ITEM_DOES_NOT_EXIST;
+        }
+        depth++;
+    }
+    if (*reference == NULL) {
+        return MAP_ITEM_DOES_NOT_EXIST;
+    }
+
+    destroyNode(map, *reference);
+    if (parent == NULL) {
+        map->root = NULL;
+    }
+    else {
+        removeChild(parent, byte);
+    }
+    map->size--;
+
+    return MAP_SUCCESS;
+}
+
+MapResult stringMapClear(StringMap map)
+{
+    if (map == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    destroyNode(map, map->root);
+    map->root = NULL;
+    map->size = 0;
+
+    return MAP_SUCCESS;
+}
+
+MapResult stringMapForEach(StringMap map, visitStringMapElements visit, void* context)
+{
+    return stringMapPrefixForEach(map, "", visit, context);
+}
+
+MapResult stringMapPrefixForEach(StringMap map, const char* prefix, visitStringMapElements visit, void* context)
+{
+    if (map == NULL || prefix == NULL || visit == NULL) {
+        return MAP_NULL_ARGUMENT;
+    }
+
+    VisitState state = { NULL, 0, visit, context, false, false };
+    const unsigned char* bytes = (const unsigned char*)prefix;
+    size_t length = strlen(prefix);
+    size_t depth = 0;
+    Node* node = map->root;
+    while (node != NULL) {
+        int matched = matchPrefix(node, bytes + depth, length - depth);
+        if (depth + matched == length) {
+            // the prefix ends inside this node, so all of the keys below it start with the prefix
+            if (reserveBuffer(&state, length + 1)) {
+                memcpy(state.buffer, prefix, length);
+                visitNode(node, depth, &state);
+            }
+            break;
+        }
+        if (matched < node->prefix_length || node->type == LEAF) {
+            break;
+        }
+        depth += matched;
+        Node** child = findChild(node, bytes[depth]);
+        node = (child == NULL ? NULL : *child);
+        depth++;
+    }
+
+    free(state.buffer);
+    return state.failed ? MAP_OUT_OF_MEMORY : MAP_SUCCESS;
+}
+
+// ============================ NODES ============================ //
+
+static Node* createNode(NodeType type, const unsigned char* prefix, int prefix_length)
+{
+    Node* node = (Node*)calloc(1, NODE_SIZES[type] + prefix_length);
+    if (node == NULL) {
+        return NULL;
+    }
+    node->type = type;
+    node->count = 0;
+    node->prefix_length = prefix_length;
+    memcpy(prefixOf(node), prefix, prefix_length);
+
+    return node;
+}
+
+/**
+* Creates a leaf with a copy of the data element, for a key which ends with the given bytes.
+*/
+static Leaf* createLeaf(StringMap map, const unsigned char* suffix, int suffix_length, MapDataElement dataElement)
+{
+    MapDataElement data = map->copyDataElement(dataElement);
+    if (data == NULL) {
+        return NULL;
+    }
+    Leaf* leaf = (Leaf*)createNode(LEAF, suffix, suffix_length);
+    if (leaf == NULL) {
+        map->freeDataElement(data);
+        return NULL;
+    }
+    leaf->data = data;
+
+    return leaf;
+}
+
+static void destroyNode(StringMap map, Node* node)
+{
+    if (node == NULL) {
+        return;
+    }
+    if (node->type == LEAF) {
+        map->freeDataElement(((Leaf*)node)->data);
+    }
+    else {
+        int slots;
+        Node** children = childSlots(node, &slots);
+        for (int i = 0; i < slots; i++) {
+            destroyNode(map, children[i]);
+        }
+    }
+    free(node);
+}
+
+/**
+* Copies a subtree node by node, so the copy has the exact same shape.
+* Returns NULL if an allocation failed (after freeing whatever was already copied).
+*/
+static Node* cloneNode(StringMap map, Node* source)
+{
+    size_t size = NODE_SIZES[source->type] + source->prefix_length;
+    Node* node = (Node*)malloc(size);
+    if (node == NULL) {
+        return NULL;
+    }
+    memcpy(node, source, size);
+
+    if (node->type == LEAF) {
+        ((Leaf*)node)->data = map->copyDataElement(((Leaf*)source)->data);
+        if (((Leaf*)node)->data == NULL) {
+            free(node);
+            return NULL;
+        }
+        return node;
+    }
+
+    int slots;
+    Node** children = childSlots(node, &slots);
+    for (int i = 0; i < slots; i++) {
+        children[i] = NULL; // so a failed copy only frees the children which were copied
+    }
+    Node** source_children = childSlots(source, &slots);
+    for (int i = 0; i < slots; i++) {
+        if (source_children[i] != NULL) {
+            children[i] = cloneNode(map, source_children[i]);
+            if (children[i] == NULL) {
+                destroyNode(map, node);
+                return NULL;
+            }
+        }
+    }
+
+    return node;
+}
+
+static unsigned char* prefixOf(Node* node)
+{
+    return (unsigned char*)node + NODE_SIZES[node->type];
+}
+
+/**
+* Returns how many bytes of the node's prefix match the given bytes.
+*/
+static int matchPrefix(Node* node, const unsigned char* bytes, size_t length)
+{
+    const unsigned char* prefix = prefixOf(node);
+    int matched = 0;
+    while (matched < node->prefix_length && (size_t)matched < length && prefix[matched] == bytes[matched]) {
+        matched++;
+    }
+    return matched;
+}
+
+static Leaf* findLeaf(StringMap map, const char* key)
+{
+    const unsigned char* bytes = (const unsigned char*)key;
+    size_t length = strlen(key) + 1;
+    size_t depth = 0;
+    Node* node = map->root;
+    while (node != NULL) {
+        int matched = matchPrefix(node, bytes + depth, length - depth);
+        if (matched < node->prefix_length) {
+            return NULL;
+        }
+        if (node->type == LEAF) {
+            return (Leaf*)node;
+        }
+        depth += matched;
+        Node** child = findChild(node, bytes[depth]);
+        node = (child == NULL ? NULL : *child);
+        depth++;
+    }
+    return NULL;
+}
+
+/**
+* Returns the slot of the child which the given byte leads to, or NULL if there is no such child.
+*/
+static Node** findChild(Node* node, unsigned char byte)
+{
+    switch (node->type) {
+    case NODE4: {
+        Node4* node4 = (Node4*)node;
+        for (int i = 0; i < node->count; i++) {
+            if (node4->keys[i] == byte) {
+                return &node4->children[i];
+            }
+        }
+        return NULL;
+    }
+    case NODE16: {
+        Node16* node16 = (Node16*)node;
+        for (int i = 0; i < node->count && node16->keys[i] <= byte; i++) {
+            if (node16->keys[i] == byte) {
+                return &node16->children[i];
+            }
+        }
+        return NULL;
+    }
+    case NODE48: {
+        Node48* node48 = (Node48*)node;
+        return (node48->index[byte] == 0 ? NULL : &node48->children[node48->index[byte] - 1]);
+    }
+    case NODE256: {
+        Node256* node256 = (Node256*)node;
+        return (node256->children[byte] == NULL ? NULL : &node256->children[byte]);
+    }
+    default:
+        return NULL;
+    }
+}
+
+/**
+* Returns the children of an inner node in the order of their bytes, one per call.
+* The cursor should start at 0. Returns NULL after the last child.
+*/
+static Node* nextChild(Node* node, int* cursor, unsigned char* byte)
+{
+    switch (node->type) {
+    case NODE4:
+    case NODE16: {
+        if (*cursor >= node->count) {
+            return NULL;
+        }
+        bool small = (node->type == NODE4);
+        *byte = (small ? ((Node4*)node)->keys : ((Node16*)node)->keys)[*cursor];
+        Node* child = (small ? ((Node4*)node)->children : ((Node16*)node)->children)[*cursor];
+        (*cursor)++;
+        return child;
+    }
+    case NODE48: {
+        Node48* node48 = (Node48*)node;
+        for (; *cursor < 256; (*cursor)++) {
+            if (node48->index[*cursor] != 0) {
+                *byte = (unsigned char)*cursor;
+                return node48->children[node48->index[(*cursor)++] - 1];
+            }
+        }
+        return NULL;
+    }
+    case NODE256: {
+        Node256* node256 = (Node256*)node;
+        for (; *cursor < 256; (*cursor)++) {
+            if (node256->children[*cursor] != NULL) {
+                *byte = (unsigned char)*cursor;
+                return node256->children[(*cursor)++];
+            }
+        }
+        return NULL;
+    }
+    default:
+        return NULL;
+    }
+}
+
+/**
+* Returns the array of child pointers of an inner node, and how many slots it has.
+* In a NODE48 and a NODE256 some of the slots may be NULL.
+*/
+static Node** childSlots(Node* node, int* slots)
+{
+    switch (node->type) {
+    case NODE4:
+        *slots = node->count;
+        return ((Node4*)node)->children;
+    case NODE16:
+        *slots = node->count;
+        return ((Node16*)node)->children;
+    case NODE48:
+        *slots = 48;
+        return ((Node48*)node)->children;
+    case NODE256:
+        *slots = 256;
+        return ((Node256*)node)->children;
+    default:
+        *slots = 0;
+        return NULL;
+    }
+}
+
+/**
+* Adds a child to a node which has room for it, and has no child for that byte yet.
+*/
+static void insertChild(Node* node, unsigned char byte, Node* child)
+{
+    switch (node->type) {
+    case NODE4:
+    case NODE16: {
+        bool small = (node->type == NODE4);
+        unsigned char* keys = (small ? ((Node4*)node)->keys : ((Node16*)node)->keys);
+        Node** children = (small ? ((Node4*)node)->children : ((Node16*)node)->children);
+        int index = node->count;
+        for (; index > 0 && keys[index - 1] > byte; index--) {
+            keys[index] = keys[index - 1];
+            children[index] = children[index - 1];
+        }
+        keys[index] = byte;
+        children[index] = child;
+        break;
+    }
+    case NODE48: {
+        Node48* node48 = (Node48*)node;
+        int slot = 0;
+        while (node48->children[slot] != NULL) {
+            slot++;
+        }
+        node48->children[slot] = child;
+        node48->index[byte] = (unsigned char)(slot + 1);
+        break;
+    }
+    case NODE256:
+        ((Node256*)node)->children[byte] = child;
+        break;
+    default:
+        return;
+    }
+    node->count++;
+}
+
+static void deleteChild(Node* node, unsigned char byte)
+{
+    switch (node->type) {
+    case NODE4:
+    case NODE16: {
+        bool small = (node->type == NODE4);
+        unsigned char* keys = (small ? ((Node4*)node)->keys : ((Node16*)node)->keys);
+        Node** children = (small ? ((Node4*)node)->children : ((Node16*)node)->children);
+        int index = 0;
+        while (keys[index] != byte) {
+            index++;
+        }
+        for (; index < node->count - 1; index++) {
+            keys[index] = keys[index + 1];
+            children[index] = children[index + 1];
+        }
+        break;
+    }
+    case NODE48: {
+        Node48* node48 = (Node48*)node;
+        node48->children[node48->index[byte] - 1] = NULL;
+        node48->index[byte] = 0;
+        break;
+    }
+    case NODE256:
+        ((Node256*)node)->children[byte] = NULL;
+        break;
+    default:
+        return;
+    }
+    node->count--;
+}
+
+/**
+* Adds a child to the node in the given reference, growing the node to the next size if it is full.
+* Returns false if an allocation failed, and then the node is left untouched.
+*/
+static bool addChild(Node** reference, unsigned char byte, Node* child)
+{
+    Node* node = *reference;
+    if (node->count == NODE_CAPACITIES[node->type]) {
+        node = resizeNode(node, (NodeType)(node->type + 1));
+        if (node == NULL) {
+            return false;
+        }
+        *reference = node;
+    }
+    insertChild(node, byte, child);
+
+    return true;
+}
+
+/**
+* Removes a child from the node in the given reference. A node which is left with a single child
+* is merged into that child, and a node which is left with few children shrinks to a smaller size.
+* If the allocations this needs fail, the node is left as it is, which is still a valid tree.
+*/
+static void removeChild(Node** reference, unsigned char byte)
+{
+    Node* node = *reference;
+    deleteChild(node, byte);
+
+    Node* replacement = NULL;
+    if (node->count == 1) {
+        replacement = collapseNode(node);
+    }
+    else if (node->type == NODE16 && node->count <= NODE_CAPACITIES[NODE4] - 1) {
+        replacement = resizeNode(node, NODE4);
+    }
+    else if (node->type == NODE48 && node->count <= NODE48_SHRINK_COUNT) {
+        replacement = resizeNode(node, NODE16);
+    }
+    else if (node->type == NODE256 && node->count <= NODE256_SHRINK_COUNT) {
+        replacement = resizeNode(node, NODE48);
+    }
+    if (replacement != NULL) {
+        *reference = replacement;
+    }
+}
+
+/**
+* Moves the prefix and the children of an inner node to a new node of the given type.
+* Returns NULL if an allocation failed, and then the node is left untouched.
+*/
+static Node* resizeNode(Node* node, NodeType type)
+{
+    Node* new_node = createNode(type, prefixOf(node), node->prefix_length);
+    if (new_node == NULL) {
+        return NULL;
+    }
+
+    int cursor = 0;
+    unsigned char byte;
+    for (Node* child = nextChild(node, &cursor, &byte); child != NULL; child = nextChild(node, &cursor, &byte)) {
+        insertChild(new_node, byte, child);
+    }
+    free(node);
+
+    return new_node;
+}
+
+/**
+* Merges an inner node which has a single child into that child: the child's new prefix is the
+* node's prefix, followed by the byte which led to the child and by the child's own prefix.
+* Returns NULL if an allocation failed, and then both nodes are left untouched.
+*/
+static Node* collapseNode(Node* node)
+{
+    int cursor = 0;
+    unsigned char byte;
+    Node* child = nextChild(node, &cursor, &byte);
+    int prefix_length = node->prefix_length + 1 + child->prefix_length;
+
+    Node* merged = (Node*)malloc(NODE_SIZES[child->type] + prefix_length);
+    if (merged == NULL) {
+        return NULL;
+    }
+    memcpy(merged, child, NODE_SIZES[child->type]);
+    merged->prefix_length = prefix_length;
+    unsigned char* prefix = prefixOf(merged);
+    memcpy(prefix, prefixOf(node), node->prefix_length);
+    prefix[node->prefix_length] = byte;
+    memcpy(prefix + node->prefix_length + 1, prefixOf(child), child->prefix_length);
+
+    free(child);
+    free(node);
+    return merged;
+}
+
+/**
+* Adds a key whose bytes differ from the prefix of the node in the given reference after the
+* matched bytes. A new NODE4 takes the matched bytes as its prefix, and gets both the old node
+* (without those bytes and the byte which now leads to it) and a new leaf as its children.
+*/
+static MapResult splitNode(StringMap map, Node** reference, int matched,
+                           const unsigned char* bytes, size_t length, MapDataElement dataElement)
+{
+    Node* node = *reference;
+    // the key's NUL never matches an inner node's prefix, or a leaf's prefix before its own NUL,
+    // so the key has a byte at the mismatch
+    Leaf* leaf = createLeaf(map, bytes + matched + 1, (int)(length - matched - 1), dataElement);
+    if (leaf == NULL) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    Node* parent = createNode(NODE4, prefixOf(node), matched);
+    if (parent == NULL) {
+        destroyNode(map, (Node*)leaf);
+        return MAP_OUT_OF_MEMORY;
+    }
+
+    unsigned char* prefix = prefixOf(node);
+    unsigned char node_byte = prefix[matched];
+    node->prefix_length -= matched + 1;
+    memmove(prefix, prefix + matched + 1, node->prefix_length);
+
+    insertChild(parent, node_byte, node);
+    insertChild(parent, bytes[matched], (Node*)leaf);
+    *reference = parent;
+    map->size++;
+
+    return MAP_SUCCESS;
+}
+
+// ============================ ITERATION ============================ //
+
+static bool reserveBuffer(VisitState* state, size_t size)
+{
+    if (size <= state->capacity) {
+        return true;
+    }
+    size_t capacity = (state->capacity == 0 ? 64 : state->capacity);
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    char* buffer = (char*)realloc(state->buffer, capacity);
+    if (buffer == NULL) {
+        state->failed = true;
+        return false;
+    }
+    state->buffer = buffer;
+    state->capacity = capacity;
+
+    return true;
+}
+
+/**
+* Visits the pairs of a subtree in order. The buffer holds the first length bytes of the keys
+* in the subtree, which lead to its root. Returns false if the iteration should stop.
+*/
+static bool visitNode(Node* node, size_t length, VisitState* state)
+{
+    if (!reserveBuffer(state, length + node->prefix_length + 1)) {
+        return false;
+    }
+    memcpy(state->buffer + length, prefixOf(node), node->prefix_length);
+    length += node->prefix_length;
+
+    if (node->type == LEAF) {
+        // a leaf's prefix ends with the key's NUL, or it is empty and the byte which led to it was the NUL
+        state->stopped = !state->visit(state->buffer, ((Leaf*)node)->data, state->context);
+        return !state->stopped;
+    }
+
+    int cursor = 0;
+    unsigned char byte;
+    for (Node* child = nextChild(node, &cursor, &byte); child != NULL; child = nextChild(node, &cursor, &byte)) {
+        state->buffer[length] = (char)byte;
+        if (!visitNode(child, length + 1, state)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,181 @@
+#ifndef STRING_MAP_H_
+#define STRING_MAP_H_
+
+#include <stdbool.h>
+
+#include "ordered_map.h"
+
+/**
+* A Generic Ordered-Map Container (ADT) with String Keys
+*
+* Each node in the map contains a pair of a string key and a data element.
+* The data elements can be anything, and the keys are NUL-terminated strings,
+* ordered the same way as strcmp orders them.
+*
+* The pairs are stored in an adaptive radix tree: every inner node splits the keys by
+* one byte, and has room for 4, 16, 48 or 256 children, depending on how many it needs.
+* A run of bytes which is shared by all of the keys below a node is stored once, in the node.
+* Looking a key up costs O(length of the key) byte comparisons, whatever the size of the map is,
+* and no compare function is called. The map keeps its own copies of the keys' bytes,
+* so only the data elements need copy and free functions.
+*
+* The ADT provides the following methods:
+*   stringMapCreate
+*   stringMapDestroy
+*   stringMapCopy
+*   stringMapGetSize
+*   stringMapContains
+*   stringMapPut
+*   stringMapGet
+*   stringMapRemove
+*   stringMapClear
+*   stringMapForEach
+*   stringMapPrefixForEach
+*
+*   NOTE: the "put" and "copy" methods create copies of the elements,
+*         while the "get" method returns the element in the map (and not another copy).
+*/
+
+// ============================ TYPEDEFS ============================ //
+typedef struct string_map_t * StringMap;
+
+/**
+* The function type that visits the pairs in stringMapForEach and stringMapPrefixForEach.
+* The key is only valid until the function returns.
+*   - Returns true to continue to the next pair.
+*   - Returns false to stop the iteration.
+*/
+typedef bool(*visitStringMapElements)(const char* key, MapDataElement, void* context);
+
+
+// ============================ FUNCTIONS ============================ //
+/**
+* stringMapCreate: Allocates and returns a new empty string map.
+*
+* @param copyDataElement - A Function pointer for copying data elements.
+* @param freeDataElement - A Function pointer for removing data elements.
+* @return
+* 	NULL - if one of the parameters is NULL or if allocations failed.
+* 	A new StringMap in case of success.
+*/
+StringMap stringMapCreate(copyMapDataElements copyDataElement, freeMapDataElements freeDataElement);
+
+/**
+* stringMapDestroy: Deallocates an existing map and all of it's elements.
+*
+* @param map - Map to be deallocated. If map is NULL nothing will be done.
+*/
+void stringMapDestroy(StringMap map);
+
+/**
+* stringMapCopy: Creates a copy of target map, node by node.
+*
+* @param map - Target map.
+* @return
+* 	NULL if a NULL was sent or a memory allocation failed.
+* 	Otherwise, return a StringMap containing the same elements as the given map.
+*/
+StringMap stringMapCopy(StringMap map);
+
+/**
+* stringMapGetSize: Returns the number of elements in a map.
+*
+* @param map - The map which size is requested.
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of elements in the map.
+*/
+int stringMapGetSize(StringMap map);
+
+/**
+* stringMapContains: Checks if a key exists in the map.
+*
+* @param map - The map to search in.
+* @param key - The key to look for.
+* @return
+* 	false - if one or more of the inputs is null, or if the key was not found.
+* 	true - if the key was found in the map.
+*/
+bool stringMapContains(StringMap map, const char* key);
+
+/**
+* stringMapPut: Gives a specified key a specific value.
+* If the key exists, the value will be overridden.
+* A copy of the data element is stored in the map, and the key's bytes are stored in the tree.
+*
+* @param map - The map for which to reassign the data element.
+* @param key - The key which need to be reassigned.
+* @param dataElement - The new data element to associate with the given key.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as one of the parameters.
+* 	MAP_OUT_OF_MEMORY if an allocation failed (Meaning the function for copying an element failed).
+* 	MAP_SUCCESS if the paired elements had been inserted successfully.
+*/
+MapResult stringMapPut(StringMap map, const char* key, MapDataElement dataElement);
+
+/**
+* stringMapGet: Returns the data associated with a specific key in the map.
+*
+* @param map - The map for which to get the data element from.
+* @param key - The key which need to be found and whos data we want to get.
+* @return
+* 	NULL if a NULL pointer was sent or if the map does not contain the requested key.
+* 	Otherwise, the data element associated with the key (not a copy!).
+*/
+MapDataElement stringMapGet(StringMap map, const char* key);
+
+/**
+* stringMapRemove: Removes a pair of key and data elements from the map.
+* The data element is deallocated using the free function.
+*
+* @param map - The map to remove the elements from.
+* @param key - The key to find and remove from the map.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent to the function.
+*   MAP_ITEM_DOES_NOT_EXIST if the key does not exist in the map.
+* 	MAP_SUCCESS if the paired elements had been removed successfully.
+*/
+MapResult stringMapRemove(StringMap map, const char* key);
+
+/**
+* stringMapClear: Removes all key and data elements from target map.
+*
+* @param map - Target map to remove all element from.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult stringMapClear(StringMap map);
+
+/**
+* stringMapForEach: Calls a function on every pair in the map, in order, until it returns false.
+* The function must not add or remove pairs.
+*
+* @param map - The map to iterate over.
+* @param visit - The function to call on each pair.
+* @param context - A parameter passed as is to every call of visit.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or visit.
+* 	MAP_OUT_OF_MEMORY if the buffer for the keys could not be allocated.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult stringMapForEach(StringMap map, visitStringMapElements visit, void* context);
+
+/**
+* stringMapPrefixForEach: Calls a function on every pair whose key starts with the given prefix,
+* in order, until it returns false. Only the subtree of the prefix is visited, so finding it
+* costs O(length of the prefix), whatever the size of the map is.
+* The function must not add or remove pairs.
+*
+* @param map - The map to iterate over.
+* @param prefix - The prefix of the visited keys. An empty prefix visits the whole map.
+* @param visit - The function to call on each pair.
+* @param context - A parameter passed as is to every call of visit.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map, prefix or visit.
+* 	MAP_OUT_OF_MEMORY if the buffer for the keys could not be allocated.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult stringMapPrefixForEach(StringMap map, const char* prefix, visitStringMapElements visit, void* context);
+
+#endif
@@ -0,0 +1,59 @@
+/**
+* Checks that a Bloom filter keeps its false positive rate when it is large: a filter is filled
+* to its capacity, and then asked about as many hashes which were never added.
+* The bits of a hash which pick the block must not also decide which bits are set inside it,
+* or the rate grows with the number of blocks.
+*
+* Usage: bloom_filter_test [capacity]
+*/
+
+#include "../bloom_filter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_CAPACITY 10000000
+#define LOOKUPS 1000000
+#define TARGET_RATE 0.01
+#define ALLOWED_RATE (1.3 * TARGET_RATE)
+
+static bool checkRate(int capacity, double target)
+{
+    BloomFilter filter = bloomFilterCreate(capacity, target);
+    if (filter == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return false;
+    }
+    for (int i = 0; i < capacity; i++) {
+        bloomFilterAdd(filter, (size_t)i);
+    }
+
+    bool correct = true;
+    for (int i = 0; i < capacity && correct; i++) {
+        correct = bloomFilterMayContain(filter, (size_t)i); // an added hash is never ruled out
+    }
+    int false_positives = 0;
+    for (int i = 0; i < LOOKUPS; i++) {
+        false_positives += bloomFilterMayContain(filter, (size_t)capacity + (size_t)i);
+    }
+    bloomFilterDestroy(filter);
+
+    double rate = (double)false_positives / LOOKUPS;
+    bool passed = correct && rate <= ALLOWED_RATE;
+    printf("%-4s capacity %10d: false positive rate %.4f%% (target %.2f%%)%s\n", (passed ? "ok" : "FAIL"),
+           capacity, rate * 100, target * 100, (correct ? "" : ", and an added hash was ruled out"));
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    int capacity = (argc > 1 ? atoi(argv[1]) : DEFAULT_CAPACITY);
+    if (capacity < 1) {
+        fprintf(stderr, "usage: %s [capacity]\n", argv[0]);
+        return 1;
+    }
+    bool passed = checkRate(1000, TARGET_RATE);
+    passed = checkRate(capacity / 10, TARGET_RATE) && passed;
+    passed = checkRate(capacity, TARGET_RATE) && passed;
+    return (passed ? 0 : 1);
+}
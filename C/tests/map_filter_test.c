@@ -0,0 +1,145 @@
+/**
+* Checks that the batch operations of a filtered map use its Bloom filter the same as the
+* single ones: mapGetMany must find the same data as mapGet on each key and count the same
+* negatives, hits and false positives, and the search of mapPutMany must count what mapContains
+* on each of its keys would (the keys the filter rules out are not searched at all).
+* Half of the keys asked about are absent, so the filter answers many of them.
+*
+* Usage: map_filter_test [keys]
+*/
+
+#include "../ordered_map.h"
+#include "../bloom_filter.h"
+#include "test.h"
+
+#define DEFAULT_KEYS 20000
+#define BATCH 1000
+#define FALSE_POSITIVE_RATE 0.05
+
+static size_t hashInt(MapKeyElement element)
+{
+    return (size_t)*(int*)element * 0x9E3779B97F4A7C15ULL;
+}
+
+static Map createFilteredMap(int keys)
+{
+    Map map = mapCreate(testCopyInt, testCopyInt, testFreeInt, testFreeInt, testCompareInts);
+    if (map == NULL || mapEnableFilter(map, hashInt, keys, FALSE_POSITIVE_RATE) != MAP_SUCCESS) {
+        mapDestroy(map);
+        return NULL;
+    }
+    for (int i = 0; i < keys; i++) {
+        int key = 2 * i; // the odd keys are absent
+        if (mapPut(map, &key, &key) != MAP_SUCCESS) {
+            mapDestroy(map);
+            return NULL;
+        }
+    }
+    return map;
+}
+
+static bool equalStatistics(BloomFilterStatistics statistics1, BloomFilterStatistics statistics2)
+{
+    return statistics1.negatives == statistics2.negatives && statistics1.hits == statistics2.hits &&
+           statistics1.false_positives == statistics2.false_positives;
+}
+
+static BloomFilterStatistics subtractStatistics(BloomFilterStatistics after, BloomFilterStatistics before)
+{
+    after.negatives -= before.negatives;
+    after.hits -= before.hits;
+    after.false_positives -= before.false_positives;
+    return after;
+}
+
+/**
+* Looks up the same random keys in two equal maps, with mapGet in one and mapGetMany in the other.
+*/
+static bool checkGetMany(int keys)
+{
+    Map single = createFilteredMap(keys), batch = createFilteredMap(keys);
+    int* queries = (int*)malloc(BATCH * sizeof(int));
+    MapKeyElement* elements = (MapKeyElement*)malloc(BATCH * sizeof(MapKeyElement));
+    MapDataElement* data = (MapDataElement*)malloc(BATCH * sizeof(MapDataElement));
+    bool passed = (single != NULL && batch != NULL && queries != NULL && elements != NULL && data != NULL);
+
+    unsigned long long state = 88172645463325252ULL;
+    for (int round = 0; passed && round < 2 * keys / BATCH + 1; round++) {
+        for (int i = 0; i < BATCH; i++) {
+            queries[i] = (int)(testRandom(&state) % (unsigned int)(4 * keys));
+            elements[i] = &queries[i];
+        }
+        passed = (mapGetMany(batch, elements, BATCH, data) == MAP_SUCCESS);
+        for (int i = 0; i < BATCH && passed; i++) {
+            int* expected = (int*)mapGet(single, &queries[i]);
+            passed = (expected == NULL ? data[i] == NULL : data[i] != NULL && *(int*)data[i] == *expected);
+        }
+    }
+    BloomFilterStatistics statistics1, statistics2;
+    passed = passed && mapGetFilterStatistics(single, &statistics1) == MAP_SUCCESS &&
+             mapGetFilterStatistics(batch, &statistics2) == MAP_SUCCESS &&
+             equalStatistics(statistics1, statistics2) && statistics2.negatives > 0 && statistics2.hits > 0;
+
+    free(queries);
+    free(elements);
+    free(data);
+    mapDestroy(single);
+    mapDestroy(batch);
+    return passed;
+}
+
+/**
+* Puts batches of random keys (some already in the map, some new, some repeated) with mapPutMany,
+* after asking mapContains about each of them, and then checks the map against the same pairs put with mapPut.
+*/
+static bool checkPutMany(int keys)
+{
+    Map batch = createFilteredMap(keys), single = createFilteredMap(keys);
+    int* pairs = (int*)malloc(2 * BATCH * sizeof(int));
+    MapKeyElement* key_elements = (MapKeyElement*)malloc(BATCH * sizeof(MapKeyElement));
+    MapDataElement* data_elements = (MapDataElement*)malloc(BATCH * sizeof(MapDataElement));
+    bool passed = (batch != NULL && single != NULL && pairs != NULL && key_elements != NULL && data_elements != NULL);
+
+    unsigned long long state = 2463534242ULL;
+    for (int round = 0; passed && round < 2 * keys / BATCH + 1; round++) {
+        BloomFilterStatistics before, contained, put;
+        passed = (mapGetFilterStatistics(batch, &before) == MAP_SUCCESS);
+        for (int i = 0; i < BATCH && passed; i++) {
+            pairs[2 * i] = (int)(testRandom(&state) % (unsigned int)(4 * keys));
+            pairs[2 * i + 1] = round * BATCH + i;
+            key_elements[i] = &pairs[2 * i];
+            data_elements[i] = &pairs[2 * i + 1];
+            mapContains(batch, key_elements[i]);
+            passed = (mapPut(single, key_elements[i], data_elements[i]) == MAP_SUCCESS);
+        }
+        passed = passed && mapGetFilterStatistics(batch, &contained) == MAP_SUCCESS &&
+                 mapPutMany(batch, key_elements, data_elements, BATCH) == MAP_SUCCESS &&
+                 mapGetFilterStatistics(batch, &put) == MAP_SUCCESS &&
+                 equalStatistics(subtractStatistics(put, contained), subtractStatistics(contained, before));
+    }
+
+    passed = passed && mapGetSize(batch) == mapGetSize(single);
+    MAP_FOREACH(int*, key, single) {
+        int* data = (int*)mapGet(batch, key);
+        passed = passed && data != NULL && *data == *(int*)mapGet(single, key);
+    }
+
+    free(pairs);
+    free(key_elements);
+    free(data_elements);
+    mapDestroy(batch);
+    mapDestroy(single);
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    int keys = (argc > 1 ? atoi(argv[1]) : DEFAULT_KEYS);
+    if (keys < 1) {
+        fprintf(stderr, "usage: %s [keys]\n", argv[0]);
+        return 1;
+    }
+    bool passed = testReport(checkGetMany(keys), "mapGetMany counts the same lookups as mapGet");
+    passed = testReport(checkPutMany(keys), "mapPutMany counts the same lookups as mapContains") && passed;
+    return (passed ? 0 : 1);
+}
@@ -0,0 +1,246 @@
+/**
+* Checks mapMerge (with both policies), mapDifference and mapIntersectKeys against a model of
+* the maps as arrays indexed by key. Every case is run on maps of pointers and on inline maps,
+* which are merged in a single pass, and on maps with different compare functions or kinds of
+* storage, whose pairs are put one by one instead. After each operation the result is compared
+* with the model pair by pair and by rank (which checks the rebuilt subtree counts), and then
+* is changed by random removals and compared again (which checks that the rebuilt tree is sound).
+* The element functions count the live copies, so that leaked or doubly freed pairs are caught.
+*
+* Usage: map_merge_test [keys]
+*/
+
+#include "../ordered_map.h"
+#include "test.h"
+
+#define DEFAULT_KEYS 20000
+
+typedef struct model_t {
+    bool* present;
+    int* data;
+} Model;
+
+typedef enum { POINTERS, INLINE, REVERSED, KINDS_COUNT } Kind;
+
+static const char* const kind_names[KINDS_COUNT] = { "pointers", "inline", "reversed order" };
+
+static int live = 0; // copies made by copyCounted and not freed yet
+static int key_range = 2 * DEFAULT_KEYS;
+
+static void* copyCounted(void* element)
+{
+    live++;
+    return testCopyInt(element);
+}
+
+static void freeCounted(void* element)
+{
+    live--;
+    free(element);
+}
+
+static int compareReversed(void* element1, void* element2)
+{
+    return testCompareInts(element2, element1);
+}
+
+static Map createMap(Kind kind)
+{
+    Map map = NULL;
+    if (kind == INLINE) {
+        map = mapCreateInline(sizeof(int), sizeof(int), testCompareInts);
+    }
+    else {
+        map = mapCreate(copyCounted, copyCounted, freeCounted, freeCounted,
+                        (kind == REVERSED ? compareReversed : testCompareInts));
+    }
+    if (map == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return map;
+}
+
+static Model createModel(void)
+{
+    Model model = { (bool*)calloc((size_t)key_range, sizeof(bool)), (int*)calloc((size_t)key_range, sizeof(int)) };
+    if (model.present == NULL || model.data == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return model;
+}
+
+static void destroyModel(Model model)
+{
+    free(model.present);
+    free(model.data);
+}
+
+/**
+* Puts count random keys of [low, high) in both the map and its model, with data tag * key.
+*/
+static void fill(Map map, Model model, int count, int low, int high, int tag, unsigned long long* state)
+{
+    for (int i = 0; i < count && low < high; i++) {
+        int key = low + (int)(testRandom(state) % (unsigned int)(high - low)), data = tag * key;
+        mapPut(map, &key, &data);
+        model.present[key] = true;
+        model.data[key] = data;
+    }
+}
+
+/**
+* Compares a map in the ascending order of keys with its model: its size, the pairs its
+* cursor walks over, and the keys of every rank.
+*/
+static bool matches(Map map, Model model)
+{
+    MapCursor cursor;
+    bool valid = mapCursorFirst(map, &cursor);
+    int rank = 0;
+    for (int key = 0; key < key_range; key++) {
+        if (!model.present[key]) {
+            continue;
+        }
+        if (!valid || *(int*)mapCursorGetKey(&cursor) != key || *(int*)mapCursorGetData(&cursor) != model.data[key]) {
+            return false;
+        }
+        int* ranked = (int*)mapGetByRank(map, rank++);
+        if (ranked == NULL || *ranked != key) {
+            return false;
+        }
+        valid = mapCursorNext(&cursor);
+    }
+    return !valid && mapGetSize(map) == rank;
+}
+
+/**
+* Compares a map in any order with its model, by looking up every key.
+*/
+static bool holds(Map map, Model model)
+{
+    int size = 0;
+    for (int key = 0; key < key_range; key++) {
+        int* data = (int*)mapGet(map, &key);
+        if ((data != NULL) != model.present[key] || (data != NULL && *data != model.data[key])) {
+            return false;
+        }
+        size += model.present[key];
+    }
+    return mapGetSize(map) == size;
+}
+
+/**
+* Removes random keys from the map and its model, and compares them again.
+*/
+static bool matchesAfterRemovals(Map map, Model model, unsigned long long* state)
+{
+    for (int i = 0; i < key_range / 4; i++) {
+        int key = (int)(testRandom(state) % (unsigned int)key_range);
+        mapRemove(map, &key);
+        model.present[key] = false;
+    }
+    return matches(map, model);
+}
+
+typedef struct sizes_t {
+    const char* name;
+    int destination_low, destination_high; // the range of the destination's (or map1's) keys
+    int source_low, source_high;           // the range of the source's (or map2's) keys
+} Sizes;
+
+static bool checkMerge(Kind destination_kind, Kind source_kind, MapMergePolicy policy, Sizes sizes,
+                       unsigned long long* state)
+{
+    Map destination = createMap(destination_kind), source = createMap(source_kind);
+    Model expected = createModel(), source_model = createModel();
+    int count = key_range / 2;
+    fill(destination, expected, count, sizes.destination_low, sizes.destination_high, 3, state);
+    fill(source, source_model, count, sizes.source_low, sizes.source_high, 5, state);
+    for (int key = 0; key < key_range; key++) {
+        if (source_model.present[key] && (!expected.present[key] || policy == MAP_MERGE_TAKE_SOURCE)) {
+            expected.present[key] = true;
+            expected.data[key] = source_model.data[key];
+        }
+    }
+
+    bool passed = mapMerge(destination, source, policy) == MAP_SUCCESS && matches(destination, expected);
+    passed = passed && holds(source, source_model); // the source is untouched
+    passed = passed && matchesAfterRemovals(destination, expected, state);
+    mapDestroy(destination);
+    mapDestroy(source);
+    destroyModel(expected);
+    destroyModel(source_model);
+    return passed;
+}
+
+static bool checkSetOperation(Kind kind1, Kind kind2, bool intersect, Sizes sizes, unsigned long long* state)
+{
+    Map map1 = createMap(kind1), map2 = createMap(kind2);
+    Model model1 = createModel(), model2 = createModel(), expected = createModel();
+    int count = key_range / 2;
+    fill(map1, model1, count, sizes.destination_low, sizes.destination_high, 3, state);
+    fill(map2, model2, count, sizes.source_low, sizes.source_high, 5, state);
+    for (int key = 0; key < key_range; key++) {
+        expected.present[key] = model1.present[key] && (model2.present[key] == intersect);
+        expected.data[key] = model1.data[key];
+    }
+
+    Map result = (intersect ? mapIntersectKeys(map1, map2) : mapDifference(map1, map2));
+    bool passed = result != NULL && matches(result, expected) && holds(map1, model1) && holds(map2, model2);
+    passed = passed && (result == NULL || matchesAfterRemovals(result, expected, state));
+    mapDestroy(result);
+    mapDestroy(map1);
+    mapDestroy(map2);
+    destroyModel(model1);
+    destroyModel(model2);
+    destroyModel(expected);
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    int keys = (argc > 1 ? atoi(argv[1]) : DEFAULT_KEYS);
+    if (keys < 4) {
+        fprintf(stderr, "usage: %s [keys (at least 4)]\n", argv[0]);
+        return 1;
+    }
+    key_range = 2 * keys;
+    int half = keys;
+    const Sizes all_sizes[] = {
+        { "overlapping keys", 0, key_range, 0, key_range },
+        { "source after destination", 0, half, half, key_range },
+        { "source before destination", half, key_range, 0, half },
+        { "empty source", 0, key_range, 0, 0 },
+        { "empty destination", 0, 0, 0, key_range },
+    };
+    const Kind pairs[][2] = { { POINTERS, POINTERS }, { INLINE, INLINE }, { POINTERS, REVERSED }, { POINTERS, INLINE } };
+
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    bool passed = true;
+    char name[160];
+    for (size_t p = 0; p < sizeof(pairs) / sizeof(pairs[0]); p++) {
+        for (size_t s = 0; s < sizeof(all_sizes) / sizeof(all_sizes[0]); s++) {
+            char kinds[96];
+            snprintf(kinds, sizeof(kinds), "%s with %s", kind_names[pairs[p][0]], kind_names[pairs[p][1]]);
+            const char* mode = (pairs[p][0] == pairs[p][1] ? "single pass" : "one by one");
+            live = 0;
+            bool merged = checkMerge(pairs[p][0], pairs[p][1], MAP_MERGE_KEEP_DESTINATION, all_sizes[s], &state);
+            merged = checkMerge(pairs[p][0], pairs[p][1], MAP_MERGE_TAKE_SOURCE, all_sizes[s], &state) && merged;
+            bool differed = checkSetOperation(pairs[p][0], pairs[p][1], false, all_sizes[s], &state);
+            bool intersected = checkSetOperation(pairs[p][0], pairs[p][1], true, all_sizes[s], &state);
+            bool freed = (live == 0);
+
+            snprintf(name, sizeof(name), "%s (%s), %s: mapMerge with both policies", kinds, mode, all_sizes[s].name);
+            passed = testReport(merged, name) && passed;
+            snprintf(name, sizeof(name), "%s (%s), %s: mapDifference", kinds, mode, all_sizes[s].name);
+            passed = testReport(differed, name) && passed;
+            snprintf(name, sizeof(name), "%s (%s), %s: mapIntersectKeys", kinds, mode, all_sizes[s].name);
+            passed = testReport(intersected, name) && passed;
+            snprintf(name, sizeof(name), "%s (%s), %s: every copy freed", kinds, mode, all_sizes[s].name);
+            passed = testReport(freed, name) && passed;
+        }
+    }
+    return (passed ? 0 : 1);
+}
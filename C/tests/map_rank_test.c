@@ -0,0 +1,131 @@
+/**
+* Checks mapGetByRank and mapRank against a sorted array of the same keys, in maps which grow
+* by random puts and shrink by random removals (so the subtree counts go through splits,
+* merges and rotations), for both a map of pointers and an inline map. Besides the keys
+* in the map, it ranks absent keys between them and beyond both ends, and asks for ranks
+* which are out of range.
+*
+* Usage: map_rank_test [keys]
+*/
+
+#include "../ordered_map.h"
+#include "test.h"
+
+#include <string.h>
+
+#define DEFAULT_KEYS 100000
+
+/**
+* Compares every rank and select query of the map with the sorted keys (which are all even,
+* so the odd numbers between them are absent).
+*/
+static bool checkQueries(Map map, const int* sorted, int size)
+{
+    if (mapGetSize(map) != size) {
+        return false;
+    }
+    for (int rank = 0; rank < size; rank++) {
+        int* key = (int*)mapGetByRank(map, rank);
+        if (key == NULL || *key != sorted[rank]) {
+            return false;
+        }
+        if (mapRank(map, key) != rank) {
+            return false;
+        }
+        int absent = sorted[rank] - 1; // between sorted[rank - 1] and sorted[rank]
+        if (mapRank(map, &absent) != rank) {
+            return false;
+        }
+    }
+    int after = (size > 0 ? sorted[size - 1] + 1 : 0), before = -1;
+    const int out_of_range[] = { -1, size, size + 1, -size - 2 };
+    for (size_t i = 0; i < sizeof(out_of_range) / sizeof(out_of_range[0]); i++) {
+        if (mapGetByRank(map, out_of_range[i]) != NULL) {
+            return false;
+        }
+    }
+    return mapRank(map, &after) == size && mapRank(map, &before) == 0;
+}
+
+/**
+* Keeps the keys of the map in a sorted array: marks holds which of the even keys 0, 2, ...
+* are in the map, and sorted is rebuilt from it.
+*/
+static int collectKeys(const bool* marks, int range, int* sorted)
+{
+    int size = 0;
+    for (int i = 0; i < range; i++) {
+        if (marks[i]) {
+            sorted[size++] = 2 * i;
+        }
+    }
+    return size;
+}
+
+static bool checkMap(Map map, const char* kind, int keys)
+{
+    int range = 2 * keys; // of the even keys 0, 2, ..., about half are put
+    bool* marks = (bool*)calloc((size_t)range, sizeof(bool));
+    int* sorted = (int*)calloc((size_t)range, sizeof(int));
+    if (map == NULL || marks == NULL || sorted == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    char name[128];
+    bool passed = true;
+
+    snprintf(name, sizeof(name), "%s: empty map", kind);
+    passed = testReport(checkQueries(map, sorted, 0), name) && passed;
+
+    int zero = 0;
+    mapPut(map, &zero, &zero);
+    marks[0] = true;
+    snprintf(name, sizeof(name), "%s: one key", kind);
+    passed = testReport(checkQueries(map, sorted, collectKeys(marks, range, sorted)), name) && passed;
+
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < keys; i++) {
+        int index = (int)(testRandom(&state) % (unsigned int)range), key = 2 * index;
+        mapPut(map, &key, &key);
+        marks[index] = true;
+    }
+    int size = collectKeys(marks, range, sorted);
+    snprintf(name, sizeof(name), "%s: %d keys after random puts", kind, size);
+    passed = testReport(checkQueries(map, sorted, size), name) && passed;
+
+    for (int i = 0; i < keys; i++) { // removes most of the keys, absent ones included
+        int index = (int)(testRandom(&state) % (unsigned int)range), key = 2 * index;
+        mapRemove(map, &key);
+        marks[index] = false;
+    }
+    size = collectKeys(marks, range, sorted);
+    snprintf(name, sizeof(name), "%s: %d keys after random removals", kind, size);
+    passed = testReport(checkQueries(map, sorted, size), name) && passed;
+
+    int low = range, high = 2 * range; // the keys of the upper half of the marks
+    mapRemoveRange(map, &low, &high);
+    memset(marks + range / 2, 0, (size_t)(range - range / 2) * sizeof(bool));
+    size = collectKeys(marks, range, sorted);
+    snprintf(name, sizeof(name), "%s: %d keys after removing a range", kind, size);
+    passed = testReport(checkQueries(map, sorted, size), name) && passed;
+
+    mapDestroy(map);
+    free(marks);
+    free(sorted);
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    int keys = (argc > 1 ? atoi(argv[1]) : DEFAULT_KEYS);
+    if (keys < 1) {
+        fprintf(stderr, "usage: %s [keys]\n", argv[0]);
+        return 1;
+    }
+    bool passed = true;
+    passed = checkMap(mapCreate(testCopyInt, testCopyInt, testFreeInt, testFreeInt, testCompareInts),
+                      "Map", keys) && passed;
+    passed = checkMap(mapCreateInline(sizeof(int), sizeof(int), testCompareInts), "inline Map", keys) && passed;
+    passed = testReport(mapGetByRank(NULL, 0) == NULL && mapRank(NULL, &keys) == -1, "NULL arguments") && passed;
+    return (passed ? 0 : 1);
+}
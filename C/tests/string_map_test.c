@@ -0,0 +1,293 @@
+/**
+* Checks StringMap against a sorted array of the same keys. First a single inner node is grown
+* through all of its sizes (4, 16, 48 and 256 children) by adding keys which differ in one byte,
+* and is then shrunk back and collapsed by removing them. Then random keys with long shared
+* prefixes (and keys which are prefixes of other keys, the empty one included) are put and removed
+* at random. Every step is compared with the array: the pairs in order, the lookups, prefix scans
+* of random prefixes, and a copy of the map (which must not share anything with the original).
+*
+* Usage: string_map_test [operations]
+*/
+
+#include "../string_map.h"
+#include "test.h"
+
+#include <string.h>
+
+#define DEFAULT_OPERATIONS 20000
+#define MAX_KEY_LENGTH 12
+#define VERIFY_EVERY 500 // random steps between the full comparisons
+
+typedef struct entry_t {
+    char* key;
+    int data;
+} Entry;
+
+typedef struct reference_t {
+    Entry* entries; // sorted by strcmp
+    int size;
+    int capacity;
+} Reference;
+
+typedef struct visit_t {
+    const Entry* entries; // the pairs the visit should meet, in order
+    int count;
+    int visited;
+    bool matched;
+} Visit;
+
+static int live = 0; // copies of data elements which were not freed yet
+
+static void* copyCounted(void* element)
+{
+    live++;
+    return testCopyInt(element);
+}
+
+static void freeCounted(void* element)
+{
+    live--;
+    free(element);
+}
+
+/**
+* Returns the index of the key in the reference, or where it belongs (-index - 1) if it is missing.
+*/
+static int findEntry(const Reference* reference, const char* key)
+{
+    int low = 0, high = reference->size;
+    while (low < high) {
+        int middle = (low + high) / 2, compare = strcmp(reference->entries[middle].key, key);
+        if (compare == 0) {
+            return middle;
+        }
+        if (compare < 0) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return -low - 1;
+}
+
+static void referencePut(Reference* reference, const char* key, int data)
+{
+    int index = findEntry(reference, key);
+    if (index >= 0) {
+        reference->entries[index].data = data;
+        return;
+    }
+    index = -index - 1;
+    if (reference->size == reference->capacity) {
+        reference->capacity = 2 * reference->capacity + 16;
+        reference->entries = (Entry*)realloc(reference->entries, (size_t)reference->capacity * sizeof(Entry));
+    }
+    char* copy = (char*)malloc(strlen(key) + 1);
+    if (reference->entries == NULL || copy == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    strcpy(copy, key);
+    memmove(&reference->entries[index + 1], &reference->entries[index],
+            (size_t)(reference->size - index) * sizeof(Entry));
+    reference->entries[index] = (Entry){ copy, data };
+    reference->size++;
+}
+
+static void referenceRemove(Reference* reference, const char* key)
+{
+    int index = findEntry(reference, key);
+    if (index < 0) {
+        return;
+    }
+    free(reference->entries[index].key);
+    memmove(&reference->entries[index], &reference->entries[index + 1],
+            (size_t)(reference->size - index - 1) * sizeof(Entry));
+    reference->size--;
+}
+
+static void referenceClear(Reference* reference)
+{
+    for (int i = 0; i < reference->size; i++) {
+        free(reference->entries[i].key);
+    }
+    free(reference->entries);
+    *reference = (Reference){ NULL, 0, 0 };
+}
+
+static bool visitEntry(const char* key, MapDataElement dataElement, void* context)
+{
+    Visit* visit = (Visit*)context;
+    if (visit->visited >= visit->count || strcmp(visit->entries[visit->visited].key, key) != 0 ||
+        visit->entries[visit->visited].data != *(int*)dataElement) {
+        visit->matched = false;
+        return false;
+    }
+    visit->visited++;
+    return true;
+}
+
+/**
+* Scans the keys which start with prefix, and compares them with the matching run of the reference.
+*/
+static bool matchesPrefix(StringMap map, const Reference* reference, const char* prefix)
+{
+    size_t length = strlen(prefix);
+    int first = findEntry(reference, prefix);
+    first = (first >= 0 ? first : -first - 1); // the keys with the prefix come right from here
+    int end = first;
+    while (end < reference->size && strncmp(reference->entries[end].key, prefix, length) == 0) {
+        end++;
+    }
+    Visit visit = { &reference->entries[first], end - first, 0, true };
+    return stringMapPrefixForEach(map, prefix, visitEntry, &visit) == MAP_SUCCESS && visit.matched &&
+           visit.visited == visit.count;
+}
+
+static bool matches(StringMap map, const Reference* reference, unsigned long long* state)
+{
+    Visit visit = { reference->entries, reference->size, 0, true };
+    if (stringMapGetSize(map) != reference->size || stringMapForEach(map, visitEntry, &visit) != MAP_SUCCESS ||
+        !visit.matched || visit.visited != reference->size) {
+        return false;
+    }
+    for (int i = 0; i < reference->size; i++) {
+        int* data = (int*)stringMapGet(map, reference->entries[i].key);
+        if (data == NULL || *data != reference->entries[i].data) {
+            return false;
+        }
+    }
+    if (!matchesPrefix(map, reference, "")) {
+        return false;
+    }
+    for (int i = 0; i < 20 && reference->size > 0; i++) { // prefixes of keys in the map, and longer ones
+        const char* key = reference->entries[testRandom(state) % (unsigned int)reference->size].key;
+        char prefix[MAX_KEY_LENGTH + 2];
+        size_t length = testRandom(state) % (strlen(key) + 1);
+        memcpy(prefix, key, length);
+        prefix[length] = '\0';
+        if (i % 4 == 3) { // most likely a prefix of no key
+            prefix[length] = 'z';
+            prefix[length + 1] = '\0';
+        }
+        if (!matchesPrefix(map, reference, prefix)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+* Compares a copy of the map with the reference, and then checks that clearing the copy
+* leaves the original as it was.
+*/
+static bool matchesCopy(StringMap map, const Reference* reference, unsigned long long* state)
+{
+    StringMap copy = stringMapCopy(map);
+    bool passed = copy != NULL && matches(copy, reference, state);
+    stringMapClear(copy);
+    passed = passed && stringMapGetSize(copy) == 0 && matches(map, reference, state);
+    stringMapDestroy(copy);
+    return passed;
+}
+
+/**
+* Grows one inner node from 1 to 255 children (every byte but 0 after a shared prefix),
+* and then removes them again, comparing the map after every step.
+*/
+static bool checkNodeSizes(unsigned long long* state)
+{
+    StringMap map = stringMapCreate(copyCounted, freeCounted);
+    Reference reference = { NULL, 0, 0 };
+    bool passed = (map != NULL);
+    char key[] = "shared/?";
+    int order[255];
+    for (int i = 0; i < 255; i++) {
+        order[i] = i + 1;
+    }
+    for (int i = 254; i > 0; i--) { // children arrive in a random order
+        int j = (int)(testRandom(state) % (unsigned int)(i + 1)), byte = order[i];
+        order[i] = order[j];
+        order[j] = byte;
+    }
+    for (int i = 0; i < 255 && passed; i++) {
+        key[7] = (char)order[i];
+        passed = stringMapPut(map, key, &i) == MAP_SUCCESS;
+        referencePut(&reference, key, i);
+        passed = passed && matches(map, &reference, state);
+    }
+    passed = passed && matchesCopy(map, &reference, state);
+    for (int i = 0; i < 255 && passed; i++) { // removes them in another order, down to no children
+        key[7] = (char)order[(i * 7) % 255];
+        passed = stringMapRemove(map, key) == MAP_SUCCESS;
+        referenceRemove(&reference, key);
+        passed = passed && matches(map, &reference, state);
+    }
+    passed = passed && stringMapGetSize(map) == 0 && !stringMapContains(map, "shared/");
+    stringMapDestroy(map);
+    referenceClear(&reference);
+    return passed;
+}
+
+/**
+* Draws a key out of a few shared stems and a short random tail, mostly of a small alphabet,
+* so the keys share long prefixes, and many of them are prefixes of others.
+*/
+static void drawKey(char* key, unsigned long long* state)
+{
+    static const char* const stems[] = { "", "a", "ab", "abc", "usr/local/", "usr/lib/", "x" };
+    strcpy(key, stems[testRandom(state) % (sizeof(stems) / sizeof(stems[0]))]);
+    size_t length = strlen(key);
+    size_t tail = testRandom(state) % 4;
+    bool wide = (testRandom(state) % 4 == 0); // any byte but 0, so some nodes get many children
+    for (size_t i = 0; i < tail && length < MAX_KEY_LENGTH; i++) {
+        key[length++] = (wide ? (char)(1 + testRandom(state) % 255) : "abcd/"[testRandom(state) % 5]);
+    }
+    key[length] = '\0';
+}
+
+static bool checkRandom(int operations, unsigned long long* state)
+{
+    StringMap map = stringMapCreate(copyCounted, freeCounted);
+    Reference reference = { NULL, 0, 0 };
+    bool passed = (map != NULL);
+    for (int i = 0; i < operations && passed; i++) {
+        char key[MAX_KEY_LENGTH + 1];
+        drawKey(key, state);
+        if (testRandom(state) % 3 != 0) {
+            passed = stringMapPut(map, key, &i) == MAP_SUCCESS;
+            referencePut(&reference, key, i);
+        }
+        else {
+            bool present = findEntry(&reference, key) >= 0;
+            passed = stringMapRemove(map, key) == (present ? MAP_SUCCESS : MAP_ITEM_DOES_NOT_EXIST);
+            referenceRemove(&reference, key);
+        }
+        passed = passed && stringMapContains(map, key) == (findEntry(&reference, key) >= 0);
+        if (i % VERIFY_EVERY == VERIFY_EVERY - 1) {
+            passed = passed && matches(map, &reference, state) && matchesCopy(map, &reference, state);
+        }
+    }
+    passed = passed && matches(map, &reference, state) && matchesCopy(map, &reference, state);
+    stringMapDestroy(map);
+    referenceClear(&reference);
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    int operations = (argc > 1 ? atoi(argv[1]) : DEFAULT_OPERATIONS);
+    if (operations < 1) {
+        fprintf(stderr, "usage: %s [operations]\n", argv[0]);
+        return 1;
+    }
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    bool passed = testReport(checkNodeSizes(&state), "one node grown to 256 children and shrunk back");
+    passed = testReport(live == 0, "every data element freed") && passed;
+    char name[96];
+    snprintf(name, sizeof(name), "%d random puts and removals of keys with shared prefixes", operations);
+    passed = testReport(checkRandom(operations, &state), name) && passed;
+    passed = testReport(live == 0, "every data element freed") && passed;
+    return (passed ? 0 : 1);
+}
@@ -0,0 +1,221 @@
+/**
+* Checks that the "take" and extract variants of the containers move elements instead of copying
+* them: the containers are given elements allocated by the check, with copy and free functions
+* which count their calls. A taken element must be stored as is (no copy), handed back as is
+* (no free), and freed exactly once by the container if it is never handed back, so that every
+* element is freed by the end of each case.
+*/
+
+#include "../ordered_map.h"
+#include "../list.h"
+#include "../set.h"
+#include "../intern_pool.h"
+#include "../queue.h"
+#include "../stack.h"
+#include "test.h"
+
+#define ELEMENTS 1000
+
+static int copies = 0;
+static int frees = 0;
+static int live = 0; // elements allocated by newInt or copyCounted which were not freed yet
+
+static int* newInt(int value)
+{
+    int* element = (int*)malloc(sizeof(int));
+    if (element == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    *element = value;
+    live++;
+    return element;
+}
+
+static void* copyCounted(void* element)
+{
+    copies++;
+    live++;
+    return testCopyInt(element);
+}
+
+static void freeCounted(void* element)
+{
+    frees++;
+    live--;
+    free(element);
+}
+
+static bool equalInts(void* element1, void* element2)
+{
+    return *(int*)element1 == *(int*)element2;
+}
+
+static void resetCounts(void)
+{
+    copies = 0;
+    frees = 0;
+    live = 0;
+}
+
+static bool checkMap(void)
+{
+    resetCounts();
+    Map map = mapCreate(copyCounted, copyCounted, freeCounted, freeCounted, testCompareInts);
+    int* keys[ELEMENTS];
+    int* data[ELEMENTS];
+    bool passed = (map != NULL);
+    for (int i = 0; i < ELEMENTS && passed; i++) {
+        keys[i] = newInt(i);
+        data[i] = newInt(-i);
+        passed = mapPutTake(map, keys[i], data[i]) == MAP_SUCCESS && mapGet(map, keys[i]) == data[i];
+    }
+    passed = passed && copies == 0 && frees == 0;
+
+    int* replacement = newInt(7); // replaces the data of key 0, and its equal key is freed
+    int* duplicate_key = newInt(0);
+    passed = passed && mapPutTake(map, duplicate_key, replacement) == MAP_SUCCESS;
+    passed = passed && mapGet(map, keys[0]) == replacement && frees == 2 && copies == 0;
+    data[0] = replacement;
+
+    for (int i = 0; i < ELEMENTS / 2 && passed; i++) {
+        MapKeyElement key;
+        MapDataElement element;
+        int lookup = i;
+        passed = mapExtract(map, &lookup, &key, &element) == MAP_SUCCESS && key == keys[i] && element == data[i];
+        free(key);
+        free(element);
+        live -= 2;
+    }
+    passed = passed && frees == 2 && copies == 0 && mapGetSize(map) == ELEMENTS - ELEMENTS / 2;
+
+    mapDestroy(map); // frees the pairs which were not extracted
+    return passed && live == 0 && copies == 0;
+}
+
+static bool checkQueue(void)
+{
+    resetCounts();
+    Queue queue = queueCreate(copyCounted, freeCounted);
+    int* elements[ELEMENTS];
+    bool passed = (queue != NULL);
+    for (int i = 0; i < ELEMENTS && passed; i++) {
+        elements[i] = newInt(i);
+        passed = queueEnqueueTake(queue, elements[i]) == QUEUE_SUCCESS;
+    }
+    for (int i = 0; i < ELEMENTS / 2 && passed; i++) { // in the order they were enqueued
+        Element element;
+        passed = queueDequeueTake(queue, &element) == QUEUE_SUCCESS && element == elements[i];
+        free(element);
+        live--;
+    }
+    passed = passed && copies == 0 && frees == 0;
+    queueDestroy(queue);
+    return passed && live == 0 && copies == 0;
+}
+
+static bool checkStack(void)
+{
+    resetCounts();
+    Stack stack = stackCreate(copyCounted, freeCounted);
+    int* elements[ELEMENTS];
+    bool passed = (stack != NULL);
+    for (int i = 0; i < ELEMENTS && passed; i++) {
+        elements[i] = newInt(i);
+        passed = stackPushTake(stack, elements[i]) == STACK_SUCCESS;
+    }
+    for (int i = ELEMENTS - 1; i >= ELEMENTS / 2 && passed; i--) { // in the reverse order
+        Element element;
+        passed = stackPopTake(stack, &element) == STACK_SUCCESS && element == elements[i];
+        free(element);
+        live--;
+    }
+    passed = passed && copies == 0 && frees == 0;
+    stackDestroy(stack);
+    return passed && live == 0 && copies == 0;
+}
+
+static bool checkList(void)
+{
+    resetCounts();
+    List list = listCreate(copyCounted, freeCounted);
+    int* elements[ELEMENTS];
+    bool passed = (list != NULL);
+    for (int i = 0; i < ELEMENTS && passed; i++) {
+        elements[i] = newInt(i);
+        passed = listInsertLastTake(list, elements[i]) == LIST_SUCCESS;
+    }
+    int index = 0;
+    for (Element element = listGetFirst(list); element != NULL && passed; element = listGetNext(list)) {
+        passed = (element == elements[index++]);
+    }
+    passed = passed && index == ELEMENTS && copies == 0 && frees == 0;
+    listDestroy(list);
+    return passed && live == 0 && frees == ELEMENTS;
+}
+
+static size_t hashInt(void* element)
+{
+    return (size_t)(unsigned int)*(int*)element;
+}
+
+static bool checkSet(Set set)
+{
+    resetCounts();
+    bool passed = (set != NULL);
+    for (int i = 0; i < ELEMENTS && passed; i++) {
+        int* element = newInt(i);
+        passed = setAddTake(set, element) == SET_SUCCESS && setFindRef(set, element) == element;
+    }
+    passed = passed && copies == 0 && frees == 0;
+    for (int i = 0; i < ELEMENTS && passed; i++) { // equal elements are freed, and the set keeps its own
+        int* element = newInt(i);
+        passed = setAddTake(set, element) == SET_ITEM_ALREADY_EXISTS && frees == i + 1;
+    }
+    passed = passed && copies == 0 && setGetSize(set) == ELEMENTS;
+    setDestroy(set);
+    return passed && live == 0 && copies == 0;
+}
+
+/**
+* An interned set keeps the pool's copy of a string given to setAddTake, so the string
+* is not taken, and the caller frees it.
+*/
+static bool checkInternedSet(void)
+{
+    InternPool pool = internPoolCreate();
+    Set set = setCreateInterned(pool);
+    bool passed = (pool != NULL && set != NULL);
+    for (int i = 0; i < ELEMENTS && passed; i++) {
+        char* string = (char*)malloc(16);
+        if (string == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        snprintf(string, 16, "key %d", i % (ELEMENTS / 2));
+        SetResult result = setAddTake(set, string);
+        passed = (result == (i < ELEMENTS / 2 ? SET_SUCCESS : SET_ITEM_ALREADY_EXISTS));
+        const char* interned = internPoolFind(pool, string);
+        passed = passed && interned != NULL && interned != string && setFindRef(set, string) == interned;
+        free(string); // still the caller's
+    }
+    passed = passed && setGetSize(set) == ELEMENTS / 2;
+    setDestroy(set);
+    internPoolDestroy(pool);
+    return passed;
+}
+
+int main(void)
+{
+    bool passed = testReport(checkMap(), "mapPutTake and mapExtract");
+    passed = testReport(checkQueue(), "queueEnqueueTake and queueDequeueTake") && passed;
+    passed = testReport(checkStack(), "stackPushTake and stackPopTake") && passed;
+    passed = testReport(checkList(), "listInsertLastTake") && passed;
+    passed = testReport(checkSet(setCreate(copyCounted, freeCounted, equalInts)), "setAddTake") && passed;
+    passed = testReport(checkSet(setCreateHashed(copyCounted, freeCounted, equalInts, hashInt)),
+                        "setAddTake, hashed set") && passed;
+    passed = testReport(checkSet(setCreateOrdered(copyCounted, freeCounted, testCompareInts)),
+                        "setAddTake, ordered set") && passed;
+    passed = testReport(checkInternedSet(), "setAddTake, interned set (does not take the string)") && passed;
+    return (passed ? 0 : 1);
+}
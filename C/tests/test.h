@@ -0,0 +1,58 @@
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/**
+* Helpers shared by the checks in this directory.
+*
+* Every check is a small program which compares a container with a simple reference model
+* (usually a sorted array), prints one "ok" or "FAIL" line per case with testReport,
+* and exits with 1 if any of its cases failed.
+*/
+
+static inline bool testReport(bool passed, const char* name)
+{
+    printf("%-4s %s\n", (passed ? "ok" : "FAIL"), name);
+    return passed;
+}
+
+/**
+* A small xorshift generator, so every run of a check draws the same "random" cases.
+*/
+static inline unsigned int testRandom(unsigned long long* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return (unsigned int)(*state >> 32);
+}
+
+static inline void* testCopyInt(void* element)
+{
+    int* copy = (int*)malloc(sizeof(int));
+    if (copy != NULL) {
+        *copy = *(int*)element;
+    }
+    return copy;
+}
+
+static inline void testFreeInt(void* element)
+{
+    free(element);
+}
+
+static inline int testCompareInts(void* element1, void* element2)
+{
+    int first = *(int*)element1, second = *(int*)element2;
+    return (first > second) - (first < second);
+}
+
+static inline int testCompareIntValues(const void* element1, const void* element2)
+{
+    return testCompareInts((void*)element1, (void*)element2);
+}
+
+#endif
@@ -0,0 +1,172 @@
+#include "thread_pool.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define NULL_POOL_THREAD_COUNT -1
+
+static void* runWorker(void* context);
+static bool runNextTask(ThreadPool pool);
+
+/**
+* The batch being run is described by run, tasks, taskSize and taskCount (which is 0 between batches).
+* A thread takes the task at next_task, and counts it in finished once it returns,
+* so the batch is done when finished reaches taskCount. All of these are guarded by lock.
+*/
+struct thread_pool_t {
+    pthread_t* workers; // the started threads, one less than threadCount
+    int threadCount;
+    pthread_mutex_t run_lock; // held by the thread which runs a batch, so batches run one at a time
+    pthread_mutex_t lock;
+    pthread_cond_t batch_started;
+    pthread_cond_t batch_finished;
+    runThreadPoolTask run;
+    unsigned char* tasks;
+    size_t taskSize;
+    int taskCount;
+    int next_task;
+    int finished;
+    bool stopping;
+};
+
+ThreadPool threadPoolCreate(int threadCount)
+{
+    if (threadCount <= 0) {
+        return NULL;
+    }
+    ThreadPool pool = (ThreadPool)malloc(sizeof(*pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->workers = NULL; // a pool of one thread runs its tasks on the calling thread alone
+    if (threadCount > 1) {
+        pool->workers = (pthread_t*)malloc((threadCount - 1) * sizeof(pthread_t));
+    }
+    if (threadCount > 1 && pool->workers == NULL) {
+        free(pool);
+        return NULL;
+    }
+    pool->threadCount = 1;
+    pool->run = NULL;
+    pool->tasks = NULL;
+    pool->taskSize = 0;
+    pool->taskCount = 0;
+    pool->next_task = 0;
+    pool->finished = 0;
+    pool->stopping = false;
+    if (pthread_mutex_init(&pool->run_lock, NULL) != 0 || pthread_mutex_init(&pool->lock, NULL) != 0 ||
+        pthread_cond_init(&pool->batch_started, NULL) != 0 || pthread_cond_init(&pool->batch_finished, NULL) != 0) {
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+
+    for (; pool->threadCount < threadCount; pool->threadCount++) {
+        if (pthread_create(&pool->workers[pool->threadCount - 1], NULL, runWorker, pool) != 0) {
+            threadPoolDestroy(pool); // stops the threads which were already started
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+void threadPoolDestroy(ThreadPool pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->batch_started);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->threadCount - 1; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->batch_finished);
+    pthread_cond_destroy(&pool->batch_started);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->run_lock);
+    free(pool->workers);
+    free(pool);
+}
+
+int threadPoolGetThreadCount(ThreadPool pool)
+{
+    if (pool == NULL) {
+        return NULL_POOL_THREAD_COUNT;
+    }
+    return pool->threadCount;
+}
+
+ThreadPoolResult threadPoolRun(ThreadPool pool, runThreadPoolTask run, void* tasks, size_t taskSize, int taskCount)
+{
+    if (pool == NULL || run == NULL || taskCount < 0 || (tasks == NULL && taskCount > 0)) {
+        return THREAD_POOL_NULL_ARGUMENT;
+    }
+    if (taskCount == 0) {
+        return THREAD_POOL_SUCCESS;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+    pthread_mutex_lock(&pool->lock);
+    pool->run = run;
+    pool->tasks = (unsigned char*)tasks;
+    pool->taskSize = taskSize;
+    pool->taskCount = taskCount;
+    pool->next_task = 0;
+    pool->finished = 0;
+    if (taskCount > 1) {
+        pthread_cond_broadcast(&pool->batch_started);
+    }
+
+    while (runNextTask(pool));
+    while (pool->finished < pool->taskCount) { // other threads are still running the last tasks
+        pthread_cond_wait(&pool->batch_finished, &pool->lock);
+    }
+    pool->taskCount = 0;
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run_lock);
+
+    return THREAD_POOL_SUCCESS;
+}
+
+static void* runWorker(void* context)
+{
+    ThreadPool pool = (ThreadPool)context;
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stopping) {
+        if (!runNextTask(pool)) {
+            pthread_cond_wait(&pool->batch_started, &pool->lock);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+* Takes the next task of the batch and runs it, unlocking the pool while it runs.
+* Must be called with the pool locked, and returns with it locked.
+* Returns false if there was no task left to take.
+*/
+static bool runNextTask(ThreadPool pool)
+{
+    if (pool->next_task >= pool->taskCount) {
+        return false;
+    }
+    void* task = pool->tasks + (size_t)pool->next_task * pool->taskSize;
+    runThreadPoolTask run = pool->run;
+    pool->next_task++;
+    pthread_mutex_unlock(&pool->lock);
+
+    run(task);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->finished++;
+    if (pool->finished == pool->taskCount) {
+        pthread_cond_signal(&pool->batch_finished);
+    }
+    return true;
+}
@@ -0,0 +1,88 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+* A Reusable Pool of Worker Threads (ADT)
+*
+* The pool starts its threads once, and then runs batches of tasks on them: a batch is an array
+* of task structs and a function which is called on every one of them. The threads take the tasks
+* one by one, so a batch of many small tasks keeps all of them busy even if some tasks take longer.
+* The thread which runs a batch takes tasks as well, and returns once all of them are done.
+*
+* The containers use a pool for their parallel functions (such as listFilterParallel,
+* listApplyParallel and setFilterParallel), so many calls can share the same threads.
+*
+* The ADT provides the following methods:
+*   threadPoolCreate
+*   threadPoolDestroy
+*   threadPoolGetThreadCount
+*   threadPoolRun
+*
+*   NOTE: a pool runs one batch at a time, and threadPoolRun waits for the batch before it.
+*         A task must not run a batch on the pool it runs in, since it would wait for itself.
+*/
+
+// ============================ TYPEDEFS ============================ //
+typedef struct thread_pool_t * ThreadPool;
+
+/**
+* The function type that runs a task of a batch, given a pointer to its task struct.
+*/
+typedef void(*runThreadPoolTask)(void* task);
+
+typedef enum ThreadPoolResult_t {
+    THREAD_POOL_SUCCESS,
+    THREAD_POOL_NULL_ARGUMENT
+} ThreadPoolResult;
+
+
+// ============================ FUNCTIONS ============================ //
+/**
+* threadPoolCreate: Allocates a new pool and starts its threads.
+*
+* @param threadCount - The number of threads which run a batch, including the one which calls threadPoolRun,
+*                      so a pool of one thread starts no threads and runs its batches serially.
+* @return
+* 	NULL - if threadCount is not positive, or if allocations or starting a thread failed.
+* 	A new ThreadPool in case of success.
+*/
+ThreadPool threadPoolCreate(int threadCount);
+
+/**
+* threadPoolDestroy: Stops the threads of a pool, and deallocates it.
+* The pool must not be running a batch.
+*
+* @param pool - Target pool to be deallocated. If pool is NULL nothing will be done.
+*/
+void threadPoolDestroy(ThreadPool pool);
+
+/**
+* threadPoolGetThreadCount: Returns the number of threads which run a batch (as given to threadPoolCreate).
+*
+* @param pool - The pool which thread count is requested.
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of threads.
+*/
+int threadPoolGetThreadCount(ThreadPool pool);
+
+/**
+* threadPoolRun: Calls a function on every task of a batch, on all of the pool's threads at once,
+* and returns once all of the calls returned. The tasks may run in any order.
+*
+* @param pool - The pool to run the batch on.
+* @param run - The function which runs a task.
+* @param tasks - An array of taskCount structs of taskSize bytes each.
+* @param taskSize - The size of a task struct.
+* @param taskCount - The number of tasks. If it is 0, nothing is run.
+* @return
+* 	THREAD_POOL_NULL_ARGUMENT - if a NULL was sent as pool or run, or as tasks while taskCount is positive,
+* 		or if taskCount is negative.
+* 	THREAD_POOL_SUCCESS - Otherwise.
+*/
+ThreadPoolResult threadPoolRun(ThreadPool pool, runThreadPoolTask run, void* tasks, size_t taskSize, int taskCount);
+
+#endif